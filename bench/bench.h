@@ -0,0 +1,57 @@
+#pragma once
+
+//! Minimal timing and allocation counting helpers shared by the benchmarks.
+//! Include this header in exactly one translation unit per benchmark, since
+//! it replaces the global allocation functions.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include "../test/counting_new.h"
+
+namespace bench {
+
+inline std::atomic< std::size_t > &allocations() { return counting_new::calls(); }
+
+struct result
+{
+    double nsPerOp;
+    double allocsPerOp;
+};
+
+//! Runs \a fn \a iterations times, \a rounds times over after a short warm
+//! up, and returns the best average time and the number of heap allocations
+//! per call.
+template< typename F >
+result measure( std::size_t iterations, F &&fn, std::size_t rounds = 5 )
+{
+    for ( std::size_t i = 0; i < iterations / 10 + 1; ++i ) fn();
+
+    result best{ 0, 0 };
+    for ( std::size_t r = 0; r < rounds; ++r ) {
+        auto allocsBefore = allocations().load();
+        auto start = std::chrono::steady_clock::now();
+        for ( std::size_t i = 0; i < iterations; ++i ) fn();
+        auto end = std::chrono::steady_clock::now();
+        auto allocs = allocations().load() - allocsBefore;
+
+        double ns = std::chrono::duration< double, std::nano >( end - start ).count() / iterations;
+        if ( r == 0 || ns < best.nsPerOp ) best = { ns, double( allocs ) / iterations };
+    }
+    return best;
+}
+
+inline void report( const std::string &name, const result &r )
+{
+    std::printf( "%-48s %14.1f ns/op %10.2f allocs/op\n", name.c_str(), r.nsPerOp, r.allocsPerOp );
+}
+
+//! Keeps the optimizer from discarding a computed value.
+template< typename T >
+inline void doNotOptimize( T const &value )
+{
+    asm volatile( "" : : "r,m"( value ) : "memory" );
+}
+
+}
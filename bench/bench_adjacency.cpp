@@ -0,0 +1,67 @@
+#include "bench.h"
+#include "libnodes/Node.h"
+#include "libnodes/operators.h"
+#include "libnodes/Graph.h"
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace nodes;
+using namespace nodes::operators;
+
+class Int_IONode : public Node< Inlets< int, int >, Outlets< int, int > >
+{
+};
+
+int main()
+{
+    // 100k nodes, each feeding two others picked at random
+    const std::size_t count = 100000;
+    std::vector< std::unique_ptr< Int_IONode > > nodes;
+    Graph graph;
+    for ( std::size_t i = 0; i < count; ++i ) {
+        nodes.emplace_back( new Int_IONode );
+        graph.add( *nodes.back() );
+    }
+    std::mt19937 random( 1 );
+    for ( auto &n : nodes ) {
+        n->out< 0 >() >> nodes[ random() % count ]->in< 0 >();
+        n->out< 1 >() >> nodes[ random() % count ]->in< 1 >();
+    }
+
+    auto result = bench::measure( 10, [&] {
+        std::size_t sum = 0;
+        for ( auto &n : nodes ) {
+            n->outlets().each( [&]( auto &outlet ) {
+                for ( auto &inlet : outlet.connections() ) sum += inlet.get().node()->id() + inlet.get().getIndex();
+            } );
+        }
+        bench::doNotOptimize( sum );
+    } );
+    bench::report( "walk 200k connections through the nodes", result );
+
+    auto &snapshot = graph.adjacency();
+    result = bench::measure( 10, [&] {
+        std::size_t sum = 0;
+        for ( auto &e : snapshot.edges() ) sum += e.node + e.inlet;
+        bench::doNotOptimize( sum );
+    } );
+    bench::report( "walk 200k connections in the snapshot", result );
+
+    result = bench::measure( 10, [&] {
+        graph.remove( *nodes[ 0 ] );
+        graph.add( *nodes[ 0 ] );
+        bench::doNotOptimize( graph.adjacency() );
+    } );
+    bench::report( "rebuild the snapshot", result );
+
+    std::size_t i = 0;
+    result = bench::measure( 100, [&] {
+        auto &n = *nodes[ i++ % count ];
+        n.out< 0 >().disconnect();
+        n.out< 0 >() >> nodes[ random() % count ]->in< 0 >();
+        bench::doNotOptimize( graph.adjacency() );
+    } );
+    bench::report( "reconnect an outlet and update the snapshot", result );
+}
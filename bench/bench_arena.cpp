@@ -0,0 +1,83 @@
+#include "bench.h"
+#include "libnodes/Node.h"
+#include "libnodes/operators.h"
+#include "libnodes/Graph.h"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using namespace nodes;
+using namespace nodes::operators;
+
+class Int_IONode : public Node< Inlets< int >, Outlets< int > >
+{
+public:
+    Int_IONode()
+    {
+        in< 0 >().onReceive( [this]( const int &i ) { out< 0 >().update( i + 1 ); } );
+    }
+};
+
+typedef std::chrono::steady_clock clock_type;
+
+static double ms( clock_type::time_point start ) { return std::chrono::duration< double, std::milli >( clock_type::now() - start ).count(); }
+
+//! Builds a graph of \a width chains of \a depth nodes off one source with
+//! \a make, sends a value through it, and tears it down, reporting the time
+//! and heap allocations of each.
+template< typename M >
+void run( const char *name, std::size_t width, std::size_t depth, M &&make )
+{
+    Outlet< int > source;
+    Inlet< int > sink;
+    int total = 0;
+    sink.onReceive( [&]( const int &i ) { total += i; } );
+
+    auto allocs = bench::allocations().load();
+    auto start = clock_type::now();
+    std::unique_ptr< Graph > graph( new Graph );
+    std::vector< std::unique_ptr< Int_IONode > > owned;
+    for ( std::size_t w = 0; w < width; ++w ) {
+        Int_IONode *previous = nullptr;
+        for ( std::size_t d = 0; d < depth; ++d ) {
+            Int_IONode &n = make( *graph, owned );
+            if ( previous ) {
+                *previous >> n;
+            } else {
+                source >> n.in< 0 >();
+            }
+            previous = &n;
+        }
+        previous->out< 0 >() >> sink;
+    }
+    auto build = ms( start );
+    auto buildAllocs = bench::allocations().load() - allocs;
+
+    start = clock_type::now();
+    for ( int i = 0; i < 10; ++i ) source.update( i );
+    auto update = ms( start ) / 10;
+
+    allocs = bench::allocations().load();
+    start = clock_type::now();
+    owned.clear();
+    graph.reset();
+    auto teardown = ms( start );
+    std::printf( "%-24s build %8.1f ms %10.2f allocs/node  update %8.2f ms  teardown %8.1f ms %10.2f allocs/node\n", name,
+                 build, double( buildAllocs ) / ( width * depth ), update, teardown,
+                 double( bench::allocations().load() - allocs ) / ( width * depth ) );
+}
+
+int main()
+{
+    for ( int round = 0; round < 3; ++round ) {
+        run( "heap, 100k nodes", 1000, 100, []( Graph &graph, std::vector< std::unique_ptr< Int_IONode > > &owned ) -> Int_IONode & {
+            owned.emplace_back( new Int_IONode );
+            graph.add( *owned.back() );
+            return *owned.back();
+        } );
+        run( "arena, 100k nodes", 1000, 100, []( Graph &graph, std::vector< std::unique_ptr< Int_IONode > > & ) -> Int_IONode & {
+            return graph.create< Int_IONode >();
+        } );
+    }
+}
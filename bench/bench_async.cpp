@@ -0,0 +1,111 @@
+#include "bench.h"
+#include "libnodes/Node.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace nodes;
+
+typedef std::chrono::steady_clock clock_type;
+
+static std::int64_t now()
+{
+    return std::chrono::duration_cast< std::chrono::nanoseconds >( clock_type::now().time_since_epoch() ).count();
+}
+
+//! The queue nodes put between threads before async connections: a bounded
+//! std::deque guarded by a mutex, swapped out whole when pumped.
+template< typename T >
+class MutexConnection : public TypedInlet< T >
+{
+public:
+    MutexConnection( TypedInlet< T > &in, std::size_t capacity ) : mCapacity( capacity ) { mOut.connect( in ); }
+
+    using TypedInlet< T >::receive;
+
+    void receive( const T &data ) override
+    {
+        while ( true ) {
+            {
+                std::lock_guard< std::mutex > lock( mMutex );
+                if ( mQueue.size() < mCapacity ) {
+                    mQueue.push_back( data );
+                    return;
+                }
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    std::size_t pump()
+    {
+        {
+            std::lock_guard< std::mutex > lock( mMutex );
+            std::swap( mQueue, mPumped );
+        }
+        auto count = mPumped.size();
+        for ( auto &data : mPumped ) mOut.update( data );
+        mPumped.clear();
+        return count;
+    }
+
+private:
+    std::size_t mCapacity;
+    std::mutex mMutex;
+    std::deque< T > mQueue, mPumped;
+    Outlet< T > mOut;
+};
+
+//! Sends \a count time stamps from a producer thread to an inlet pumped on
+//! the calling thread, and reports the throughput and the 99th percentile of
+//! the time from update to receive.
+template< typename C >
+void run( const std::string &name, std::size_t count, C &&connect )
+{
+    Outlet< std::int64_t > source;
+    Inlet< std::int64_t > sink;
+    std::vector< std::int64_t > latencies;
+    latencies.reserve( count );
+    sink.onReceive( [&]( const std::int64_t &sent ) { latencies.push_back( now() - sent ); } );
+    auto connection = connect( source, sink );
+
+    auto start = now();
+    std::thread producer( [&] {
+        for ( std::size_t i = 0; i < count; ++i ) source.update( now() );
+    } );
+    while ( latencies.size() < count ) {
+        if ( connection->pump() == 0 ) std::this_thread::yield();
+    }
+    auto seconds = double( now() - start ) / 1e9;
+    producer.join();
+
+    std::sort( latencies.begin(), latencies.end() );
+    std::printf( "%-36s %12.0f msgs/s %12.0f ns p50 %12.0f ns p99\n", name.c_str(), double( count ) / seconds,
+                 double( latencies[ count / 2 ] ), double( latencies[ count * 99 / 100 ] ) );
+}
+
+int main()
+{
+    std::printf( "hardware threads: %u\n", std::thread::hardware_concurrency() );
+    const std::size_t count = 2000000;
+    for ( std::size_t capacity : { 64, 1024 } ) {
+        auto suffix = ", capacity " + std::to_string( capacity );
+        for ( int round = 0; round < 3; ++round ) {
+            run( "mutex queue" + suffix, count, [&]( Outlet< std::int64_t > &out, Inlet< std::int64_t > &in ) {
+                std::unique_ptr< MutexConnection< std::int64_t > > c( new MutexConnection< std::int64_t >( in, capacity ) );
+                out.connect( *c );
+                return c;
+            } );
+            run( "async connection" + suffix, count, [&]( Outlet< std::int64_t > &out, Inlet< std::int64_t > &in ) {
+                return out.connect_async( in, capacity );
+            } );
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#include "bench.h"
+#include "libnodes/Node.h"
+#include "libnodes/operators.h"
+#include "libnodes/ValueNode.h"
+#include <memory>
+#include <vector>
+
+using namespace nodes;
+using namespace nodes::operators;
+
+//! Pushes 256 samples through a chain of value nodes, one update at a time
+//! and as one batch.
+int main()
+{
+    const std::size_t samples = 256;
+    std::vector< float > batch( samples );
+    for ( std::size_t i = 0; i < samples; ++i ) batch[ i ] = float( i );
+
+    for ( std::size_t length : { 1, 4, 16 } ) {
+        Outlet< float > source;
+        std::vector< std::unique_ptr< ValueNodef > > chain;
+        for ( std::size_t i = 0; i < length; ++i ) {
+            chain.emplace_back( new ValueNodef );
+            if ( i == 0 ) {
+                source >> chain[ i ]->in< 0 >();
+            } else {
+                *chain[ i - 1 ] >> *chain[ i ];
+            }
+        }
+        float sum = 0.f;
+        Inlet< float > single, batched;
+        single.onReceive( [&]( const float &f ) { sum += f; } );
+        batched.onReceiveBatch( [&]( span< const float > b ) {
+            for ( float f : b ) sum += f;
+        } );
+        auto sink = chain.back()->out< 0 >() >> single;
+
+        auto name = "chain " + std::to_string( length ) + ", 256 samples";
+        bench::report( name + ", update", bench::measure( 1000, [&] {
+            for ( float f : batch ) source.update( f );
+        } ) );
+
+        sink.disconnect();
+        chain.back()->out< 0 >() >> batched;
+        bench::report( name + ", update_batch", bench::measure( 1000, [&] {
+            source.update_batch( batch );
+        } ) );
+        bench::doNotOptimize( sum );
+    }
+}
@@ -0,0 +1,143 @@
+#include "bench.h"
+#include "libnodes/Node.h"
+#include <memory>
+#include <set>
+#include <vector>
+
+using namespace nodes;
+
+//! The vector plus std::set layout connection_container used before it
+//! stored connections inline, kept for comparison.
+template< typename V >
+class legacy_connection_container {
+public:
+    struct compare {
+        bool operator()( const std::reference_wrapper< V > &lhs, const std::reference_wrapper< V > &rhs ) const {
+            return lhs.get() < rhs.get();
+        }
+    };
+
+    typedef std::reference_wrapper< V > value_type;
+    typedef std::vector< value_type > vector_type;
+    typedef std::set< value_type, compare > set_type;
+
+    bool insert( const value_type &member ) {
+        if ( mSet.insert( member ).second ) {
+            mVector.push_back( member );
+            return true;
+        }
+        return false;
+    }
+
+    bool erase( const value_type &member ) {
+        if ( mSet.erase( member )) {
+            mVector.erase( std::remove_if( mVector.begin(), mVector.end(), [&]( const value_type &m ) {
+                return m.get() == member.get();
+            } ), mVector.end());
+            return true;
+        }
+        return false;
+    }
+
+    typename vector_type::iterator begin() { return mVector.begin(); }
+    typename vector_type::iterator end() { return mVector.end(); }
+
+    void clear() {
+        mVector.clear();
+        mSet.clear();
+    }
+
+private:
+    vector_type mVector;
+    set_type mSet;
+};
+
+//! Both ends of a connection in the old layout.
+struct LegacyInlet;
+
+struct LegacyOutlet : public Xlet
+{
+    legacy_connection_container< LegacyInlet > connections;
+};
+
+struct LegacyInlet : public Xlet
+{
+    legacy_connection_container< LegacyOutlet > connections;
+};
+
+struct Legacy
+{
+    typedef LegacyOutlet outlet_type;
+    typedef LegacyInlet inlet_type;
+
+    static void connect( LegacyOutlet &o, LegacyInlet &i )
+    {
+        if ( o.connections.insert( i ) ) i.connections.insert( o );
+    }
+
+    static void disconnect( LegacyOutlet &o, LegacyInlet &i )
+    {
+        i.connections.erase( o );
+        o.connections.erase( i );
+    }
+
+    static legacy_connection_container< LegacyInlet > &connections( LegacyOutlet &o ) { return o.connections; }
+
+    //! the old layout left this to the caller when an outlet was destroyed
+    static void forget( LegacyInlet &i ) { i.connections.clear(); }
+};
+
+struct Current
+{
+    typedef Outlet< int > outlet_type;
+    typedef Inlet< int, singlethread_policy > inlet_type;
+
+    static void connect( outlet_type &o, inlet_type &i ) { o.connect( i ); }
+
+    static void disconnect( outlet_type &o, inlet_type &i ) { o.disconnect( i ); }
+
+    static connection_container< TypedInlet< int > > &connections( outlet_type &o ) { return o.connections(); }
+
+    static void forget( inlet_type & ) {}
+};
+
+template< typename L >
+void run( const std::string &name, std::size_t fanout, std::size_t iterations )
+{
+    std::vector< std::unique_ptr< typename L::inlet_type > > inlets;
+    for ( std::size_t i = 0; i < fanout; ++i ) inlets.emplace_back( new typename L::inlet_type );
+
+    bench::report( name + " connect", bench::measure( iterations, [&] {
+        {
+            typename L::outlet_type o;
+            for ( auto &i : inlets ) L::connect( o, *i );
+            bench::doNotOptimize( o );
+        }
+        for ( auto &i : inlets ) L::forget( *i );
+    } ) );
+
+    typename L::outlet_type o;
+    for ( auto &i : inlets ) L::connect( o, *i );
+    bench::report( name + " iterate", bench::measure( iterations, [&] {
+        std::uint64_t sum = 0;
+        for ( auto &i : L::connections( o ) ) sum += i.get().index();
+        bench::doNotOptimize( sum );
+    } ) );
+
+    bench::report( name + " connect+disconnect", bench::measure( iterations, [&] {
+        typename L::outlet_type d;
+        for ( auto &i : inlets ) L::connect( d, *i );
+        for ( auto &i : inlets ) L::disconnect( d, *i );
+        bench::doNotOptimize( d );
+    } ) );
+}
+
+int main()
+{
+    for ( std::size_t fanout : { 1, 4, 16, 256, 10000 } ) {
+        const std::size_t iterations = 200000 / fanout;
+        auto suffix = ", " + std::to_string( fanout ) + " connections";
+        run< Legacy >( "vector+set" + suffix, fanout, iterations );
+        run< Current >( "small_vector" + suffix, fanout, iterations );
+    }
+}
@@ -0,0 +1,106 @@
+#include "bench.h"
+#include "libnodes/Node.h"
+#include "libnodes/operators.h"
+#include "libnodes/Executor.h"
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace nodes;
+using namespace nodes::operators;
+
+//! Does a fixed amount of arithmetic on each int it receives, and passes
+//! the result on.
+class Work : public Node< Inlets< int >, Outlets< int > >
+{
+public:
+    Work()
+    {
+        in< 0 >().onReceive( [this]( const int &i ) {
+            unsigned x = unsigned( i ) + 1;
+            for ( int k = 0; k < 2000; ++k ) x = x * 1664525u + 1013904223u;
+            out< 0 >().update( int( x >> 8 ) );
+        } );
+    }
+};
+
+//! A source fanning out to \a width chains of \a depth working nodes.
+struct WideGraph
+{
+    WideGraph( std::size_t width, std::size_t depth )
+    {
+        for ( std::size_t w = 0; w < width; ++w ) {
+            Work *previous = nullptr;
+            for ( std::size_t d = 0; d < depth; ++d ) {
+                nodes.emplace_back( new Work );
+                if ( previous ) {
+                    *previous >> *nodes.back();
+                } else {
+                    source >> nodes.back()->in< 0 >();
+                }
+                previous = nodes.back().get();
+            }
+        }
+    }
+
+    Outlet< int > source;
+    std::vector< std::unique_ptr< Work > > nodes;
+};
+
+//! A source fanning out to \a width inlets that do little work each.
+struct FlatFanOut
+{
+    explicit FlatFanOut( std::size_t width ) : inlets( width )
+    {
+        for ( auto &in : inlets ) {
+            in.onReceive( []( const int &i ) {
+                unsigned x = unsigned( i );
+                for ( int k = 0; k < 50; ++k ) x = x * 1664525u + 1013904223u;
+                bench::doNotOptimize( x );
+            } );
+            source >> in;
+        }
+    }
+
+    Outlet< int > source;
+    std::vector< Inlet< int > > inlets;
+};
+
+//! Measures one update through a wide, deep graph with 1 to 32 worker
+//! threads, against running it on the calling thread alone. Then compares
+//! fanning out to many cheap inlets one job per inlet, in chunks, and
+//! inline, for a wide and a narrow outlet. Runs with more workers than
+//! hardware threads are marked, since they measure overhead, not scaling.
+int main()
+{
+    unsigned hardware = std::thread::hardware_concurrency();
+    std::printf( "hardware threads: %u\n", hardware );
+    if ( hardware <= 1 ) {
+        std::printf( "only one hardware thread: the runs below show the executor's overhead, not how it scales\n" );
+    }
+    WideGraph graph( 64, 16 );
+
+    bench::report( "64 x 16 graph, no executor", bench::measure( 20, [&] { graph.source.update( 1 ); } ) );
+    for ( std::size_t threads : { 1, 2, 4, 8, 16, 32 } ) {
+        Executor executor( threads );
+        auto name = "64 x 16 graph, " + std::to_string( threads ) + " threads";
+        if ( threads > hardware ) name += " (oversubscribed)";
+        bench::report( name, bench::measure( 20, [&] {
+            executor.run( [&] { graph.source.update( 1 ); } );
+        } ) );
+    }
+
+    Executor executor( 4 );
+    for ( std::size_t width : { 4, 256 } ) {
+        FlatFanOut flat( width );
+        auto name = std::to_string( width ) + " cheap inlets, ";
+        bench::report( name + "inline", bench::measure( 2000, [&] { flat.source.update( 1 ); } ) );
+        bench::report( name + "job per inlet", bench::measure( 2000, [&] {
+            executor.run( [&] { flat.source.update( 1 ); } );
+        } ) );
+        flat.source.setParallel( &executor, 16 );
+        bench::report( name + "parallel, threshold 16", bench::measure( 2000, [&] { flat.source.update( 1 ); } ) );
+        bench::report( name + "parallel async", bench::measure( 2000, [&] { flat.source.update_async( 1 ).wait(); } ) );
+    }
+}
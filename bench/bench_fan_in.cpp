@@ -0,0 +1,38 @@
+#include "bench.h"
+#include "libnodes/Node.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+using namespace nodes;
+
+//! Measures Inlet::isConnectedTo on an inlet with a growing number of
+//! connected outlets, against a linear scan over the same outlets.
+int main()
+{
+    for ( std::size_t fanIn : { 1, 10, 100, 1000, 10000, 100000 } ) {
+        Inlet< int, singlethread_policy > sink;
+        std::vector< std::unique_ptr< Outlet< int > > > sources;
+        std::vector< const Outlet< int > * > scan;
+        for ( std::size_t i = 0; i < fanIn; ++i ) {
+            sources.emplace_back( new Outlet< int > );
+            sources.back()->connect( sink );
+            scan.push_back( sources.back().get() );
+        }
+
+        const std::size_t iterations = 100000;
+        auto name = "fan-in " + std::to_string( fanIn );
+
+        std::size_t next = 0;
+        bench::report( name + ", isConnectedTo", bench::measure( iterations, [&] {
+            next = ( next + 7919 ) % fanIn;
+            bench::doNotOptimize( sink.isConnectedTo( *sources[ next ] ) );
+        } ) );
+
+        if ( fanIn > 10000 ) continue;
+        bench::report( name + ", linear scan", bench::measure( iterations / std::max< std::size_t >( 1, fanIn / 100 ), [&] {
+            next = ( next + 7919 ) % fanIn;
+            bench::doNotOptimize( std::find( scan.begin(), scan.end(), sources[ next ].get() ) != scan.end() );
+        } ) );
+    }
+}
@@ -0,0 +1,64 @@
+#include "bench.h"
+#include "libnodes/Node.h"
+#include "libnodes/operators.h"
+#include "libnodes/Graph.h"
+#include "libnodes/ValueNode.h"
+#include "libnodes/frame_scheduler.h"
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using namespace nodes;
+using namespace nodes::operators;
+
+//! Does some arithmetic on each int it receives, and passes the result on.
+class Work : public Node< Inlets< int >, Outlets< int > >
+{
+public:
+    Work()
+    {
+        in< 0 >().onReceive( [this]( const int &i ) {
+            unsigned x = unsigned( i );
+            for ( int k = 0; k < 100; ++k ) x = x * 1664525u + 1013904223u;
+            out< 0 >().update( int( x >> 8 ) );
+        } );
+    }
+};
+
+//! Sets an input 10 times per frame, feeding 16 chains of 4 working nodes,
+//! with every update propagating against a frame scheduler flushing once
+//! per frame.
+int main()
+{
+    ValueNodei input( 0 );
+    std::vector< std::unique_ptr< Work > > nodes;
+    Graph graph;
+    for ( int w = 0; w < 16; ++w ) {
+        Work *previous = nullptr;
+        for ( int d = 0; d < 4; ++d ) {
+            nodes.emplace_back( new Work );
+            if ( previous ) {
+                *previous >> *nodes.back();
+            } else {
+                input >> *nodes.back();
+            }
+            previous = nodes.back().get();
+            graph.add( *previous );
+        }
+    }
+
+    int value = 0;
+    bench::report( "10 sets per frame, direct", bench::measure( 2000, [&] {
+        for ( int i = 0; i < 10; ++i ) input.set( ++value );
+    } ) );
+
+    frame_scheduler frame( graph );
+    bench::report( "10 sets per frame, frame scheduler", bench::measure( 2000, [&] {
+        {
+            frame_scheduler::scope scope( frame );
+            for ( int i = 0; i < 10; ++i ) input.set( ++value );
+        }
+        frame.flush();
+    } ) );
+    std::printf( "coalesced %zu of %zu updates\n", frame.coalesced(), frame.coalesced() + frame.scheduled() );
+}
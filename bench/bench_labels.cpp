@@ -0,0 +1,61 @@
+#include "bench.h"
+#include "libnodes/Node.h"
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace nodes;
+
+class Int_IONode : public Node< Inlets< int >, Outlets< int > >
+{
+public:
+    Int_IONode( const std::string &label = "" ) : node_type( label ) {}
+};
+
+//! a node with no xlets, so that constructing it is mostly its label
+class Bare_Node : public Node< Inlets<>, Outlets<> >
+{
+public:
+    Bare_Node( const std::string &label = "" ) : node_type( label ) {}
+};
+
+int main()
+{
+    std::printf( "sizeof( NodeBase ) %zu, sizeof( Int_IONode ) %zu\n", sizeof( NodeBase ), sizeof( Int_IONode ) );
+
+    // labels longer than the small string buffer, repeated across a graph
+    const std::vector< std::string > labels{ "lowpass filter cutoff", "oscillator frequency", "envelope release time",
+                                             "output gain in decibels" };
+
+    bench::report( "bare node, unlabeled", bench::measure( 1000000, [] {
+        Bare_Node n;
+        bench::doNotOptimize( n );
+    } ) );
+    std::size_t i = 0;
+    bench::report( "bare node, repeated labels", bench::measure( 1000000, [&] {
+        Bare_Node n( labels[ i++ % labels.size() ] );
+        bench::doNotOptimize( n );
+    } ) );
+    bench::report( "bare node, unlabeled, label read", bench::measure( 1000000, [] {
+        Bare_Node n;
+        bench::doNotOptimize( n.label() );
+    } ) );
+    bench::report( "int node, unlabeled", bench::measure( 100000, [] {
+        Int_IONode n;
+        bench::doNotOptimize( n );
+    } ) );
+    bench::report( "int node, repeated labels", bench::measure( 100000, [&] {
+        Int_IONode n( labels[ i++ % labels.size() ] );
+        bench::doNotOptimize( n );
+    } ) );
+
+    // a graph's worth of nodes alive at once
+    const std::size_t count = 100000;
+    std::vector< std::unique_ptr< Int_IONode > > nodes;
+    nodes.reserve( count );
+    auto before = bench::allocations().load();
+    for ( std::size_t n = 0; n < count; ++n ) nodes.emplace_back( new Int_IONode( labels[ n % labels.size() ] ) );
+    std::printf( "%-48s %14.2f allocs/node\n", "100k live nodes, repeated labels",
+                 double( bench::allocations().load() - before - count ) / count );
+}
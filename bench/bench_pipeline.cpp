@@ -0,0 +1,51 @@
+#include "bench.h"
+#include "libnodes/Node.h"
+#include "libnodes/Pipeline.h"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace nodes;
+
+//! Spins for about \a work iterations per value, then passes it on.
+class Work_IONode : public Node< Inlets< int >, Outlets< int > >
+{
+public:
+    explicit Work_IONode( unsigned work )
+    {
+        in< 0 >().onReceive( [this, work]( const int &i ) {
+            unsigned x = unsigned( i );
+            for ( unsigned k = 0; k < work; ++k ) x = x * 1664525u + 1013904223u;
+            bench::doNotOptimize( x );
+            out< 0 >().update( i );
+        } );
+    }
+};
+
+int main()
+{
+    std::printf( "hardware threads: %u\n", std::thread::hardware_concurrency() );
+    const std::size_t length = 16, count = 20000;
+    std::vector< std::unique_ptr< Work_IONode > > chain;
+    for ( std::size_t i = 0; i < length; ++i ) {
+        // a few nodes cost more than the others
+        chain.emplace_back( new Work_IONode( i % 5 == 0 ? 4000 : 1000 ) );
+        if ( i > 0 ) chain[ i - 1 ]->out< 0 >().connect( chain[ i ]->in< 0 >() );
+    }
+    Pipeline pipeline( *chain.front() );
+    int sent = 0;
+    pipeline.measure( [&] { chain.front()->in< 0 >().receive( sent++ ); } );
+
+    for ( std::size_t stages : { 1, 2, 4, 8 } ) {
+        if ( stages > 1 ) pipeline.start( stages );
+        auto start = std::chrono::steady_clock::now();
+        for ( std::size_t i = 0; i < count; ++i ) chain.front()->in< 0 >().receive( int( i ) );
+        pipeline.wait();
+        double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+        pipeline.stop();
+        std::printf( "%-36s %12.0f values/s\n", ( std::to_string( stages ) + " stages" ).c_str(), count / seconds );
+    }
+}
@@ -0,0 +1,32 @@
+#include "bench.h"
+#include "libnodes/Node.h"
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using namespace nodes;
+
+int main()
+{
+    // listeners capturing three pointers, too much for std::function to
+    // store without allocating
+    int a = 0, b = 0, c = 0;
+
+    auto result = bench::measure( 1000, [&] {
+        Inlet< int > inlet;
+        for ( int i = 0; i < 16; ++i ) {
+            inlet.onReceive( [&a, &b, &c]( const int &v ) { a += v; b += a; c += b; } );
+        }
+    } );
+    result.nsPerOp /= 16;
+    result.allocsPerOp /= 16;
+    bench::report( "connect 16 listeners, per listener", result );
+
+    Inlet< int > inlet;
+    for ( int i = 0; i < 64; ++i ) {
+        inlet.onReceive( [&a, &b, &c]( const int &v ) { a += v; b += a; c += b; } );
+    }
+    result = bench::measure( 100000, [&] { inlet.receive( 1 ); } );
+    bench::report( "receive with 64 listeners", result );
+    bench::doNotOptimize( c );
+}
@@ -0,0 +1,64 @@
+#include "bench.h"
+#include "libnodes/Node.h"
+#include "libnodes/operators.h"
+#include <memory>
+#include <vector>
+
+using namespace nodes;
+using namespace nodes::operators;
+
+//! Passes each received int on, incremented by one.
+template< typename Ti >
+class Relay : public Node< Ti, Outlets< int > >
+{
+public:
+    Relay()
+    {
+        this->template in< 0 >().onReceive( [this]( const int &i ) {
+            this->template out< 0 >().update( i + 1 );
+        } );
+    }
+};
+
+//! A chain of relays ending in a sink.
+template< typename Ti >
+struct Chain
+{
+    Chain( std::size_t length )
+    {
+        for ( std::size_t i = 0; i < length; ++i ) {
+            nodes.emplace_back( new Relay< Ti >() );
+            if ( i > 0 ) *nodes[ i - 1 ] >> *nodes[ i ];
+        }
+        sink.onReceive( [this]( const int &i ) { last = i; } );
+        nodes.back()->template out< 0 >().connect( sink );
+    }
+
+    bench::result run( std::size_t iterations )
+    {
+        auto &head = nodes.front()->template in< 0 >();
+        auto r = bench::measure( iterations, [&] { head.receive( 0 ); } );
+        bench::doNotOptimize( last );
+        return r;
+    }
+
+    std::vector< std::unique_ptr< Relay< Ti > > > nodes;
+    Inlet< int, singlethread_policy > sink;
+    int last = 0;
+};
+
+int main()
+{
+    for ( std::size_t length : { 10, 1000 } ) {
+        const std::size_t iterations = 2000000 / length;
+
+        // build both chains before measuring, so neither runs on a heap
+        // fragmented by the other
+        Chain< Inlets< int > > multi( length );
+        Chain< UnsafeInlets< int > > single( length );
+
+        auto name = std::to_string( length ) + "-node chain, ";
+        bench::report( name + "multithread_policy", multi.run( iterations ) );
+        bench::report( name + "singlethread_policy", single.run( iterations ) );
+    }
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "libnodes/Executor.h"
+#include "libnodes/actor_base.h"
+#include "libnodes/id_allocator.h"
+
+namespace nodes {
+
+//! Runs a node as an actor: the messages its inlets receive are queued in a
+//! lock free multi-producer single-consumer mailbox instead of calling the
+//! inlet listeners right away, and an Executor's workers run them later, in
+//! the order they arrived and never on two threads at once. The node and its
+//! listeners stay as they are; this isolates a slow node, like one writing to
+//! disk, from the threads feeding it.
+//!
+//! An actor is created for an existing node, which it must not outlive.
+//! Destroying the actor makes the inlets call their listeners directly again,
+//! after running every message still in the mailbox. Like the node itself,
+//! it must not be destroyed while other threads may still be updating the
+//! inlets: a thread that found the actor on an inlet just before it was
+//! detached can still be inside post(), which the destructor cannot wait
+//! for. The executor has to outlive the actor.
+class Actor : public actor_base
+{
+public:
+    template< typename N >
+    Actor( N &node, Executor &executor ) :
+            mExecutor( executor ),
+            mNode( &node ),
+            mAttach( &attach< N > )
+    {
+        mJob.run = &runJob;
+        mJob.function = this;
+        mJob.item = nullptr;
+        mJob.join = nullptr;
+        mAttach( mNode, this );
+    }
+
+    Actor( const Actor & ) = delete;
+
+    Actor &operator=( const Actor & ) = delete;
+
+    ~Actor()
+    {
+        mAttach( mNode, nullptr );
+        waitIdle();
+    }
+
+    //! Blocks until every message posted so far has run, and rethrows the
+    //! first exception a listener threw since the last call. Must not be
+    //! called from the actor's own listeners.
+    void wait()
+    {
+        waitIdle();
+        std::exception_ptr error;
+        {
+            std::lock_guard< std::mutex > lock( mErrorMutex );
+            std::swap( error, mError );
+        }
+        if ( error ) std::rethrow_exception( error );
+    }
+
+    //! the number of messages waiting or running
+    std::size_t pending() const
+    {
+        auto pending = mPending.load();
+        return pending > 0 ? std::size_t( pending ) : 0;
+    }
+
+private:
+    struct message
+    {
+        std::atomic< message * > next{ nullptr };
+        task fn;
+        //! where the message is kept in mMessages
+        id_allocator::id_type id = 0;
+    };
+
+    //! how many messages a worker runs before giving other jobs a turn
+    static constexpr std::int64_t budget = 64;
+
+    template< typename N >
+    static void attach( void *node, Actor *actor )
+    {
+        static_cast< N * >( node )->inlets().each( [&]( auto &inlet ) {
+            inlet.setActor( actor );
+        } );
+    }
+
+    static void runJob( executor_job &job ) { static_cast< Actor * >( job.function )->drain(); }
+
+    //! Messages are kept by the actor and reused once they have run, taken
+    //! from and given back to a lock-free free list, so producers and the
+    //! consumer do not contend on a lock.
+    void enqueue( task &&fn ) override
+    {
+        auto id = mFree.acquire();
+        auto m = &mMessages[ id ];
+        m->fn = std::move( fn );
+        m->id = id;
+        m->next.store( nullptr, std::memory_order_relaxed );
+        push( m );
+        if ( mPending.fetch_add( 1 ) == 0 ) mExecutor.submit( mJob );
+    }
+
+    //! Vyukov's intrusive queue: producers swap themselves in at the head,
+    //! the consumer takes from the tail.
+    void push( message *m )
+    {
+        auto previous = mHead.exchange( m, std::memory_order_acq_rel );
+        previous->next.store( m, std::memory_order_release );
+    }
+
+    //! the oldest message, or nullptr if there is none or its producer has
+    //! not finished pushing it
+    message *pop()
+    {
+        auto tail = mTail;
+        auto next = tail->next.load( std::memory_order_acquire );
+        if ( tail == &mStub ) {
+            if ( ! next ) return nullptr;
+            mTail = tail = next;
+            next = next->next.load( std::memory_order_acquire );
+        }
+        if ( next ) {
+            mTail = next;
+            return tail;
+        }
+        if ( tail != mHead.load( std::memory_order_acquire ) ) return nullptr;
+        mStub.next.store( nullptr, std::memory_order_relaxed );
+        push( &mStub );
+        next = tail->next.load( std::memory_order_acquire );
+        if ( next ) {
+            mTail = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    //! Runs up to budget messages on the calling worker. Posting submits the
+    //! actor when its count of pending messages leaves zero, and draining
+    //! resubmits it while the count stays above zero, so at most one worker
+    //! drains it at a time. Resubmitting queues it behind the jobs waiting
+    //! already, so a busy actor does not keep its worker from them.
+    void drain()
+    {
+        std::int64_t ran = 0;
+        while ( ran < budget ) {
+            auto m = pop();
+            if ( ! m ) break;
+            try {
+                m->fn();
+            } catch ( ... ) {
+                std::lock_guard< std::mutex > lock( mErrorMutex );
+                if ( ! mError ) mError = std::current_exception();
+            }
+            m->fn = nullptr;
+            mFree.release( m->id );
+            ++ran;
+        }
+        if ( mPending.fetch_sub( ran ) != ran ) mExecutor.requeue( mJob );
+    }
+
+    void waitIdle()
+    {
+        while ( mPending.load() > 0 ) std::this_thread::yield();
+    }
+
+    Executor &mExecutor;
+    void *mNode;
+    void ( *mAttach )( void *, Actor * );
+    executor_job mJob;
+
+    std::atomic< message * > mHead{ &mStub };
+    message *mTail = &mStub;
+    message mStub;
+    std::atomic< std::int64_t > mPending{ 0 };
+    //! messages by id, reused through mFree; the first block is small, since
+    //! most mailboxes hold a few messages at a time
+    block_table< message, 16 > mMessages;
+    //! the ids of the messages in mMessages that are not queued, on the
+    //! tagged lock-free stack of id_allocator
+    id_allocator mFree;
+
+    std::mutex mErrorMutex;
+    std::exception_ptr mError;
+};
+
+}
@@ -10,12 +10,15 @@ template< typename ...Ts >
 using bundle = std::tuple< Ts... >;
 
 
-//! Node for easily combining multiple messages into one bundle
+//! Node for easily combining multiple messages into one bundle. Elements
+//! may arrive from several threads at once, e.g. from the branches of a
+//! fan-out run by an Executor; the thread completing the bundle emits it.
 template< typename ...Ts >
 class BundleNode : public Node< Inlets< Ts... >, Outlets< bundle< Ts... > > >
 {
 public:
     typedef bundle< Ts... > bundle_type;
+    typedef typename Node< Inlets< Ts... >, Outlets< bundle< Ts... > > >::thread_policy thread_policy;
     static constexpr std::size_t bundle_size = std::tuple_size< bundle_type >::value;
 
     BundleNode( const std::string & label = "" ) :
@@ -24,9 +27,13 @@ public:
         reset();
 
         this->inlets().each_with_index( [&]( auto & inlet, auto i ) {
-            inlet.onReceive( [&]( const auto & received ) {
-                std::get< i >( mBundle ) = received;
-                mElementUpdated[ i ] = true;
+            typedef typename std::tuple_element< decltype( i )::value, bundle_type >::type element_type;
+            inlet.onReceive( [&]( element_type received ) {
+                {
+                    lock_type lock( mMutex );
+                    std::get< i >( mBundle ) = std::move( received );
+                    mElementUpdated[ i ] = true;
+                }
 
                 update();
             });
@@ -40,13 +47,23 @@ public:
 
     void update()
     {
-        if ( ! mElementUpdated.all() ) return;
+        bundle_type complete;
+        {
+            lock_type lock( mMutex );
+            if ( ! mElementUpdated.all() ) return;
 
-        this->template out< 0 >().update( mBundle );
-        reset();
+            // every element has to be received again before the next update,
+            // so the bundle can be handed on without copying it
+            reset();
+            complete = std::move( mBundle );
+        }
+        this->template out< 0 >().update( std::move( complete ) );
     }
 
 private:
+    typedef typename thread_policy::mutex_lock_type lock_type;
+
+    typename thread_policy::mutex_type mMutex;
 
     bundle_type mBundle;
     std::bitset< bundle_size > mElementUpdated;
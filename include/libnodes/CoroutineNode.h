@@ -0,0 +1,310 @@
+#pragma once
+
+#include "libnodes/Node.h"
+#include "libnodes/arena.h"
+
+#if defined( __cpp_impl_coroutine ) && __cpp_impl_coroutine >= 201902L
+#define LIBNODES_COROUTINES 1
+
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace nodes {
+
+class CoroutineNodeBase;
+
+//! The coroutine returned by CoroutineNode::body(). It starts suspended and
+//! owns its frame, which is allocated from the node's arena, see
+//! uses_frame_pool.
+class node_task
+{
+public:
+    struct promise_type
+    {
+        //! Frames of node bodies come from the arena of their node, which
+        //! the compiler passes here as the object body() is called on.
+        static void *operator new( std::size_t size, uses_frame_pool &node )
+        {
+            return allocate( size, node.framePool() );
+        }
+
+        //! other coroutines returning a node_task allocate from the heap
+        static void *operator new( std::size_t size ) { return allocate( size, nullptr ); }
+
+        static void operator delete( void *frame, std::size_t size ) { deallocate( frame, size ); }
+
+        //! matches the operator new taking the node, for a frame whose
+        //! construction failed
+        static void operator delete( void *frame, std::size_t size, uses_frame_pool & ) { deallocate( frame, size ); }
+
+        node_task get_return_object() { return node_task( std::coroutine_handle< promise_type >::from_promise( *this ) ); }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+
+        //! co_await on an inlet of the node waits for its next value
+        template< typename T, typename P >
+        auto await_transform( Inlet< T, P > &inlet );
+
+        template< typename A >
+        A &&await_transform( A &&awaitable ) { return std::forward< A >( awaitable ); }
+
+        CoroutineNodeBase *node = nullptr;
+        std::exception_ptr error;
+
+    private:
+        //! room for the pool a frame came from, in front of the frame
+        static constexpr std::size_t header =
+                ( sizeof( std::shared_ptr< arena > ) + alignof( std::max_align_t ) - 1 )
+                / alignof( std::max_align_t ) * alignof( std::max_align_t );
+
+        static void *allocate( std::size_t size, const std::shared_ptr< arena > &pool )
+        {
+            auto p = static_cast< char * >( pool ? pool->allocate( size + header ) : ::operator new( size + header ) );
+            new ( p ) std::shared_ptr< arena >( pool );
+            return p + header;
+        }
+
+        //! Gives a frame back to where allocate() took it from. The pool is
+        //! moved out of the header, which leaves nothing there to destroy,
+        //! and released once the frame is returned to it.
+        static void deallocate( void *frame, std::size_t size )
+        {
+            auto p = static_cast< char * >( frame ) - header;
+            auto pool = std::move( *reinterpret_cast< std::shared_ptr< arena > * >( p ) );
+            if ( pool ) {
+                pool->deallocate( p, size + header );
+            } else {
+                ::operator delete( p );
+            }
+        }
+    };
+
+    typedef std::coroutine_handle< promise_type > handle_type;
+
+    node_task() = default;
+
+    explicit node_task( handle_type handle ) : mHandle( handle ) {}
+
+    node_task( node_task &&other ) noexcept : mHandle( std::exchange( other.mHandle, {} ) ) {}
+
+    node_task &operator=( node_task &&other ) noexcept
+    {
+        std::swap( mHandle, other.mHandle );
+        return *this;
+    }
+
+    ~node_task()
+    {
+        if ( mHandle ) mHandle.destroy();
+    }
+
+    explicit operator bool() const { return bool( mHandle ); }
+
+    promise_type &promise() { return mHandle.promise(); }
+
+    bool done() const { return ! mHandle || mHandle.done(); }
+
+    //! runs the coroutine until it next suspends, and rethrows what it threw
+    void resume()
+    {
+        mHandle.resume();
+        if ( auto error = std::exchange( mHandle.promise().error, nullptr ) ) std::rethrow_exception( error );
+    }
+
+private:
+    handle_type mHandle;
+};
+
+//! The part of a CoroutineNode that does not depend on its xlets: the body,
+//! the inlet it waits for, and the values that arrived at other inlets.
+class CoroutineNodeBase : public uses_frame_pool
+{
+public:
+    //! Starts the body, running it up to the first co_await. Called by the
+    //! first value received otherwise.
+    void start()
+    {
+        std::lock_guard< std::recursive_mutex > lock( mMutex );
+        startLocked();
+    }
+
+    //! whether the body has returned or thrown
+    bool finished() const { return mStarted && mTask.done(); }
+
+protected:
+    static constexpr std::size_t none = std::size_t( -1 );
+
+    virtual node_task body() = 0;
+
+    struct inlet_state_base
+    {
+        virtual ~inlet_state_base() = default;
+
+        const void *inlet = nullptr;
+    };
+
+    template< typename T >
+    struct inlet_state : inlet_state_base
+    {
+        //! the value being handed to the body when it is resumed for it
+        T *offered = nullptr;
+        //! values that arrived while the body waited for another inlet
+        std::deque< T > buffered;
+    };
+
+    template< typename T >
+    struct inlet_awaiter
+    {
+        bool await_ready() const { return ! state.buffered.empty(); }
+
+        void await_suspend( std::coroutine_handle<> ) { node.mAwaiting = index; }
+
+        T await_resume()
+        {
+            if ( state.offered ) {
+                T value( std::move( *state.offered ) );
+                state.offered = nullptr;
+                return value;
+            }
+            T value( std::move( state.buffered.front() ) );
+            state.buffered.pop_front();
+            return value;
+        }
+
+        CoroutineNodeBase &node;
+        inlet_state< T > &state;
+        std::size_t index;
+    };
+
+    template< typename T, typename P >
+    inlet_awaiter< T > awaiter( Inlet< T, P > &inlet )
+    {
+        auto index = inlet.getIndex();
+        if ( index >= mStates.size() || mStates[ index ]->inlet != &inlet ) {
+            throw std::logic_error( "a node body can only co_await its own inlets" );
+        }
+        return inlet_awaiter< T >{ *this, static_cast< inlet_state< T > & >( *mStates[ index ] ), index };
+    }
+
+    //! listens to \a inlet, the one at \a index
+    template< typename I >
+    void listen( I &inlet, std::size_t index )
+    {
+        typedef typename I::type type;
+        auto state = std::make_unique< inlet_state< type > >();
+        state->inlet = &inlet;
+        auto &s = *state;
+        mStates.push_back( std::move( state ) );
+        inlet.onReceive( [this, &s, index]( type data ) {
+            std::lock_guard< std::recursive_mutex > lock( mMutex );
+            startLocked();
+            if ( mTask.done() ) return;
+            if ( mAwaiting == index && ! mRunning ) {
+                s.offered = &data;
+                resume();
+            } else {
+                s.buffered.push_back( std::move( data ) );
+            }
+        } );
+    }
+
+private:
+    friend struct node_task::promise_type;
+
+    void startLocked()
+    {
+        if ( mStarted ) return;
+        mStarted = true;
+        mTask = body();
+        mTask.promise().node = this;
+        resume();
+    }
+
+    void resume()
+    {
+        mRunning = true;
+        mAwaiting = none;
+        struct stop
+        {
+            ~stop() { running = false; }
+            bool &running;
+        } s{ mRunning };
+        mTask.resume();
+    }
+
+    std::recursive_mutex mMutex;
+    std::vector< std::unique_ptr< inlet_state_base > > mStates;
+    node_task mTask;
+    std::size_t mAwaiting = none;
+    bool mStarted = false;
+    bool mRunning = false;
+};
+
+template< typename T, typename P >
+auto node_task::promise_type::await_transform( Inlet< T, P > &inlet )
+{
+    if ( ! node ) throw std::logic_error( "only node bodies can co_await inlets" );
+    return node->awaiter( inlet );
+}
+
+//! A node whose behaviour is a coroutine instead of inlet listeners, for
+//! protocols that would otherwise need a hand written state machine. The
+//! body co_awaits the next value of one inlet at a time, and updates
+//! outlets in between:
+//!
+//!     node_task body() override
+//!     {
+//!         while ( true ) {
+//!             int a = co_await in< 0 >();
+//!             int b = co_await in< 1 >();
+//!             out< 0 >().update( a + b );
+//!         }
+//!     }
+//!
+//! A value that arrives at the inlet the body waits for resumes it right
+//! away, on the thread that sent the value, and is moved into it when sent
+//! as an rvalue. Values that arrive at other inlets are kept, in order,
+//! until the body asks for them. The body starts with the first value
+//! received, or with start().
+//!
+//! Frames come from the arena of the Graph the node is added to, so
+//! starting bodies does not allocate once the arena has warmed up; without a
+//! graph they come from the heap. Suspending never allocates, but values
+//! kept for an inlet the body is not waiting for are queued on the heap.
+//! Values sent from several threads, like the branches of an Executor
+//! fan-out, are handed to the body one at a time; to run the body off the
+//! senders' threads, attach an Actor. What the body throws is rethrown to
+//! the sender of the value that resumed it, and ends the body.
+//!
+//! Only available when compiling with coroutine support (C++20), which
+//! defines LIBNODES_COROUTINES.
+template< typename Ti, typename To >
+class CoroutineNode : public Node< Ti, To >, public CoroutineNodeBase
+{
+public:
+    typedef CoroutineNode< Ti, To > coroutine_node_type;
+
+    CoroutineNode( const std::string &label = "" ) : Node< Ti, To >( label )
+    {
+        std::size_t i = 0;
+        this->inlets().each( [&]( auto &inlet ) { listen( inlet, i++ ); } );
+    }
+
+    using Node< Ti, To >::in;
+    using Node< Ti, To >::out;
+};
+
+}
+
+#endif
@@ -0,0 +1,534 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "libnodes/arena.h"
+#include "libnodes/dispatch_hooks.h"
+#include "libnodes/executor_base.h"
+
+namespace nodes {
+
+class Executor;
+
+//! Tells when jobs handed to an Executor without waiting for them, see
+//! Executor::forEachAsync, have finished. Destroying a token waits for its
+//! jobs, so they never outlive what they were given.
+class completion_token
+{
+public:
+    completion_token() = default;
+
+    completion_token( completion_token && ) = default;
+
+    completion_token &operator=( completion_token &&other )
+    {
+        finish();
+        mState = std::move( other.mState );
+        return *this;
+    }
+
+    ~completion_token() { finish(); }
+
+    //! whether all jobs have finished; a default constructed token has none
+    bool done() const { return ! mState || mState->join.pending.load( std::memory_order_acquire ) == 0; }
+
+    //! Runs the jobs of this token that no worker has taken yet, waits for
+    //! the others to finish, then rethrows the first exception one of them
+    //! threw.
+    inline void wait();
+
+private:
+    friend class Executor;
+
+    //! allocated from \a resource, \a size bytes of it
+    struct state
+    {
+        state( memory_resource *r, std::size_t s ) : resource( r ), size( s ), jobs( r ) {}
+        virtual ~state() = default;
+
+        memory_resource *resource;
+        std::size_t size;
+        Executor *executor = nullptr;
+        executor_join join;
+        resource_vector< executor_job > jobs;
+    };
+
+    //! destroys a state and gives its memory back to its resource
+    struct deleter
+    {
+        void operator()( state *s ) const
+        {
+            auto resource = s->resource;
+            auto size = s->size;
+            s->~state();
+            resource->deallocate( s, size );
+        }
+    };
+
+    explicit completion_token( std::unique_ptr< state, deleter > s ) : mState( std::move( s ) ) {}
+
+    void finish()
+    {
+        if ( ! mState ) return;
+        try {
+            wait();
+        } catch ( ... ) {
+        }
+    }
+
+    std::unique_ptr< state, deleter > mState;
+};
+
+//! A lock free work-stealing deque of jobs (Chase and Lev). The owning
+//! thread pushes and takes at the bottom; other threads steal from the top.
+class work_stealing_deque
+{
+public:
+    explicit work_stealing_deque( std::size_t capacity = 256 )
+    {
+        mArrays.emplace_back( new array( capacity ) );
+        mArray.store( mArrays.back().get(), std::memory_order_relaxed );
+    }
+
+    work_stealing_deque( const work_stealing_deque & ) = delete;
+
+    work_stealing_deque &operator=( const work_stealing_deque & ) = delete;
+
+    //! adds \a job at the bottom; only called by the owning thread
+    void push( executor_job *job )
+    {
+        auto b = mBottom.load( std::memory_order_relaxed );
+        auto t = mTop.load( std::memory_order_acquire );
+        auto a = mArray.load( std::memory_order_relaxed );
+        if ( b - t > std::int64_t( a->capacity ) - 1 ) a = grow( a, t, b );
+        a->put( b, job );
+        mBottom.store( b + 1, std::memory_order_seq_cst );
+    }
+
+    //! removes the job at the bottom, or returns nullptr; only called by
+    //! the owning thread
+    executor_job *take()
+    {
+        auto b = mBottom.load( std::memory_order_relaxed ) - 1;
+        auto a = mArray.load( std::memory_order_relaxed );
+        mBottom.store( b, std::memory_order_seq_cst );
+        auto t = mTop.load( std::memory_order_seq_cst );
+        if ( t > b ) {
+            mBottom.store( b + 1, std::memory_order_relaxed );
+            return nullptr;
+        }
+        auto job = a->get( b );
+        if ( t == b ) {
+            // the last job: race thieves for it
+            if ( ! mTop.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) ) {
+                job = nullptr;
+            }
+            mBottom.store( b + 1, std::memory_order_relaxed );
+        }
+        return job;
+    }
+
+    //! removes the job at the top, or returns nullptr if there is none or
+    //! another thread got it first; called by any thread
+    executor_job *steal()
+    {
+        auto t = mTop.load( std::memory_order_seq_cst );
+        auto b = mBottom.load( std::memory_order_seq_cst );
+        if ( t >= b ) return nullptr;
+        auto job = mArray.load( std::memory_order_acquire )->get( t );
+        if ( ! mTop.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) ) {
+            return nullptr;
+        }
+        return job;
+    }
+
+    bool empty() const
+    {
+        return mBottom.load( std::memory_order_seq_cst ) <= mTop.load( std::memory_order_seq_cst );
+    }
+
+private:
+    struct array
+    {
+        explicit array( std::size_t c ) : capacity( c ), slots( new std::atomic< executor_job * >[ c ] ) {}
+
+        executor_job *get( std::int64_t i ) const { return slots[ i & ( capacity - 1 ) ].load( std::memory_order_relaxed ); }
+        void put( std::int64_t i, executor_job *job ) { slots[ i & ( capacity - 1 ) ].store( job, std::memory_order_relaxed ); }
+
+        std::size_t capacity;
+        std::unique_ptr< std::atomic< executor_job * >[] > slots;
+    };
+
+    //! doubles the capacity. Thieves may still read the old array, so it is
+    //! kept until the deque is destroyed.
+    array *grow( array *a, std::int64_t t, std::int64_t b )
+    {
+        auto bigger = new array( a->capacity * 2 );
+        for ( auto i = t; i < b; ++i ) bigger->put( i, a->get( i ) );
+        mArrays.emplace_back( bigger );
+        mArray.store( bigger, std::memory_order_release );
+        return bigger;
+    }
+
+    std::atomic< std::int64_t > mTop{ 0 };
+    std::atomic< std::int64_t > mBottom{ 0 };
+    std::atomic< array * > mArray{ nullptr };
+    std::vector< std::unique_ptr< array > > mArrays;
+};
+
+//! A pool of worker threads that runs the branches of a fan-out in parallel.
+//!
+//! While an executor is current on a thread, see scope and run(), an outlet
+//! with several connections forks one job per connection: the calling
+//! thread runs the last one itself and pushes the others onto its own deque,
+//! where idle workers steal them. The outlet joins the jobs before its update
+//! returns, running those of them no worker has taken yet while it waits, so
+//! updates stay synchronous and the value can be shared by reference. It
+//! never runs unrelated jobs while waiting, so a wait only nests as deep as
+//! the forks it joins. Workers are current on their own threads, so forks
+//! nest.
+//!
+//! Branches that meet again at a node with several inlets, like BundleNode,
+//! run concurrently, so such nodes have to be thread safe; nodes using the
+//! multithread_policy are.
+class Executor : public executor_base
+{
+public:
+    //! starts \a threads workers; 0 means one per hardware thread
+    explicit Executor( std::size_t threads = 0 )
+    {
+        if ( threads == 0 ) threads = std::max( 1u, std::thread::hardware_concurrency() );
+        for ( std::size_t i = 0; i < threads; ++i ) mWorkers.emplace_back( new worker );
+        for ( std::size_t i = 0; i < threads; ++i ) {
+            mWorkers[ i ]->thread = std::thread( [this, i] { work( i ); } );
+        }
+    }
+
+    Executor( const Executor & ) = delete;
+
+    Executor &operator=( const Executor & ) = delete;
+
+    ~Executor()
+    {
+        {
+            std::lock_guard< std::mutex > lock( mSleepMutex );
+            mStopping = true;
+        }
+        mWake.notify_all();
+        for ( auto &w : mWorkers ) w->thread.join();
+    }
+
+    std::size_t size() const override { return mWorkers.size(); }
+
+    //! Runs \a fn on the calling thread with this executor current, so the
+    //! updates it makes fan out in parallel.
+    template< typename F >
+    void run( F &&fn )
+    {
+        scope s( *this );
+        fn();
+    }
+
+    //! Calls \a fn with every element of \a items on the workers, \a chunk
+    //! elements per job, and returns right away with a token to wait on.
+    //! The token keeps \a items and \a fn until the jobs have finished; this
+    //! executor must outlive it.
+    template< typename T, typename F >
+    completion_token forEachAsync( std::vector< T > items, F &&fn, std::size_t chunk = 1 )
+    {
+        return forEachAsync( std::make_move_iterator( items.begin() ), std::make_move_iterator( items.end() ),
+                             std::forward< F >( fn ), chunk );
+    }
+
+    //! Like the above, with a copy of [\a begin, \a end). The token, the copy
+    //! and the jobs come from an arena of this executor, so once tokens have
+    //! been given back this only allocates for copies larger than
+    //! arena::max_pooled.
+    template< typename It, typename F >
+    completion_token forEachAsync( It begin, It end, F &&fn, std::size_t chunk = 1 )
+    {
+        typedef typename std::iterator_traits< It >::value_type value_type;
+        typedef typename std::decay< F >::type function_type;
+        struct state : completion_token::state
+        {
+            state( memory_resource *r, F &&f )
+                : completion_token::state( r, sizeof( state ) ), items( r ), function( std::forward< F >( f ) ), starts( r )
+            {
+            }
+
+            resource_vector< value_type > items;
+            function_type function;
+            resource_vector< std::size_t > starts;
+        };
+        static_assert( alignof( state ) <= alignof( std::max_align_t ), "over-aligned functions are not supported" );
+
+        if ( begin == end ) return completion_token();
+        chunk = std::max< std::size_t >( chunk, 1 );
+        auto memory = mStates.allocate( sizeof( state ) );
+        state *raw;
+        try {
+            raw = new ( memory ) state( &mStates, std::forward< F >( fn ) );
+        } catch ( ... ) {
+            mStates.deallocate( memory, sizeof( state ) );
+            throw;
+        }
+        std::unique_ptr< state, completion_token::deleter > s( raw );
+        s->executor = this;
+        s->items.assign( begin, end );
+        s->starts.reserve( ( s->items.size() + chunk - 1 ) / chunk + 1 );
+        for ( std::size_t i = 0; i < s->items.size(); i += chunk ) s->starts.push_back( i );
+        s->starts.push_back( s->items.size() );
+        s->jobs.reserve( s->starts.size() - 1 );
+        for ( std::size_t j = 0; j + 1 < s->starts.size(); ++j ) {
+            s->jobs.push_back( executor_job{ &invokeChunk< state >, s.get(), &s->starts[ j ], &s->join } );
+        }
+        s->join.pending.store( s->jobs.size(), std::memory_order_relaxed );
+        for ( auto &job : s->jobs ) push( &job );
+        wake();
+        return completion_token( std::move( s ) );
+    }
+
+    //! Queues \a job to run on a worker without waiting for it. The job must
+    //! stay alive until it has run; its join is not touched.
+    void submit( executor_job &job )
+    {
+        push( &job );
+        wake();
+    }
+
+    //! Like submit(), but queues \a job behind every job waiting to be
+    //! taken from outside, even when called on a worker, whose own deque
+    //! would run it next. For jobs that resubmit themselves, so that they
+    //! take turns with the others.
+    void requeue( executor_job &job )
+    {
+        {
+            std::lock_guard< std::mutex > lock( mInjectMutex );
+            mInjected.push_back( &job );
+            mHasInjected.store( true );
+        }
+        wake();
+    }
+
+    //! the executor current on the calling thread, or nullptr
+    static Executor *current() { return static_cast< Executor * >( dispatch_hooks::local().executor ); }
+
+    //! Makes an executor current on the calling thread for its lifetime.
+    class scope
+    {
+    public:
+        explicit scope( Executor &executor ) : mBinding( &dispatch_hooks::executor, &executor ) {}
+
+    private:
+        dispatch_hooks::binding< executor_base > mBinding;
+    };
+
+private:
+    friend class completion_token;
+
+    struct worker
+    {
+        work_stealing_deque deque;
+        std::thread thread;
+    };
+
+    //! the worker of the calling thread, if it is a worker of any executor
+    struct worker_context
+    {
+        Executor *executor;
+        work_stealing_deque *deque;
+    };
+
+    static worker_context &threadWorker()
+    {
+        static thread_local worker_context context{ nullptr, nullptr };
+        return context;
+    }
+
+    //! the deque of the calling thread, if it is one of this executor's workers
+    work_stealing_deque *ownDeque()
+    {
+        auto &context = threadWorker();
+        return context.executor == this ? context.deque : nullptr;
+    }
+
+    //! runs the elements of a forEachAsync from the start \a job.item points
+    //! to up to the next start
+    template< typename S >
+    static void invokeChunk( executor_job &job )
+    {
+        auto &s = *static_cast< S * >( job.function );
+        auto start = static_cast< std::size_t * >( job.item );
+        try {
+            for ( auto i = start[ 0 ]; i < start[ 1 ]; ++i ) s.function( s.items[ i ] );
+        } catch ( ... ) {
+            std::lock_guard< std::mutex > lock( job.join->errorMutex );
+            if ( ! job.join->error ) job.join->error = std::current_exception();
+        }
+        job.join->pending.fetch_sub( 1, std::memory_order_acq_rel );
+    }
+
+    void fork( executor_job *jobs, std::size_t count ) override
+    {
+        for ( std::size_t i = 0; i < count; ++i ) push( &jobs[ i ] );
+        wake();
+    }
+
+    void join( executor_join &join ) override { wait( join ); }
+
+    void push( executor_job *job )
+    {
+        if ( auto deque = ownDeque() ) {
+            deque->push( job );
+        } else {
+            std::lock_guard< std::mutex > lock( mInjectMutex );
+            mInjected.push_back( job );
+            mHasInjected.store( true );
+        }
+    }
+
+    //! Wakes sleeping workers after jobs were pushed. Pushing and checking
+    //! for sleepers here, and announcing sleep and checking for jobs in
+    //! work(), are sequentially consistent, so one side always sees the other.
+    void wake()
+    {
+        if ( mSleeping.load() == 0 ) return;
+        std::lock_guard< std::mutex > lock( mSleepMutex );
+        mWake.notify_all();
+    }
+
+    bool hasJobs() const
+    {
+        if ( mHasInjected.load() ) return true;
+        for ( auto &w : mWorkers ) {
+            if ( ! w->deque.empty() ) return true;
+        }
+        return false;
+    }
+
+    //! finds a job: from the calling worker's own deque, then jobs pushed
+    //! from outside, then by stealing from another worker
+    executor_job *find( std::size_t &victim )
+    {
+        auto deque = ownDeque();
+        if ( deque ) {
+            if ( auto job = deque->take() ) return job;
+        }
+        if ( mHasInjected.load() ) {
+            std::lock_guard< std::mutex > lock( mInjectMutex );
+            if ( ! mInjected.empty() ) {
+                auto job = mInjected.front();
+                mInjected.pop_front();
+                mHasInjected.store( ! mInjected.empty() );
+                return job;
+            }
+        }
+        for ( std::size_t i = 0; i < mWorkers.size(); ++i ) {
+            victim = ( victim + 1 ) % mWorkers.size();
+            if ( &mWorkers[ victim ]->deque == deque ) continue;
+            if ( auto job = mWorkers[ victim ]->deque.steal() ) return job;
+        }
+        return nullptr;
+    }
+
+    //! Runs the jobs of \a join that are still queued, and waits until the
+    //! others have finished.
+    void wait( executor_join &join )
+    {
+        while ( join.pending.load( std::memory_order_acquire ) > 0 ) {
+            if ( auto job = findOwn( join ) ) {
+                job->run( *job );
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    //! Finds a job of \a join: at the bottom of the calling worker's own
+    //! deque, where the jobs of the innermost fork are, or among the jobs
+    //! pushed from outside.
+    executor_job *findOwn( executor_join &join )
+    {
+        if ( auto deque = ownDeque() ) {
+            if ( auto job = deque->take() ) {
+                if ( job->join == &join ) return job;
+                // the rest of the fork was stolen; leave the outer one be
+                deque->push( job );
+            }
+        }
+        if ( mHasInjected.load() ) {
+            std::lock_guard< std::mutex > lock( mInjectMutex );
+            auto it = std::find_if( mInjected.begin(), mInjected.end(), [&]( executor_job *job ) { return job->join == &join; } );
+            if ( it != mInjected.end() ) {
+                auto job = *it;
+                mInjected.erase( it );
+                mHasInjected.store( ! mInjected.empty() );
+                return job;
+            }
+        }
+        return nullptr;
+    }
+
+    void work( std::size_t index )
+    {
+        scope s( *this );
+        threadWorker() = worker_context{ this, &mWorkers[ index ]->deque };
+        std::size_t victim = index;
+        std::size_t idle = 0;
+        while ( true ) {
+            if ( auto job = find( victim ) ) {
+                job->run( *job );
+                idle = 0;
+                continue;
+            }
+            if ( ++idle < 64 ) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock< std::mutex > lock( mSleepMutex );
+            if ( mStopping ) return;
+            mSleeping.fetch_add( 1 );
+            if ( ! hasJobs() ) mWake.wait( lock );
+            mSleeping.fetch_sub( 1 );
+            if ( mStopping ) return;
+            idle = 0;
+        }
+    }
+
+    std::vector< std::unique_ptr< worker > > mWorkers;
+
+    //! where forEachAsync() allocates its tokens from, and the queue of jobs
+    //! pushed from outside its chunks
+    arena mStates;
+
+    std::mutex mInjectMutex;
+    std::deque< executor_job *, resource_allocator< executor_job * > > mInjected{ &mStates };
+    std::atomic< bool > mHasInjected{ false };
+
+    std::mutex mSleepMutex;
+    std::condition_variable mWake;
+    std::atomic< std::size_t > mSleeping{ 0 };
+    bool mStopping = false;
+};
+
+void completion_token::wait()
+{
+    if ( ! mState ) return;
+    mState->executor->wait( mState->join );
+    if ( auto error = std::exchange( mState->join.error, nullptr ) ) std::rethrow_exception( error );
+}
+
+}
@@ -0,0 +1,836 @@
+#pragma once
+
+#include "libnodes/Node.h"
+#include "libnodes/arena.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace nodes {
+
+class Graph;
+
+//! A node whose work a Graph can schedule. Its inlet listeners only store
+//! what they receive and call invalidate(), see latch(); the work that
+//! depends on all of its inputs is done in evaluate().
+class Evaluable
+{
+public:
+    virtual ~Evaluable();
+
+    //! does the work of the node, and updates its outlets
+    virtual void evaluate() = 0;
+
+    //! Asks for evaluate() to be called. Outside of a graph it is called
+    //! right away; in a graph, once during the next Graph::tick(), or when
+    //! something downstream is pulled with Graph::pull().
+    inline void invalidate();
+
+    //! whether a graph decides when this node is evaluated
+    bool scheduled() const { return mGraph != nullptr; }
+
+protected:
+    //! Keeps the latest value \a inlet receives in \a value, and invalidates
+    //! this node whenever it does.
+    template< typename I, typename T >
+    connection latch( I &inlet, T &value )
+    {
+        return inlet.onReceive( [this, &value]( typename I::type received ) {
+            value = std::move( received );
+            invalidate();
+        } );
+    }
+
+private:
+    friend class Graph;
+
+    Graph *mGraph = nullptr;
+    std::size_t mEntry = 0;
+};
+
+//! A connection from an outlet of a node of a Graph to an inlet of another
+//! node of it, see adjacency_snapshot.
+struct adjacency_edge
+{
+    //! the index of the outlet on its node
+    std::uint32_t outlet;
+    //! the position of the node of the inlet in the snapshot
+    std::uint32_t node;
+    //! the index of the inlet on its node
+    std::uint32_t inlet;
+};
+
+//! The connections between the nodes of a Graph, frozen into compressed
+//! sparse rows: the edges leaving node i are edges()[ offsets()[ i ] ] up
+//! to edges()[ offsets()[ i + 1 ] ], in the order of its outlets and their
+//! connections. Passes over the whole graph can walk these arrays in order
+//! instead of chasing pointers from outlet to inlet to node.
+//!
+//! Connections to nodes outside the graph are left out. Kept up to date by
+//! Graph::adjacency(), which only revisits the nodes whose connections
+//! changed since, see topology_log.
+class adjacency_snapshot
+{
+public:
+    //! the number of nodes
+    std::size_t size() const { return mNodes.size(); }
+
+    NodeConcept &node( std::size_t i ) const { return *mNodes[ i ]; }
+
+    //! the connections leaving node \a i
+    span< const adjacency_edge > edges( std::size_t i ) const
+    {
+        return span< const adjacency_edge >( mEdges.data() + mOffsets[ i ], mOffsets[ i + 1 ] - mOffsets[ i ] );
+    }
+
+    span< const std::size_t > offsets() const { return mOffsets; }
+    span< const adjacency_edge > edges() const { return mEdges; }
+
+    //! the version of the topology_log of the graph the snapshot reflects
+    std::uint64_t version() const { return mVersion; }
+
+private:
+    friend class Graph;
+
+    explicit adjacency_snapshot( memory_resource *resource ) :
+            mNodes( resource_allocator< NodeConcept * >( resource ) ),
+            mOffsets( 1, 0, resource_allocator< std::size_t >( resource ) ),
+            mEdges( resource_allocator< adjacency_edge >( resource ) )
+    {}
+
+    resource_vector< NodeConcept * > mNodes;
+    resource_vector< std::size_t > mOffsets;
+    resource_vector< adjacency_edge > mEdges;
+    std::uint64_t mVersion = 0;
+    //! the version of topology_log::shared() it reflects
+    std::uint64_t mSharedVersion = 0;
+};
+
+//! A set of nodes evaluated in topological order.
+//!
+//! tick() evaluates every invalidated Evaluable node of the graph exactly
+//! once, after all of the nodes upstream of it. In a diamond A -> B, A -> C,
+//! B + C -> D, D is evaluated once, with the values of both B and C, instead
+//! of once for each of them. Like BundleNode waiting for all of its inlets,
+//! but for the whole graph: invalidated nodes are kept in a bitset ordered
+//! by rank, which tick() scans once.
+//!
+//! Instead of ticking, a graph can be evaluated lazily: invalidating a node
+//! only marks it and everything downstream of it stale, and pull() brings
+//! one node up to date by evaluating just the invalidated nodes upstream of
+//! it. Nodes nobody pulls are never evaluated. Graphs keep track of stale
+//! nodes only once pull() or isStale() was first called, so those that are
+//! only ticked do not pay for it.
+//!
+//! The order only follows connections between nodes of the graph. It is
+//! cached, and sorted again when connections from its nodes change, which
+//! the graph follows in a topology_log of its own. Nodes in a
+//! cycle are ordered after what feeds the cycle and before what it feeds,
+//! in the order they were added, and a node invalidated by something
+//! downstream of it is evaluated in the next tick. Nodes may be added,
+//! removed, connected and destroyed while the graph evaluates them: those
+//! removed are not evaluated anymore, and the others take their new place
+//! in the order from the next tick or pull on. Evaluable nodes leave
+//! their graph when destroyed; other nodes must be removed first. Since ids
+//! are reused, the graph tells nodes apart by id and generation, so a node
+//! that takes the id of one destroyed without being removed replaces it
+//! when added. A graph is used by one thread at a time.
+//!
+//! The connections between the nodes of a graph can be read from a
+//! snapshot, see adjacency(), which the order is computed from too.
+//!
+//! Nodes made with create() live in an arena owned by the graph, together
+//! with their slot lists and connections and the graph's own bookkeeping,
+//! so building a large graph hardly touches the heap, and destroying it
+//! releases all of that at once. Nodes that allocate coroutine frames, see
+//! uses_frame_pool, get theirs from the arena too, which the frames keep
+//! alive once the graph is gone.
+class Graph : private Noncopyable
+{
+public:
+    static constexpr std::size_t npos = std::numeric_limits< std::size_t >::max();
+
+    Graph() :
+            mArena( std::make_shared< arena >() ),
+            mEntries( resource_allocator< entry >( mArena.get() ) ),
+            mIndex( resource_allocator< std::size_t >( mArena.get() ) ),
+            mCreated( resource_allocator< created_node >( mArena.get() ) ),
+            mOrder( resource_allocator< std::size_t >( mArena.get() ) ),
+            mDirty( resource_allocator< std::uint64_t >( mArena.get() ) ),
+            mSuccessorBegin( resource_allocator< std::size_t >( mArena.get() ) ),
+            mSuccessors( resource_allocator< std::size_t >( mArena.get() ) ),
+            mPredecessorBegin( resource_allocator< std::size_t >( mArena.get() ) ),
+            mPredecessors( resource_allocator< std::size_t >( mArena.get() ) ),
+            mDetached( resource_allocator< std::size_t >( mArena.get() ) ),
+            mPending( resource_allocator< std::size_t >( mArena.get() ) ),
+            mRanks( resource_allocator< std::size_t >( mArena.get() ) ),
+            mIndegree( resource_allocator< std::size_t >( mArena.get() ) ),
+            mFilled( resource_allocator< std::size_t >( mArena.get() ) ),
+            mCycles( mArena.get() ),
+            mAdjacency( mArena.get() ),
+            mSpareEdges( resource_allocator< adjacency_edge >( mArena.get() ) ),
+            mRawEdges( resource_allocator< raw_edge >( mArena.get() ) ),
+            mChanged( resource_allocator< std::size_t >( mArena.get() ) ),
+            mTopology( std::make_shared< topology_log >() )
+    {}
+
+    ~Graph()
+    {
+        for ( auto &e : mEntries ) {
+            if ( e.evaluable ) e.evaluable->mGraph = nullptr;
+        }
+        for ( auto it = mCreated.rbegin(); it != mCreated.rend(); ++it ) it->destroy( it->node );
+    }
+
+    //! Constructs a node of type \a N from \a args in the arena of the
+    //! graph, and adds it. What the node allocates while it is built, and
+    //! for connections from its outlets and listeners of its inlets later
+    //! on, comes from the arena too, see memory_resource. The graph destroys
+    //! the nodes it created when it is destroyed, last created first, so
+    //! connection handles to them must not outlive it.
+    template< typename N, typename... Args >
+    N &create( Args &&... args )
+    {
+        memory_resource::scope scope( *mArena );
+        auto p = mArena->allocate( sizeof( N ), alignof( N ) );
+        N *node;
+        try {
+            node = new ( p ) N( std::forward< Args >( args )... );
+        } catch ( ... ) {
+            mArena->deallocate( p, sizeof( N ), alignof( N ) );
+            throw;
+        }
+        mCreated.push_back( created_node{ node, &destroyNode< N > } );
+        add( *node );
+        return *node;
+    }
+
+    //! the arena nodes made with create() live in, and coroutine frames
+    //! come from
+    arena &memory() { return *mArena; }
+
+    //! adds \a node to the graph, unless it already belongs to it
+    template< typename N >
+    void add( N &node )
+    {
+        auto stale = indexOf( node.id() );
+        if ( stale != npos ) {
+            if ( mEntries[ stale ].generation == node.generation() ) return;
+            // the id belonged to a node destroyed without being removed
+            detach( stale );
+        }
+
+        if ( node.id() >= mIndex.size() ) mIndex.resize( node.id() + 1, std::size_t( npos ) );
+        mIndex[ node.id() ] = mEntries.size();
+        mEntries.push_back( entry{ &node, &node, node.id(), node.generation(), &edgesOf< N >, evaluableOf( node, std::is_base_of< Evaluable, N >{} ), false, false, npos } );
+        if ( auto evaluable = mEntries.back().evaluable ) {
+            evaluable->mGraph = this;
+            evaluable->mEntry = mEntries.size() - 1;
+        }
+        shareFramePool( node, std::is_base_of< uses_frame_pool, N >{} );
+        logTopology( node, true );
+        mSorted = false;
+        mAdjacent = false;
+    }
+
+    //! removes \a node from the graph, dropping any pending evaluation
+    template< typename N >
+    void remove( N &node )
+    {
+        auto index = indexOf( node );
+        if ( index == npos ) return;
+        logTopology( node, false );
+        detach( index );
+    }
+
+    bool contains( const NodeConcept &node ) const { return indexOf( node ) != npos; }
+
+    std::size_t size() const { return mEntries.size(); }
+
+    //! where the connection changes of the nodes of this graph are recorded
+    const topology_log &topology() const { return *mTopology; }
+
+    //! Evaluates every invalidated node once, in topological order. Nodes
+    //! invalidated by those evaluations are evaluated in the same tick.
+    void tick()
+    {
+        sort();
+        evaluation evaluating( *this );
+        for ( auto rank = nextDirty( 0 ); rank != npos; rank = nextDirty( rank + 1 ) ) {
+            mDirty[ rank / 64 ] &= ~( std::uint64_t( 1 ) << ( rank % 64 ) );
+            auto &e = mEntries[ mOrder[ rank ] ];
+            e.dirty = false;
+            e.evaluable->evaluate();
+        }
+        if ( mLazy ) restale();
+    }
+
+    //! Brings \a node up to date: evaluates the invalidated nodes upstream of
+    //! it, and itself if it is invalidated, in topological order. Does
+    //! nothing if \a node is not stale.
+    template< typename N >
+    void pull( N &node )
+    {
+        trackStaleness();
+        auto index = indexOf( node );
+        // nodes added while evaluating are not ranked until it is done
+        if ( index == npos || ! mEntries[ index ].stale || mEntries[ index ].rank == npos ) return;
+        evaluation evaluating( *this );
+
+        // stale nodes are closed downstream, so every invalidated ancestor
+        // is reachable through stale predecessors
+        // evaluating may pull other nodes, which stack their ranks above
+        // these, so they are read by position and popped when done
+        struct rank_frame
+        {
+            ~rank_frame() { ranks.resize( begin ); }
+
+            resource_vector< std::size_t > &ranks;
+            std::size_t begin;
+        } frame{ mRanks, mRanks.size() };
+        mPending.assign( 1, index );
+        mEntries[ index ].stale = false;
+        while ( ! mPending.empty() ) {
+            auto i = mPending.back();
+            mPending.pop_back();
+            mRanks.push_back( mEntries[ i ].rank );
+            for ( auto p = mPredecessorBegin[ i ]; p < mPredecessorBegin[ i + 1 ]; ++p ) {
+                auto &e = mEntries[ mPredecessors[ p ] ];
+                if ( ! e.stale ) continue;
+                e.stale = false;
+                mPending.push_back( mPredecessors[ p ] );
+            }
+        }
+        auto end = mRanks.size();
+        std::sort( mRanks.begin() + frame.begin, mRanks.end() );
+
+        for ( auto r = frame.begin; r < end; ++r ) {
+            auto rank = mRanks[ r ];
+            auto &e = mEntries[ mOrder[ rank ] ];
+            if ( ! e.dirty ) continue;
+            mDirty[ rank / 64 ] &= ~( std::uint64_t( 1 ) << ( rank % 64 ) );
+            e.dirty = false;
+            e.evaluable->evaluate();
+        }
+
+        // evaluating marked the pulled nodes stale again on the way
+        bool feedback = false;
+        for ( auto r = frame.begin; r < end; ++r ) {
+            auto &e = mEntries[ mOrder[ mRanks[ r ] ] ];
+            e.stale = e.dirty;
+            feedback = feedback || e.dirty;
+        }
+        if ( feedback ) restale();
+    }
+
+    //! whether \a node or anything upstream of it is invalidated
+    bool isStale( const NodeConcept &node )
+    {
+        trackStaleness();
+        auto index = indexOf( node );
+        return index != npos && mEntries[ index ].stale;
+    }
+
+    //! the ids of the nodes, in the order tick() evaluates them
+    std::vector< std::uint64_t > order()
+    {
+        sort();
+        std::vector< std::uint64_t > ids;
+        for ( auto e : mOrder ) ids.push_back( mEntries[ e ].id );
+        return ids;
+    }
+
+    //! The connections between the nodes of the graph, whose node i is
+    //! the i-th node added, until nodes are removed. Only the nodes whose
+    //! outgoing connections changed since the last call are visited again,
+    //! unless nodes were added or removed, or too much changed.
+    const adjacency_snapshot &adjacency()
+    {
+        auto &shared = *topology_log::shared();
+        auto version = mTopology->version(), sharedVersion = shared.version();
+        if ( mAdjacent && version == mAdjacency.mVersion && sharedVersion == mAdjacency.mSharedVersion ) return mAdjacency;
+
+        auto &changed = mChanged;
+        changed.clear();
+        auto note = [&]( std::uint64_t id ) {
+            auto index = indexOf( id );
+            if ( index != npos ) changed.push_back( index );
+        };
+        if ( mAdjacent ) {
+            mAdjacent = mTopology->since( mAdjacency.mVersion, version, note )
+                        && shared.since( mAdjacency.mSharedVersion, sharedVersion, note );
+        }
+        if ( mAdjacent ) {
+            std::sort( changed.begin(), changed.end() );
+            changed.erase( std::unique( changed.begin(), changed.end() ), changed.end() );
+        } else {
+            mAdjacency.mNodes.clear();
+            for ( auto &e : mEntries ) mAdjacency.mNodes.push_back( e.base );
+            changed.resize( mEntries.size() );
+            for ( std::size_t i = 0; i < changed.size(); ++i ) changed[ i ] = i;
+            mAdjacency.mOffsets.assign( mEntries.size() + 1, 0 );
+            mAdjacency.mEdges.clear();
+        }
+
+        // copy the rows that did not change, and revisit the others
+        auto &offsets = mAdjacency.mOffsets;
+        mSpareEdges.clear();
+        auto next = changed.begin();
+        std::size_t begin = 0;
+        for ( std::size_t i = 0; i < mEntries.size(); ++i ) {
+            auto end = offsets[ i + 1 ];
+            offsets[ i ] = mSpareEdges.size();
+            if ( next != changed.end() && *next == i ) {
+                ++next;
+                // nodes removed during an evaluation have no edges
+                if ( mEntries[ i ].node ) mEntries[ i ].edges( mEntries[ i ].node, mRawEdges );
+                for ( auto &raw : mRawEdges ) {
+                    auto index = indexOf( raw.node, raw.generation );
+                    if ( index != npos ) mSpareEdges.push_back( adjacency_edge{ raw.outlet, std::uint32_t( index ), raw.inlet } );
+                }
+                mRawEdges.clear();
+            } else {
+                auto &edges = mAdjacency.mEdges;
+                mSpareEdges.insert( mSpareEdges.end(), edges.begin() + begin, edges.begin() + end );
+            }
+            begin = end;
+        }
+        offsets[ mEntries.size() ] = mSpareEdges.size();
+        mAdjacency.mEdges.swap( mSpareEdges );
+        mAdjacency.mVersion = version;
+        mAdjacency.mSharedVersion = sharedVersion;
+        mAdjacent = true;
+        return mAdjacency;
+    }
+
+    //! the position of \a node in order(), or npos if it does not belong
+    //! to the graph
+    std::size_t rank( const NodeConcept &node )
+    {
+        auto index = indexOf( node );
+        if ( index == npos ) return npos;
+        sort();
+        return mEntries[ index ].rank;
+    }
+
+private:
+    friend class Evaluable;
+
+    //! a connection as found on a node, to a node given by id
+    struct raw_edge
+    {
+        std::uint32_t outlet;
+        std::uint64_t node;
+        std::uint64_t generation;
+        std::uint32_t inlet;
+    };
+
+    struct entry
+    {
+        void *node;
+        NodeConcept *base;
+        std::uint64_t id;
+        //! the generation of the node, see HasId, which ids are reused by
+        std::uint64_t generation;
+        void ( *edges )( void *, resource_vector< raw_edge > & );
+        Evaluable *evaluable;
+        bool dirty;
+        //! whether this or anything upstream of it is dirty
+        bool stale;
+        std::size_t rank;
+    };
+
+    template< typename N >
+    static void edgesOf( void *node, resource_vector< raw_edge > &edges )
+    {
+        static_cast< N * >( node )->outlets().each( [&]( auto &outlet ) {
+            for ( auto &inlet : outlet.connections() ) {
+                auto n = inlet.get().node();
+                if ( n ) edges.push_back( raw_edge{ std::uint32_t( outlet.getIndex() ), n->id(), n->generation(), std::uint32_t( inlet.get().getIndex() ) } );
+            }
+        } );
+    }
+
+    //! a node made by create(), and how to destroy it
+    struct created_node
+    {
+        void *node;
+        void ( *destroy )( void * );
+    };
+
+    //! destroys a node made by create(); its memory goes with the arena
+    template< typename N >
+    static void destroyNode( void *node ) { static_cast< N * >( node )->~N(); }
+
+    template< typename N >
+    static Evaluable *evaluableOf( N &node, std::true_type ) { return &node; }
+
+    template< typename N >
+    static Evaluable *evaluableOf( N &, std::false_type ) { return nullptr; }
+
+    template< typename N >
+    void shareFramePool( N &node, std::true_type ) { node.setFramePool( mArena ); }
+
+    template< typename N >
+    void shareFramePool( N &, std::false_type ) {}
+
+    //! Points the outlets of \a node at the topology_log of the graph when
+    //! it joins, and away from it when it leaves. The outlets of a node in
+    //! several graphs use the log shared by all of them instead. Nodes keep
+    //! the log of a graph destroyed before them, which nothing reads.
+    template< typename N >
+    void logTopology( N &node, bool join )
+    {
+        node.outlets().each( [&]( auto &outlet ) {
+            OutletBase &o = outlet;
+            if ( ! join ) {
+                if ( o.mTopology == mTopology ) o.mTopology.reset();
+            } else if ( ! o.mTopology || o.mTopology == mTopology ) {
+                o.mTopology = mTopology;
+            } else {
+                o.mTopology = topology_log::shared();
+            }
+        } );
+    }
+
+    static std::size_t lowestBit( std::uint64_t bits )
+    {
+#if defined( __GNUC__ ) || defined( __clang__ )
+        return __builtin_ctzll( bits );
+#else
+        std::size_t i = 0;
+        while ( ! ( bits & 1 ) ) {
+            bits >>= 1;
+            ++i;
+        }
+        return i;
+#endif
+    }
+
+    void markDirty( std::size_t index )
+    {
+        auto &e = mEntries[ index ];
+        if ( e.dirty ) return;
+        e.dirty = true;
+        // nodes added since the last sort are ranked by the next one
+        if ( e.rank == npos ) return;
+        mDirty[ e.rank / 64 ] |= std::uint64_t( 1 ) << ( e.rank % 64 );
+        if ( ! mSorted || ! mLazy ) return;
+
+        // mark everything downstream stale, stopping at nodes that already are
+        mPending.assign( 1, index );
+        e.stale = true;
+        while ( ! mPending.empty() ) {
+            auto i = mPending.back();
+            mPending.pop_back();
+            for ( auto s = mSuccessorBegin[ i ]; s < mSuccessorBegin[ i + 1 ]; ++s ) {
+                auto &next = mEntries[ mSuccessors[ s ] ];
+                if ( next.stale ) continue;
+                next.stale = true;
+                mPending.push_back( mSuccessors[ s ] );
+            }
+        }
+    }
+
+    //! sorts the graph, and from now on keeps track of which nodes are
+    //! stale, which only pull() and isStale() need
+    void trackStaleness()
+    {
+        sort();
+        if ( mLazy ) return;
+        mLazy = true;
+        restale();
+    }
+
+    //! recomputes which nodes are stale from those that are dirty
+    void restale()
+    {
+        for ( auto &e : mEntries ) e.stale = e.dirty;
+        for ( auto i : mOrder ) {
+            if ( ! mEntries[ i ].stale ) continue;
+            for ( auto s = mSuccessorBegin[ i ]; s < mSuccessorBegin[ i + 1 ]; ++s ) {
+                mEntries[ mSuccessors[ s ] ].stale = true;
+            }
+        }
+    }
+
+    //! the entry of the node with \a id, or npos
+    std::size_t indexOf( std::uint64_t id ) const { return id < mIndex.size() ? mIndex[ id ] : npos; }
+
+    //! the entry of the node with \a id in its \a generation, or npos
+    std::size_t indexOf( std::uint64_t id, std::uint64_t generation ) const
+    {
+        auto index = indexOf( id );
+        return index != npos && mEntries[ index ].generation == generation ? index : npos;
+    }
+
+    std::size_t indexOf( const NodeConcept &node ) const { return indexOf( node.id(), node.generation() ); }
+
+    //! Marks tick() or pull() evaluating nodes, which index the entries by
+    //! rank, so that entries detached meanwhile are only removed once the
+    //! outermost one returns.
+    struct evaluation
+    {
+        explicit evaluation( Graph &graph ) : graph( graph ) { ++graph.mEvaluating; }
+
+        ~evaluation()
+        {
+            if ( --graph.mEvaluating == 0 ) graph.removeDetached();
+        }
+
+        Graph &graph;
+    };
+
+    void detach( std::size_t index )
+    {
+        auto &e = mEntries[ index ];
+        if ( e.evaluable ) e.evaluable->mGraph = nullptr;
+        // a node added while evaluating may have taken the id already
+        if ( mIndex[ e.id ] == index ) mIndex[ e.id ] = npos;
+        mAdjacent = false;
+        if ( mEvaluating ) {
+            // leave an empty entry in place, nothing evaluates
+            if ( e.dirty && e.rank != npos ) mDirty[ e.rank / 64 ] &= ~( std::uint64_t( 1 ) << ( e.rank % 64 ) );
+            e.node = nullptr;
+            e.base = nullptr;
+            e.evaluable = nullptr;
+            e.dirty = false;
+            e.stale = false;
+            mDetached.push_back( index );
+            return;
+        }
+        if ( index != mEntries.size() - 1 ) {
+            mEntries[ index ] = mEntries.back();
+            mIndex[ mEntries[ index ].id ] = index;
+            if ( mEntries[ index ].evaluable ) mEntries[ index ].evaluable->mEntry = index;
+        }
+        mEntries.pop_back();
+        mSorted = false;
+    }
+
+    //! removes the entries detached while evaluating, last first so that
+    //! none is moved before it is removed
+    void removeDetached()
+    {
+        if ( mDetached.empty() ) return;
+        std::sort( mDetached.begin(), mDetached.end() );
+        for ( auto it = mDetached.rbegin(); it != mDetached.rend(); ++it ) detach( *it );
+        mDetached.clear();
+    }
+
+    //! the first invalidated rank at or after \a rank, or npos
+    std::size_t nextDirty( std::size_t rank ) const
+    {
+        for ( auto w = rank / 64; w < mDirty.size(); ++w ) {
+            auto bits = mDirty[ w ];
+            if ( w == rank / 64 ) bits &= ~std::uint64_t( 0 ) << ( rank % 64 );
+            if ( bits ) return w * 64 + lowestBit( bits );
+        }
+        return npos;
+    }
+
+    //! ranks the nodes with Kahn's algorithm, if anything changed since the
+    //! last time
+    void sort()
+    {
+        // the order is kept while it is being evaluated
+        if ( mEvaluating ) return;
+        if ( mSorted && mTopology->version() == mVersion && topology_log::shared()->version() == mSharedVersion ) return;
+
+        auto size = mEntries.size();
+        auto &adjacent = adjacency();
+        auto &indegree = mIndegree;
+        indegree.assign( size, 0 );
+        mSuccessorBegin.assign( adjacent.offsets().begin(), adjacent.offsets().end() );
+        mSuccessors.clear();
+        for ( auto &edge : adjacent.edges() ) {
+            mSuccessors.push_back( edge.node );
+            ++indegree[ edge.node ];
+        }
+
+        mPredecessorBegin.assign( size + 1, 0 );
+        for ( std::size_t i = 0; i < size; ++i ) mPredecessorBegin[ i + 1 ] = mPredecessorBegin[ i ] + indegree[ i ];
+        mPredecessors.resize( mSuccessors.size() );
+        auto &filled = mFilled;
+        filled.assign( mPredecessorBegin.begin(), mPredecessorBegin.end() - 1 );
+        for ( std::size_t i = 0; i < size; ++i ) {
+            for ( auto s = mSuccessorBegin[ i ]; s < mSuccessorBegin[ i + 1 ]; ++s ) {
+                mPredecessors[ filled[ mSuccessors[ s ] ]++ ] = i;
+            }
+        }
+
+        mOrder.clear();
+        for ( std::size_t i = 0; i < size; ++i ) {
+            if ( indegree[ i ] == 0 ) mOrder.push_back( i );
+        }
+        for ( std::size_t next = 0; next < mOrder.size(); ++next ) {
+            auto i = mOrder[ next ];
+            for ( auto s = mSuccessorBegin[ i ]; s < mSuccessorBegin[ i + 1 ]; ++s ) {
+                if ( --indegree[ mSuccessors[ s ] ] == 0 ) mOrder.push_back( mSuccessors[ s ] );
+            }
+        }
+        // whatever is left is part of, or downstream of, a cycle
+        if ( mOrder.size() < size ) orderCycles( indegree );
+
+        mDirty.assign(( size + 63 ) / 64, 0 );
+        for ( std::size_t rank = 0; rank < size; ++rank ) {
+            auto &e = mEntries[ mOrder[ rank ] ];
+            e.rank = rank;
+            if ( e.dirty ) mDirty[ rank / 64 ] |= std::uint64_t( 1 ) << ( rank % 64 );
+        }
+        if ( mLazy ) restale();
+        mVersion = adjacent.mVersion;
+        mSharedVersion = adjacent.mSharedVersion;
+        mSorted = true;
+    }
+
+    //! Appends the entries Kahn's algorithm left, those with a nonzero
+    //! \a indegree, to mOrder: their strongly connected components, found
+    //! with Tarjan's algorithm, in topological order, and the entries of each
+    //! component in the order they were added.
+    void orderCycles( const resource_vector< std::size_t > &indegree )
+    {
+        auto size = mEntries.size();
+        auto &index = mCycles.index, &low = mCycles.low, &stack = mCycles.stack, &members = mCycles.members,
+             &componentBegin = mCycles.componentBegin;
+        auto &onStack = mCycles.onStack;
+        auto &calls = mCycles.calls;
+        typedef cycle_scratch::frame frame;
+        index.assign( size, std::size_t( npos ) );
+        low.assign( size, 0 );
+        onStack.assign( size, false );
+        stack.clear();
+        members.clear();
+        componentBegin.clear();
+        calls.clear();
+        std::size_t counter = 0;
+        auto enter = [&]( std::size_t i ) {
+            index[ i ] = low[ i ] = counter++;
+            stack.push_back( i );
+            onStack[ i ] = true;
+            calls.push_back( frame{ i, mSuccessorBegin[ i ] } );
+        };
+
+        for ( std::size_t root = 0; root < size; ++root ) {
+            if ( indegree[ root ] == 0 || index[ root ] != npos ) continue;
+            enter( root );
+            while ( ! calls.empty() ) {
+                auto i = calls.back().node;
+                if ( calls.back().next < mSuccessorBegin[ i + 1 ] ) {
+                    auto next = mSuccessors[ calls.back().next++ ];
+                    if ( index[ next ] == npos ) {
+                        enter( next );
+                    } else if ( onStack[ next ] ) {
+                        low[ i ] = std::min( low[ i ], index[ next ] );
+                    }
+                    continue;
+                }
+                calls.pop_back();
+                if ( ! calls.empty() ) low[ calls.back().node ] = std::min( low[ calls.back().node ], low[ i ] );
+                if ( low[ i ] != index[ i ] ) continue;
+
+                // i is the root of a component, which is complete
+                componentBegin.push_back( members.size() );
+                std::size_t member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    onStack[ member ] = false;
+                    members.push_back( member );
+                } while ( member != i );
+                std::sort( members.begin() + componentBegin.back(), members.end() );
+            }
+        }
+
+        // components are completed downstream first
+        componentBegin.push_back( members.size() );
+        for ( auto c = componentBegin.size() - 1; c-- > 0; ) {
+            mOrder.insert( mOrder.end(), members.begin() + componentBegin[ c ], members.begin() + componentBegin[ c + 1 ] );
+        }
+    }
+
+    //! shared with the coroutine frames of the nodes, which may outlive the
+    //! graph
+    std::shared_ptr< arena > mArena;
+    resource_vector< entry > mEntries;
+    //! entry indices by node id, npos for nodes of other graphs
+    resource_vector< std::size_t > mIndex;
+    resource_vector< created_node > mCreated;
+    //! entry indices by rank
+    resource_vector< std::size_t > mOrder;
+    //! invalidated ranks
+    resource_vector< std::uint64_t > mDirty;
+    //! the successors and predecessors of each entry within the graph,
+    //! the ones of entry i starting at index i of the Begin arrays
+    resource_vector< std::size_t > mSuccessorBegin, mSuccessors, mPredecessorBegin, mPredecessors;
+    //! the versions of mTopology and of the shared topology_log sorted for
+    std::uint64_t mVersion = 0, mSharedVersion = 0;
+    bool mSorted = false;
+    //! the number of tick() and pull() calls evaluating nodes, see evaluation
+    std::size_t mEvaluating = 0;
+    //! the entries detached while evaluating, see removeDetached()
+    resource_vector< std::size_t > mDetached;
+    //! whether stale nodes are tracked, see trackStaleness()
+    bool mLazy = false;
+    //! scratch space for marking and pulling stale nodes
+    resource_vector< std::size_t > mPending;
+    //! the ranks of the nodes being pulled, those of nested pulls on top
+    resource_vector< std::size_t > mRanks;
+    //! scratch space for sort()
+    resource_vector< std::size_t > mIndegree, mFilled;
+    //! scratch space for orderCycles()
+    struct cycle_scratch
+    {
+        //! a node whose successors are being followed, and the next one
+        struct frame
+        {
+            std::size_t node;
+            std::size_t next;
+        };
+
+        explicit cycle_scratch( memory_resource *resource ) :
+                index( resource_allocator< std::size_t >( resource ) ),
+                low( resource_allocator< std::size_t >( resource ) ),
+                stack( resource_allocator< std::size_t >( resource ) ),
+                members( resource_allocator< std::size_t >( resource ) ),
+                componentBegin( resource_allocator< std::size_t >( resource ) ),
+                onStack( resource_allocator< bool >( resource ) ),
+                calls( resource_allocator< frame >( resource ) )
+        {}
+
+        resource_vector< std::size_t > index, low, stack, members, componentBegin;
+        resource_vector< bool > onStack;
+        resource_vector< frame > calls;
+    } mCycles;
+    adjacency_snapshot mAdjacency;
+    //! whether mAdjacency holds the current nodes
+    bool mAdjacent = false;
+    //! scratch space for adjacency()
+    resource_vector< adjacency_edge > mSpareEdges;
+    resource_vector< raw_edge > mRawEdges;
+    //! the entries whose rows adjacency() revisits
+    resource_vector< std::size_t > mChanged;
+    //! shared with the outlets of the nodes, which may outlive the graph
+    std::shared_ptr< topology_log > mTopology;
+};
+
+inline Evaluable::~Evaluable()
+{
+    if ( mGraph ) mGraph->detach( mEntry );
+}
+
+inline void Evaluable::invalidate()
+{
+    if ( mGraph ) {
+        mGraph->markDirty( mEntry );
+    } else {
+        evaluate();
+    }
+}
+
+}
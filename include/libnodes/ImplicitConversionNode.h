@@ -2,9 +2,27 @@
 
 #include "libnodes/Node.h"
 #include <memory>
+#include <vector>
 
 namespace nodes {
 
+//! Converts every value of \a batch with \a convert, and sends the results
+//! to \a node's outlet as one batch. \a buffer keeps its capacity from one
+//! batch to the next, and is swapped out while sending so that a batch
+//! arriving in the meantime gets a buffer of its own.
+template< typename N, typename To, typename From, typename F >
+void convertBatch( N &node, std::vector< To > &buffer, span< const From > batch, F convert )
+{
+    std::vector< To > converted;
+    converted.swap( buffer );
+    converted.clear();
+    for ( const auto &from : batch ) {
+        converted.push_back( convert( from ) );
+    }
+    node.template out< 0 >().update_batch( converted );
+    buffer.swap( converted );
+}
+
 template< typename Tfrom, typename Tto >
 class ImplicitConversionNode : public Node< Inlets < Tfrom >, Outlets< Tto > >
 {
@@ -14,8 +32,13 @@ public:
     {
         this->template in< 0 >().onReceive( [&]( const Tfrom &from ) {
             this->template out< 0 >().update( from );
+        }, [&]( span< const Tfrom > batch ) {
+            convertBatch( *this, mConverted, batch, []( const Tfrom &from ) -> Tto { return from; } );
         });
     }
+
+private:
+    std::vector< Tto > mConverted;
 };
 
 
@@ -29,8 +52,15 @@ public:
     {
         this->template in< 0 >().onReceive( [&]( const std::shared_ptr< Tfrom > &from ) {
             this->template out< 0 >().update( std::dynamic_pointer_cast< Tto >( from ) );
+        }, [&]( span< const std::shared_ptr< Tfrom > > batch ) {
+            convertBatch( *this, mConverted, batch, []( const std::shared_ptr< Tfrom > &from ) {
+                return std::dynamic_pointer_cast< Tto >( from );
+            } );
         });
     }
+
+private:
+    std::vector< std::shared_ptr< Tto > > mConverted;
 };
 
 
@@ -1,13 +1,28 @@
 #pragma once
 
+#include <algorithm>
+#include <condition_variable>
 #include <cstddef>
 #include <tuple>
 #include <array>
 #include <type_traits>
+#include <utility>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 #include "libnodes/nod_signal.h"
 #include "libnodes/connection_container.h"
+#include "libnodes/span.h"
+#include "libnodes/id_allocator.h"
+#include "libnodes/label_pool.h"
+#include "libnodes/dispatch_hooks.h"
+#include "libnodes/work_queue.h"
+#include "libnodes/executor_base.h"
+#include "libnodes/actor_base.h"
+#include "libnodes/spsc_queue.h"
 #include "libnodes/xlet_iterator.h"
 
 namespace nodes {
@@ -23,13 +38,51 @@ class INode;
 template< class o_node_t >
 using INodeRef = ref< INode< o_node_t > >;
 
-template< class T > using signal = nod::signal< T >;
+//! Threading policy for graphs whose inlets may be fed from several threads
+typedef nod::multithread_policy multithread_policy;
+//! Threading policy for graphs that never cross threads; inlets do no locking
+typedef nod::singlethread_policy singlethread_policy;
+//! Threading policy used when none is specified
+typedef multithread_policy default_thread_policy;
+
+template< class T, class P = default_thread_policy > using signal = nod::signal_type< P, T >;
 typedef nod::connection connection;
 
 template< typename out_t >
 class Outlet;
 template< typename in_t >
+class TypedInlet;
+template< typename in_t, typename P = default_thread_policy >
 class Inlet;
+template< typename T >
+class async_connection;
+class Executor;
+class completion_token;
+class Actor;
+
+//! \a T, as a type that depends on \a U. Members of class templates that use
+//! types only declared here, like Executor, name them through it, so they
+//! are checked once instantiated, in code that includes their header.
+template< typename T, typename U >
+struct dependent_type
+{
+    typedef T type;
+};
+
+//! What an async_connection does with an update when its queue is full.
+enum class overflow_policy
+{
+    //! the update waits until the receiving thread has made room, yielding
+    //! a few times and then sleeping until pump() wakes it
+    block,
+    //! the oldest queued value is dropped to make room
+    drop_oldest,
+    //! the update is dropped
+    drop_newest,
+    //! like drop_oldest, and pump() only delivers the newest of the values
+    //! queued, for streams where only the latest value matters
+    coalesce_latest
+};
 
 class AnyNode;
 class NodeBase;
@@ -52,18 +105,71 @@ protected:
     Noncopyable &operator=( const Noncopyable & ) = delete;
 };
 
-//! provides derived classes with automatically assigned, globally unique
-//! numeric identifiers
+//! Inspects the argument of a listener callable. For lambdas and function
+//! pointers with a single, non-template argument, \a argument_type is that
+//! argument; for anything else it is void.
+template< typename F, typename = void >
+struct listener_traits
+{
+    typedef void argument_type;
+};
+
+template< typename R, typename A >
+struct listener_traits< R ( * )( A ) >
+{
+    typedef A argument_type;
+};
+
+template< typename C, typename R, typename A >
+struct listener_traits< R ( C::* )( A ) >
+{
+    typedef A argument_type;
+};
+
+template< typename C, typename R, typename A >
+struct listener_traits< R ( C::* )( A ) const > : listener_traits< R ( C::* )( A ) > {};
+
+template< typename F >
+struct listener_traits< F, decltype( void( &F::operator() ) ) > : listener_traits< decltype( &F::operator() ) > {};
+
+//! Whether a listener F takes a T by value or by rvalue reference, and can
+//! therefore take ownership of what it receives.
+template< typename F, typename T, typename A = typename listener_traits< typename std::decay< F >::type >::argument_type >
+struct takes_ownership : std::integral_constant< bool,
+        std::is_same< typename std::decay< A >::type, T >::value && ! std::is_lvalue_reference< A >::value > {};
+
+//! Provides derived classes with automatically assigned numeric
+//! identifiers, unique among the live objects of the same \a Category. Ids
+//! are dense and reused once their object is destroyed, see id_allocator,
+//! so they can index flat side tables; nodes and xlets count separately. A
+//! copy gets an id of its own.
+template< typename Category >
 class HasId
 {
 public:
-    HasId() : mId( sId++ ) {}
+    HasId() : mId( ids().acquire() ), mGeneration( ids().generation() ) {}
+
+    HasId( const HasId & ) : HasId() {}
+
+    HasId &operator=( const HasId & ) { return *this; }
+
+    ~HasId() { ids().release( mId ); }
 
     uint64_t id() const { return mId; }
 
+    //! tells this apart from earlier and later holders of its id()
+    uint64_t generation() const { return mGeneration; }
+
+    //! the allocator of the ids of this category
+    static id_allocator &ids()
+    {
+        static id_allocator allocator;
+        return allocator;
+    }
+
 protected:
-    static uint64_t sId;
-    uint64_t mId;
+    id_allocator::id_type mId;
+    uint64_t mGeneration;
 };
 
 
@@ -75,6 +181,7 @@ public:
 
 
     virtual uint64_t id() const = 0;
+    virtual uint64_t generation() const = 0;
 
     virtual void setLabel( const std::string &label ) = 0;
     virtual std::string getLabel() const = 0;
@@ -128,35 +235,28 @@ public:
 };
 
 //! Makes it possible to pass and call methods upon nodes without knowing their types.
+//! Holds a pointer to the node and to a static table of the operations that
+//! need its concrete type, so it is cheap to copy and never allocates.
 class AnyNode : virtual public NodeConcept
 {
-    struct Concept : virtual public NodeConcept
-    {
-        virtual ~Concept() = default;
-
-        virtual NodeBase& get() = 0;
-        virtual const NodeBase& get() const = 0;
-
-        template< typename V >
-        void accept( V & visitor )
-        {
-            acceptDispatch( &visitor );
-        }
+public:
+    //! a connection from an outlet to an inlet
+    typedef std::pair< OutletBase *, InletBase * > connection_type;
 
-        virtual void acceptDispatch( VisitorBase * ) = 0;
+private:
+    struct VTable
+    {
+        void ( *acceptDispatch )( NodeBase &, VisitorBase * );
+        void ( *visitDispatch )( NodeBase &, VisitorBase * );
+        void ( *connections )( NodeBase &, resource_vector< connection_type > & );
     };
 
     template< typename T >
-    struct Model : public Concept
+    struct Model
     {
-        Model( T &n ) : node( n ) {}
-
-        NodeBase& get() override { return node; }
-        const NodeBase& get() const override { return node; }
-
-
-        void acceptDispatch( VisitorBase * v ) override
+        static void acceptDispatch( NodeBase & n, VisitorBase * v )
         {
+            auto &node = static_cast< T & >( n );
             auto typedVisitor = dynamic_cast< Visitor< T >* >( v );
             if ( typedVisitor ) {
                 node.accept( *typedVisitor );
@@ -168,46 +268,79 @@ class AnyNode : virtual public NodeConcept
             }
         }
 
-        uint64_t id() const override { return node.id(); }
+        static void visitDispatch( NodeBase & n, VisitorBase * v )
+        {
+            auto &node = static_cast< T & >( n );
+            auto typedVisitor = dynamic_cast< Visitor< T >* >( v );
+            if ( typedVisitor ) {
+                typedVisitor->visit( node );
+            } else {
+                auto genericVisitor = dynamic_cast< Visitor< NodeBase >* >( v );
+                if ( genericVisitor ) {
+                    genericVisitor->visit( node );
+                }
+            }
+        }
 
-        void setLabel( const std::string &label ) override { return node.setLabel( label ); }
-        std::string getLabel() const override { return node.getLabel(); }
-        const std::string &label() const override { return node.label(); }
-        std::string &label() override { return node.label(); }
-        std::size_t num_inlets() const override { return node.num_inlets(); };
-        std::size_t num_outlets() const override { return node.num_outlets(); };
+        static void connections( NodeBase & n, resource_vector< connection_type > & out )
+        {
+            static_cast< T & >( n ).outlets().each( [&]( auto &outlet ) {
+                for ( auto &inlet : outlet.connections() ) out.emplace_back( &outlet, &inlet.get() );
+            } );
+        }
 
-    private:
-        T &node;
+        static const VTable vtable;
     };
 
-    std::unique_ptr< Concept > mConcept;
+    NodeBase *mNode = nullptr;
+    const VTable *mVTable = nullptr;
 public:
 
-    template< typename T >
+    AnyNode() = default;
+
+    //! a non-const AnyNode is copied, not wrapped
+    template< typename T, typename = typename std::enable_if< ! std::is_same< T, AnyNode >::value >::type >
     AnyNode( T &node ) :
-            mConcept( new Model< T >( node )) {}
+            mNode( &node ),
+            mVTable( &Model< T >::vtable ) {}
 
-    operator NodeBase& () { return mConcept->get(); }
-    operator const NodeBase& () const { return mConcept->get(); }
+    explicit operator bool() const { return mNode != nullptr; }
+
+    operator NodeBase& () { return *mNode; }
+    operator const NodeBase& () const { return *mNode; }
 
 
     template< typename V >
     void accept( V & visitor )
     {
-        mConcept->accept( visitor );
+        mVTable->acceptDispatch( *mNode, &visitor );
+    }
+
+    //! has \a visitor visit this node only, not what it is connected to
+    template< typename V >
+    void acceptNode( V & visitor )
+    {
+        mVTable->visitDispatch( *mNode, &visitor );
     }
 
-    uint64_t id() const override { return mConcept->id(); }
+    //! appends the connections from the outlets of this node to \a out
+    void connections( resource_vector< connection_type > & out ) const { mVTable->connections( *mNode, out ); }
 
-    void setLabel( const std::string &label ) override { return mConcept->setLabel( label ); }
-    std::string getLabel() const override { return mConcept->getLabel(); }
-    const std::string &label() const override { return mConcept->label(); }
-    std::string &label() override { return mConcept->label(); }
-    std::size_t num_inlets() const override { return mConcept->num_inlets(); };
-    std::size_t num_outlets() const override { return mConcept->num_outlets(); };
+    uint64_t id() const override;
+    uint64_t generation() const override;
+
+    void setLabel( const std::string &label ) override;
+    std::string getLabel() const override;
+    const std::string &label() const override;
+    std::string &label() override;
+    std::size_t num_inlets() const override;
+    std::size_t num_outlets() const override;
 };
 
+template< typename T >
+const AnyNode::VTable AnyNode::Model< T >::vtable = {
+        &AnyNode::Model< T >::acceptDispatch, &AnyNode::Model< T >::visitDispatch, &AnyNode::Model< T >::connections };
+
 
 
 //! Base class for nodes that can accept visitors. V is the class of the node itself.
@@ -221,7 +354,7 @@ class VisitableNode : public VisitableBase
         outlet_visitor( T &v ) : visitor( v ) {}
 
         template< typename To, typename Ti >
-        void visitConnection( To & o, Ti & i, long )
+        void visitConnection( To &, Ti &, long )
         {
         };
 
@@ -281,23 +414,22 @@ public:
 
 
 
-//! Abstract base class for all inlets.
-//! Abstract base class for all inlets.
-class Xlet : private Noncopyable, public HasId
+//! Abstract base class for all inlets and outlets.
+class Xlet : private Noncopyable, public HasId< Xlet >
 {
 public:
     bool operator<( const Xlet &b ) { return mId < b.mId; }
     bool operator==( const Xlet &b ) { return mId == b.mId; }
 
-    const AnyNode *node() const { return mNode; }
-    AnyNode *node() { return mNode; }
+    const AnyNode *node() const { return mNode ? &mNode : nullptr; }
+    AnyNode *node() { return mNode ? &mNode : nullptr; }
 
     std::size_t getIndex() const { return mIndex; }
     const std::size_t & index() const { return mIndex; }
 
 protected:
     template< typename T >
-    void setNode( T &node ) { mNode = new AnyNode( node ); }
+    void setNode( T &node ) { mNode = AnyNode( node ); }
 
     void setIndex( std::size_t i ) { mIndex = i; }
 
@@ -307,43 +439,243 @@ protected:
     friend class VisitableNode;
 
 
-    AnyNode *mNode = nullptr;
+    AnyNode mNode;
     std::size_t mIndex = 0;
 };
 
 
 class InletBase : public Xlet
 {
+public:
+    virtual ~InletBase() = default;
+};
+
+//! The part of an async_connection that does not depend on its type.
+class async_connection_base
+{
+public:
+    virtual ~async_connection_base() = default;
+
+    virtual std::size_t pump( std::size_t max = std::size_t( -1 ) ) = 0;
+    virtual std::size_t pending() const = 0;
+    //! the number of values queued since the connection was made, whether
+    //! pumped, dropped or still waiting
+    virtual std::size_t pushed() const = 0;
+
+    //! Connects the outlet that feeds this connection to its inlet directly
+    //! again, and disconnects this connection from both. Values still
+    //! queued stay queued.
+    virtual void bypass() = 0;
+
+    //! Makes every update of the connection call \a fn with \a context once
+    //! its value is queued, so that the thread pumping it can sleep while
+    //! the queue is empty. nullptr for none. Must not be called while the
+    //! connection is being updated.
+    void setPushListener( void ( *fn )( void * ), void *context )
+    {
+        mOnPush = fn;
+        mOnPushContext = context;
+    }
+
+protected:
+    void notifyPushed()
+    {
+        if ( mOnPush ) mOnPush( mOnPushContext );
+    }
+
+private:
+    void ( *mOnPush )( void * ) = nullptr;
+    void *mOnPushContext = nullptr;
+};
+
+class frame_scheduler_base;
+
+//! An update an outlet holds back until the end of a frame, see
+//! frame_scheduler. It keeps the latest value the outlet was updated with,
+//! and belongs to the outlet, which reuses it from one frame to the next.
+class scheduled_update
+{
+public:
+    explicit scheduled_update( OutletBase &outlet ) : mOutlet( outlet ) {}
+
+    virtual ~scheduled_update() = default;
+
+    //! sends the value to the inlets of the outlet
+    virtual void deliver() = 0;
+
+    OutletBase &outlet() const { return mOutlet; }
+
+    //! the scheduler holding this update back, or nullptr
+    frame_scheduler_base *heldBy = nullptr;
+    //! where the scheduler delivers this update among the others
+    std::size_t rank = 0;
+    std::uint64_t sequence = 0;
+    //! whether the scheduler delivered it in the flush running now
+    bool delivered = false;
+
+private:
+    OutletBase &mOutlet;
+};
+
+//! The part of a frame_scheduler that outlets record their updates with.
+class frame_scheduler_base
+{
+public:
+    virtual ~frame_scheduler_base() = default;
+
+    //! holds back \a update, the first of its outlet since it was delivered
+    virtual void schedule( scheduled_update &update ) = 0;
+
+    //! counts \a count updates that replaced one held back
+    virtual void coalesce( std::size_t count = 1 ) = 0;
+
+    //! drops \a update, whose outlet is being destroyed
+    virtual void cancel( scheduled_update &update ) = 0;
+
+    //! The frame scheduler used by outlets on the calling thread that have
+    //! none of their own, or nullptr to deliver updates right away.
+    static frame_scheduler_base *current() { return dispatch_hooks::local().scheduler; }
+
+    //! Makes a frame scheduler the default of the calling thread for its
+    //! lifetime.
+    class scope
+    {
+    public:
+        explicit scope( frame_scheduler_base &scheduler ) : mBinding( &dispatch_hooks::scheduler, &scheduler ) {}
+
+    private:
+        dispatch_hooks::binding< frame_scheduler_base > mBinding;
+    };
 };
 
 class OutletBase : public Xlet
 {
+public:
+    //! Replaces the connection to \a in by one through a queue, like
+    //! Outlet::connect_async, for code that only knows the xlets by their
+    //! base classes, like visitors. Returns nullptr if \a in is not
+    //! connected to this outlet.
+    virtual std::unique_ptr< async_connection_base > reconnectAsync( InletBase &in, std::size_t capacity,
+                                                                     overflow_policy policy = overflow_policy::block ) = 0;
+
+    //! Makes this outlet post its updates to \a queue instead of calling its
+    //! inlets directly, whatever the work queue of the calling thread. The
+    //! outlet must outlive any update still waiting in the queue.
+    void setWorkQueue( work_queue *queue ) { hooks().queue = queue; }
+    work_queue *getWorkQueue() const { return mHooks ? mHooks->queue : nullptr; }
+
+    //! Makes updates fan out over the workers of \a executor once this
+    //! outlet has at least \a threshold connections, \a chunk connections
+    //! per job, or spread evenly over the threads if 0. Smaller fan-outs call
+    //! their inlets one after another on the updating thread, even while an
+    //! executor is current. nullptr goes back to fanning out over the
+    //! current executor, if any.
+    void setParallel( executor_base *executor, std::size_t threshold = 16, std::size_t chunk = 0 )
+    {
+        hooks().executor = executor;
+        mParallelThreshold = std::max< std::size_t >( threshold, 2 );
+        mParallelChunk = chunk;
+    }
+
+    executor_base *getParallel() const { return mHooks ? mHooks->executor : nullptr; }
+    std::size_t getParallelThreshold() const { return mParallelThreshold; }
+
+    //! Makes this outlet hold its updates back until \a scheduler is
+    //! flushed, whatever the frame scheduler of the calling thread.
+    void setFrameScheduler( frame_scheduler_base *scheduler ) { hooks().scheduler = scheduler; }
+    frame_scheduler_base *getFrameScheduler() const { return mHooks ? mHooks->scheduler : nullptr; }
+
+    //! The log the connections and disconnections of this outlet are
+    //! recorded in: the one of the Graph its node belongs to, the one
+    //! shared by all graphs if it belongs to several, or nullptr.
+    const std::shared_ptr< topology_log > &topology() const { return mTopology; }
+
+protected:
+    //! Whether updates go straight to the inlets: nothing was set on this
+    //! outlet, and the calling thread has no work queue, frame scheduler or
+    //! executor current, see dispatch_hooks.
+    bool direct() const { return ! mHooks && ! dispatch_hooks::engaged(); }
+
+    //! the work queue updates go through, or nullptr to call inlets directly
+    work_queue *workQueue() const { return resolve( &dispatch_hooks::queue ); }
+
+    //! the frame scheduler updates are held back by, or nullptr
+    frame_scheduler_base *frameScheduler() const { return resolve( &dispatch_hooks::scheduler ); }
+
+    //! the executor current on the updating thread, or nullptr
+    executor_base *threadExecutor() const
+    {
+        auto thread = dispatch_hooks::current();
+        return thread ? thread->executor : nullptr;
+    }
+
+    //! The record of this outlet, made when first needed. From then on,
+    //! updates no longer take the direct path.
+    dispatch_hooks &hooks()
+    {
+        if ( ! mHooks ) mHooks.reset( new dispatch_hooks );
+        return *mHooks;
+    }
+
+    //! how many of \a connections each of \a threads gets in a parallel
+    //! fan-out
+    std::size_t parallelChunk( std::size_t connections, std::size_t threads ) const
+    {
+        return mParallelChunk ? mParallelChunk : ( connections + threads - 1 ) / threads;
+    }
+
+private:
+    //! \a hook of this outlet if set, or else of the calling thread
+    template< typename T >
+    T *resolve( T *dispatch_hooks::*hook ) const
+    {
+        if ( mHooks && ( *mHooks ).*hook ) return ( *mHooks ).*hook;
+        auto thread = dispatch_hooks::current();
+        return thread ? thread->*hook : nullptr;
+    }
+
+    friend class Graph;
+
+    std::unique_ptr< dispatch_hooks > mHooks;
+    //! set by Graph; links point here, so they record their changes in the
+    //! log of the graph of the moment
+    std::shared_ptr< topology_log > mTopology;
+    std::size_t mParallelThreshold = 16;
+    std::size_t mParallelChunk = 0;
 };
 
-//! An Inlet accepts \a in_data_ts to its receive method, and returns
-//! \a read_t from its read method.
+//! The part of an Inlet that does not depend on its threading policy. Outlets
+//! connect to any inlet of their type through this interface.
 template< typename in_t >
-class Inlet : public InletBase
+class TypedInlet : public InletBase
 {
 public:
     typedef in_t type;
-    typedef signal< void( const in_t & ) > receive_signal;
     typedef Outlet< type > outlet_type;
     friend outlet_type;
 
-    virtual void receive( const in_t &data ) { mReceiveSignal( data ); }
+    virtual void receive( const in_t &data ) = 0;
 
-    template< class T >
-    connection onReceive( T &&fn )
+    //! Receives \a data that may be moved from. Inlets that cannot make use
+    //! of that receive it as a const reference.
+    virtual void receive( in_t &&data ) { receive( static_cast< const in_t & >( data ) ); }
+
+    //! Receives several values at once. Inlets that cannot handle a batch
+    //! receive its values one by one.
+    virtual void receive_batch( span< const in_t > batch )
     {
-        return mReceiveSignal.connect( fn );
+        for ( const auto &data : batch ) {
+            receive( data );
+        }
     }
 
 protected:
-    bool connect( outlet_type &out ) { return mConnections.insert( out ); }
     bool disconnect( outlet_type &out ) { return mConnections.erase( out ); }
     void disconnect() { mConnections.clear(); }
 
+    //! the outlets connected to this inlet
+    connection_container< outlet_type > &connections() { return mConnections; }
+
 public:
     bool isConnected() const { return !mConnections.empty(); }
     bool isConnectedTo( const outlet_type &out ) const { return mConnections.contains( out ); }
@@ -351,10 +683,198 @@ public:
     std::size_t numConnections() const { return mConnections.size(); }
 
 private:
-    receive_signal mReceiveSignal;
     connection_container< outlet_type > mConnections;
 };
 
+//! An Inlet accepts \a in_t to its receive method and passes it on to its
+//! onReceive listeners. \a P is the threading policy of the listener signals.
+//!
+//! Listeners are called in the order they were registered. Those that take
+//! \a in_t by value or by rvalue reference get copies, except that when
+//! data is received as an rvalue and the last listener takes ownership, it
+//! gets the data moved in.
+//!
+//! Batches go to onReceiveBatch listeners in one call, and then value by
+//! value to onReceive listeners. Single values go to onReceiveBatch
+//! listeners as batches of one. A listener registered with both a value and
+//! a batch function gets each value once, through whichever fits.
+template< typename in_t, typename P >
+class Inlet : public TypedInlet< in_t >
+{
+public:
+    typedef P thread_policy;
+    typedef span< const in_t > batch_type;
+
+    //! how values reach a listener
+    enum class delivery
+    {
+        //! one value, for every listener
+        value,
+        //! a batch, for listeners that take batches
+        batch,
+        //! one value of a batch, for listeners that do not take batches
+        unrolled
+    };
+
+    //! signal for all listeners, passed the values, the object the last
+    //! one may move from, or nullptr if they must copy, and how the values
+    //! are delivered
+    typedef signal< void( batch_type, in_t *, delivery ), thread_policy > receive_signal;
+
+    using TypedInlet< in_t >::receive;
+
+    //! the actor whose mailbox this inlet posts to, or nullptr if it calls
+    //! its listeners directly
+    actor_base *actor() const { return mActor.load( std::memory_order_acquire ); }
+
+    void receive( const in_t &data ) override
+    {
+        if ( auto actor = this->actor() ) {
+            actor->post( [this, data] { dispatch( data ); } );
+        } else {
+            dispatch( data );
+        }
+    }
+
+    void receive( in_t &&data ) override
+    {
+        if ( auto actor = this->actor() ) {
+            actor->post( [this, data = std::move( data )]() mutable { dispatch( std::move( data ) ); } );
+        } else {
+            dispatch( std::move( data ) );
+        }
+    }
+
+    //! Inlets of an Actor copy the batch into the message they post.
+    void receive_batch( batch_type batch ) override
+    {
+        if ( auto actor = this->actor() ) {
+            actor->post( [this, values = std::vector< in_t >( batch.begin(), batch.end() )] {
+                dispatchBatch( values );
+            } );
+        } else {
+            dispatchBatch( batch );
+        }
+    }
+
+    template< class T >
+    connection onReceive( T &&fn )
+    {
+        return mReceiveSignal.connect( value_listener< typename std::decay< T >::type, takes_ownership< T, in_t >::value >{ std::forward< T >( fn ) } );
+    }
+
+    //! Listens for values with \a fn, and for batches with \a batchFn,
+    //! which gets them in one call instead of \a fn value by value.
+    template< class T, class B >
+    connection onReceive( T &&fn, B &&batchFn )
+    {
+        typedef value_listener< typename std::decay< T >::type, takes_ownership< T, in_t >::value > value_slot;
+        typedef batch_listener< typename std::decay< B >::type > batch_slot;
+        return mReceiveSignal.connect( paired_listener< value_slot, batch_slot >{ { std::forward< T >( fn ) }, { std::forward< B >( batchFn ) } } );
+    }
+
+    //! Listens for batches of values, see receive_batch(). \a fn is called
+    //! with a span< const in_t > that is only valid during the call.
+    template< class T >
+    connection onReceiveBatch( T &&fn )
+    {
+        return mReceiveSignal.connect( batch_listener< typename std::decay< T >::type >{ std::forward< T >( fn ) } );
+    }
+
+private:
+    friend class Actor;
+
+    void setActor( actor_base *actor ) { mActor.store( actor, std::memory_order_release ); }
+
+    void dispatch( const in_t &data )
+    {
+        mReceiveSignal( batch_type( &data, 1 ), nullptr, delivery::value );
+    }
+
+    void dispatch( in_t &&data )
+    {
+        mReceiveSignal.visit_slots( [&]( const typename receive_signal::slot_type &slot, bool last ) {
+            slot( batch_type( &data, 1 ), last ? &data : nullptr, delivery::value );
+        } );
+    }
+
+    void dispatchBatch( batch_type batch )
+    {
+        if ( batch.empty() ) return;
+        mReceiveSignal( batch, nullptr, delivery::batch );
+        for ( const auto &data : batch ) {
+            mReceiveSignal( batch_type( &data, 1 ), nullptr, delivery::unrolled );
+        }
+    }
+
+    //! The slot of an onReceive listener \a F, which holds it directly so
+    //! that it keeps the whole slot capacity.
+    template< typename F, bool Owns >
+    struct value_listener
+    {
+        template< typename G >
+        static auto call( G &fn, batch_type values, in_t *, delivery how, std::false_type ) -> decltype( fn( values[ 0 ] ), void() )
+        {
+            if ( how != delivery::batch ) fn( values[ 0 ] );
+        }
+
+        template< typename G >
+        static auto call( G &fn, batch_type values, in_t *movable, delivery how, std::true_type ) -> decltype( fn( std::move( *movable ) ), void() )
+        {
+            if ( how == delivery::batch ) return;
+            if ( movable ) {
+                fn( std::move( *movable ) );
+            } else {
+                fn( in_t( values[ 0 ] ) );
+            }
+        }
+
+        void operator()( batch_type values, in_t *movable, delivery how ) { call( fn, values, movable, how, std::integral_constant< bool, Owns >{} ); }
+
+        F fn;
+    };
+
+    //! The slot of an onReceiveBatch listener \a F, see value_listener.
+    template< typename F >
+    struct batch_listener
+    {
+        template< typename G >
+        static auto call( G &fn, batch_type values, delivery how ) -> decltype( fn( values ), void() )
+        {
+            if ( how != delivery::unrolled ) fn( values );
+        }
+
+        void operator()( batch_type values, in_t *, delivery how ) { call( fn, values, how ); }
+
+        F fn;
+    };
+
+    //! The slot of a listener registered with a value function \a V and a
+    //! batch function \a B, see value_listener.
+    template< typename V, typename B >
+    struct paired_listener
+    {
+        template< typename W, typename C >
+        static void call( W &onValue, C &onBatch, batch_type values, in_t *movable, delivery how )
+        {
+            if ( how == delivery::value ) {
+                onValue( values, movable, how );
+            } else {
+                onBatch( values, movable, how );
+            }
+        }
+
+        void operator()( batch_type values, in_t *movable, delivery how ) { call( onValue, onBatch, values, movable, how ); }
+
+        V onValue;
+        B onBatch;
+    };
+
+    receive_signal mReceiveSignal;
+    //! a plain pointer under singlethread_policy, like the signal's state
+    typename thread_policy::template atomic_type< actor_base * > mActor{ nullptr };
+};
+
 //! An Outlet connects to an \a out_data_ts Inlet, and is updated with
 //! \a update_t.
 template< typename out_t >
@@ -362,33 +882,134 @@ class Outlet : public OutletBase
 {
 public:
     typedef out_t type;
-    typedef Inlet< type > inlet_type;
+    typedef TypedInlet< type > inlet_type;
+
+    Outlet() = default;
+
+    ~Outlet()
+    {
+        if ( mHeld && mHeld->heldBy ) mHeld->heldBy->cancel( *mHeld );
+    }
 
+    //! Sends \a in to every connected inlet. With a work queue, see
+    //! work_queue, updates caused by this one are queued instead. With a
+    //! frame scheduler, see frame_scheduler, \a in is held back until the
+    //! end of the frame, replacing any value held back before.
     virtual void update( const out_t &in )
     {
-        for ( auto &c : mConnections ) {
-            c.get().receive( in );
+        if ( direct() ) {
+            deliver( in );
+            return;
+        }
+        if ( hold( in ) ) return;
+        auto queue = workQueue();
+        if ( ! queue ) {
+            deliver( in );
+        } else if ( queue->draining() ) {
+            queue->post( [this, in] { deliver( in ); } );
+        } else {
+            queue->run( [&] { deliver( in ); } );
         }
     }
 
-    bool connect( inlet_type &in )
+    //! Sends \a in to every connected inlet. The last one may move from it;
+    //! the others receive it by const reference.
+    virtual void update( out_t &&in )
     {
-        in.connect( *this );
-        return mConnections.insert( in );
+        if ( direct() ) {
+            deliver( std::move( in ) );
+            return;
+        }
+        if ( hold( std::move( in ) ) ) return;
+        auto queue = workQueue();
+        if ( ! queue ) {
+            deliver( std::move( in ) );
+        } else if ( queue->draining() ) {
+            queue->post( [this, moved = std::move( in )]() mutable { deliver( std::move( moved ) ); } );
+        } else {
+            queue->run( [&] { deliver( std::move( in ) ); } );
+        }
     }
 
-    bool disconnect( inlet_type &in )
+    //! Sends all values of \a batch to every connected inlet, in one call
+    //! per inlet. \a batch only needs to stay valid until this returns; a
+    //! work queue that has to defer it keeps a copy. A frame scheduler
+    //! only holds back its last value.
+    virtual void update_batch( span< const out_t > batch )
     {
-        in.disconnect( *this );
-        return mConnections.erase( in );
+        if ( batch.empty() ) return;
+        if ( direct() ) {
+            deliverBatch( batch );
+            return;
+        }
+        if ( hold( batch.back() ) ) {
+            mHeld->heldBy->coalesce( batch.size() - 1 );
+            return;
+        }
+        auto queue = workQueue();
+        if ( ! queue ) {
+            deliverBatch( batch );
+        } else if ( queue->draining() ) {
+            queue->post( [this, copy = std::vector< out_t >( batch.begin(), batch.end() )] { deliverBatch( copy ); } );
+        } else {
+            queue->run( [&] { deliverBatch( batch ); } );
+        }
+    }
+
+    //! Sends \a in to every connected inlet from the workers of the parallel
+    //! executor, see setParallel(), and returns without waiting for them.
+    //! The inlets connected now receive a copy of \a in, even if they are
+    //! disconnected meanwhile, so they must outlive the returned token. Work
+    //! queues are not used. Fan-outs below the threshold, or without a
+    //! parallel executor, are delivered as by update() before this returns.
+    //! Needs Executor.h.
+    typename dependent_type< completion_token, out_t >::type update_async( const out_t &in )
+    {
+        typedef typename dependent_type< Executor, out_t >::type executor_type;
+        typedef typename dependent_type< completion_token, out_t >::type token_type;
+        auto executor = static_cast< executor_type * >( getParallel() );
+        if ( ! executor || mConnections.size() < getParallelThreshold() ) {
+            deliver( in );
+            return token_type();
+        }
+        auto chunk = parallelChunk( mConnections.size(), executor->size() );
+        return executor->forEachAsync( mConnections.begin(), mConnections.end(),
+                                       [in]( typename connections_type::value_type target ) { target.get().receive( in ); }, chunk );
+    }
+
+    //! Connects to \a in, and returns a handle that can disconnect it again
+    //! in constant time. The handle is empty if they were already connected.
+    connection_handle connect( inlet_type &in )
+    {
+        return connection_handle( mConnections.link( in, in.mConnections, *this, &topology(), mNode ? mNode.id() : topology_log::none ) );
+    }
+
+    //! Connects to \a in through a lock free queue of \a capacity values,
+    //! for when this outlet is updated on one thread and \a in should
+    //! receive on another. Updates return once their value is queued;
+    //! \a policy says what happens when the queue is full. The thread of
+    //! \a in delivers the queued values by calling pump() on the returned
+    //! connection, which disconnects both ends when destroyed.
+    std::unique_ptr< async_connection< out_t > > connect_async( inlet_type &in, std::size_t capacity = 1024,
+                                                               overflow_policy policy = overflow_policy::block )
+    {
+        std::unique_ptr< async_connection< out_t > > async( new async_connection< out_t >( in, capacity, policy ) );
+        connect( *async );
+        return async;
     }
 
-    void disconnect()
+    std::unique_ptr< async_connection_base > reconnectAsync( InletBase &in, std::size_t capacity,
+                                                             overflow_policy policy = overflow_policy::block ) override
     {
-        for ( auto &i : mConnections ) i.get().disconnect( *this );
-        mConnections.clear();
+        auto typed = dynamic_cast< inlet_type * >( &in );
+        if ( ! typed || ! disconnect( *typed ) ) return nullptr;
+        return connect_async( *typed, capacity, policy );
     }
 
+    bool disconnect( inlet_type &in ) { return mConnections.erase( in ); }
+
+    void disconnect() { mConnections.clear(); }
+
     bool isConnected() const { return !mConnections.empty(); }
 
     std::size_t numConnections() const { return mConnections.size(); }
@@ -397,7 +1018,275 @@ public:
     const connection_container< inlet_type > &connections() const { return mConnections; }
 
 private:
-    connection_container< inlet_type > mConnections;
+    //! the latest value of an update held back by a frame scheduler
+    class held_update : public scheduled_update
+    {
+    public:
+        template< typename U >
+        held_update( Outlet &outlet, U &&value ) : scheduled_update( outlet ), mValue( std::forward< U >( value ) ) {}
+
+        void deliver() override { static_cast< Outlet & >( outlet() ).deliver( std::move( mValue ) ); }
+
+        out_t mValue;
+    };
+
+    //! Hands \a in to the frame scheduler, if there is one, and returns
+    //! whether it did. An update already held back takes the new value.
+    template< typename U >
+    bool hold( U &&in )
+    {
+        if ( mHeld && mHeld->heldBy ) {
+            mHeld->mValue = std::forward< U >( in );
+            mHeld->heldBy->coalesce();
+            return true;
+        }
+        auto scheduler = frameScheduler();
+        if ( ! scheduler ) return false;
+        if ( mHeld ) {
+            mHeld->mValue = std::forward< U >( in );
+        } else {
+            // later updates must see the held one, even once no scheduler
+            // is current
+            hooks();
+            mHeld.reset( new held_update( *this, std::forward< U >( in ) ) );
+        }
+        scheduler->schedule( *mHeld );
+        return true;
+    }
+
+    //! the executor to fan out to the connections with, if any
+    executor_base *fanOut() const
+    {
+        if ( direct() || mConnections.size() < 2 ) return nullptr;
+        if ( auto executor = getParallel() ) return mConnections.size() >= getParallelThreshold() ? executor : nullptr;
+        return threadExecutor();
+    }
+
+    //! Calls \a fn with every connection on \a executor. A parallel fan-out
+    //! hands the connections out in chunks, with one for the calling thread.
+    template< typename F >
+    void fanOut( executor_base &executor, F &&fn )
+    {
+        std::size_t chunk = 1;
+        if ( getParallel() ) chunk = parallelChunk( mConnections.size(), executor.size() + 1 );
+        executor.forEach( mConnections.begin(), mConnections.end(), std::forward< F >( fn ), chunk );
+    }
+
+    void deliver( const out_t &in )
+    {
+        iteration_scope scope( mConnections );
+        if ( auto executor = fanOut() ) {
+            fanOut( *executor, [&]( std::reference_wrapper< inlet_type > &c ) { c.get().receive( in ); } );
+            return;
+        }
+        for ( auto &c : mConnections ) {
+            c.get().receive( in );
+        }
+    }
+
+    //! Branches running in parallel all read \a in, so it is only moved
+    //! from when they run one after the other.
+    void deliver( out_t &&in )
+    {
+        if ( fanOut() ) {
+            deliver( static_cast< const out_t & >( in ) );
+            return;
+        }
+        iteration_scope scope( mConnections );
+        // which connection is last is only known once the listeners before
+        // it ran, since they may disconnect what follows them
+        for ( auto it = mConnections.begin(), end = mConnections.end(); it != end; ++it ) {
+            if ( std::next( it ) == end ) {
+                it->get().receive( std::move( in ) );
+                return;
+            }
+            it->get().receive( static_cast< const out_t & >( in ) );
+        }
+    }
+
+    void deliverBatch( span< const out_t > batch )
+    {
+        iteration_scope scope( mConnections );
+        if ( auto executor = fanOut() ) {
+            fanOut( *executor, [&]( std::reference_wrapper< inlet_type > &c ) { c.get().receive_batch( batch ); } );
+            return;
+        }
+        for ( auto &c : mConnections ) {
+            c.get().receive_batch( batch );
+        }
+    }
+
+    typedef connection_container< inlet_type > connections_type;
+    //! keeps listeners that connect this outlet from moving the connections
+    //! being delivered to
+    typedef typename connections_type::iteration_scope iteration_scope;
+
+    connections_type mConnections;
+    std::unique_ptr< held_update > mHeld;
+};
+
+//! A connection from an outlet on one thread to an inlet on another, made
+//! by Outlet::connect_async. It is an inlet of the outlet that queues what
+//! it receives in an spsc_queue, and an outlet of the inlet that pump()
+//! updates with the queued values. Only one thread may update the outlet,
+//! and only one may pump.
+//!
+//! The connection counts the updates its overflow_policy blocked or dropped,
+//! and the values pump() skipped when coalescing.
+template< typename T >
+class async_connection : public TypedInlet< T >, public async_connection_base
+{
+public:
+    async_connection( TypedInlet< T > &in, std::size_t capacity, overflow_policy policy = overflow_policy::block ) :
+            mQueue( capacity ),
+            mPolicy( policy )
+    {
+        mOut.connect( in );
+    }
+
+    using TypedInlet< T >::receive;
+
+    void receive( const T &data ) override { push( data ); }
+
+    void receive( T &&data ) override { push( std::move( data ) ); }
+
+    //! Delivers up to \a max queued values to the inlet, in the order they
+    //! were sent, and returns how many it took from the queue. When
+    //! coalescing, only the newest of them is delivered. Called on the
+    //! inlet's thread.
+    std::size_t pump( std::size_t max = std::size_t( -1 ) ) override
+    {
+        if ( mPolicy != overflow_policy::coalesce_latest ) {
+            auto pumped = mQueue.consume( [this]( T &&data ) {
+                // the slot is free already, so a blocked update can go on
+                // while this one is delivered
+                if ( mAwaitingRoom.load( std::memory_order_relaxed ) ) wakeBlocked();
+                mOut.update( std::move( data ) );
+            }, max );
+            if ( pumped > 0 ) madeRoom();
+            return pumped;
+        }
+        if ( max == 0 ) return 0;
+        auto queued = std::min( mQueue.size(), max );
+        std::size_t skipped = 0;
+        while ( skipped + 1 < queued && mQueue.try_drop() ) ++skipped;
+        mCoalesced.fetch_add( skipped, std::memory_order_relaxed );
+        return skipped + mQueue.consume( [this]( T &&data ) { mOut.update( std::move( data ) ); }, 1 );
+    }
+
+    //! the number of values waiting to be pumped
+    std::size_t pending() const override { return mQueue.size(); }
+
+    std::size_t pushed() const override { return mQueue.pushed(); }
+
+    void bypass() override
+    {
+        std::vector< Outlet< T > * > sources;
+        for ( auto &out : this->connections() ) sources.push_back( &out.get() );
+        for ( auto source : sources ) {
+            for ( auto &in : mOut.connections() ) source->connect( in.get() );
+        }
+        TypedInlet< T >::disconnect();
+        mOut.disconnect();
+    }
+
+    std::size_t capacity() const { return mQueue.capacity(); }
+
+    overflow_policy policy() const { return mPolicy; }
+
+    //! the number of updates that had to wait for room
+    std::size_t blocked() const { return mBlocked.load( std::memory_order_relaxed ); }
+
+    //! the number of values dropped because the queue was full
+    std::size_t dropped() const { return mDropped.load( std::memory_order_relaxed ); }
+
+    //! the number of values pump() skipped for a newer one
+    std::size_t coalesced() const { return mCoalesced.load( std::memory_order_relaxed ); }
+
+    //! the outlet on the inlet's side, for connecting more inlets to it
+    Outlet< T > &outlet() { return mOut; }
+
+private:
+    template< typename U >
+    void push( U &&data )
+    {
+        enqueue( std::forward< U >( data ) );
+        this->notifyPushed();
+    }
+
+    template< typename U >
+    void enqueue( U &&data )
+    {
+        if ( mQueue.try_push( std::forward< U >( data ) ) ) return;
+
+        switch ( mPolicy ) {
+            case overflow_policy::block:
+                mBlocked.fetch_add( 1, std::memory_order_relaxed );
+                for ( std::size_t idle = 0; ! mQueue.try_push( std::forward< U >( data ) ); ) {
+                    if ( ++idle < spins ) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    std::unique_lock< std::mutex > lock( mRoomMutex );
+                    mAwaitingRoom.store( true, std::memory_order_relaxed );
+                    std::atomic_thread_fence( std::memory_order_seq_cst );
+                    mRoom.wait( lock, [this] { return mQueue.can_push(); } );
+                    mAwaitingRoom.store( false, std::memory_order_relaxed );
+                    idle = 0;
+                }
+                break;
+            case overflow_policy::drop_newest:
+                mDropped.fetch_add( 1, std::memory_order_relaxed );
+                break;
+            case overflow_policy::drop_oldest:
+            case overflow_policy::coalesce_latest: {
+                // drops at most one value: if the receiving thread is still
+                // moving the last one out, its slot is free in a moment
+                bool dropped = false;
+                while ( ! mQueue.try_push( std::forward< U >( data ) ) ) {
+                    if ( ! dropped && mQueue.try_drop() ) {
+                        dropped = true;
+                        mDropped.fetch_add( 1, std::memory_order_relaxed );
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    //! Wakes an update blocked for room, after pump() freed some. Freeing
+    //! slots and checking for a sleeper here, and announcing sleep and
+    //! checking for room in enqueue(), are sequentially consistent, so one
+    //! side always sees the other.
+    void madeRoom()
+    {
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        if ( mAwaitingRoom.load( std::memory_order_relaxed ) ) wakeBlocked();
+    }
+
+    void wakeBlocked()
+    {
+        std::lock_guard< std::mutex > lock( mRoomMutex );
+        mRoom.notify_one();
+    }
+
+    //! how many times a blocked update yields before sleeping
+    static constexpr std::size_t spins = 64;
+
+    spsc_queue< T > mQueue;
+    overflow_policy mPolicy;
+    Outlet< T > mOut;
+
+    //! whether an update sleeps until pump() makes room
+    std::atomic< bool > mAwaitingRoom{ false };
+    std::mutex mRoomMutex;
+    std::condition_variable mRoom;
+
+    std::atomic< std::size_t > mBlocked{ 0 };
+    std::atomic< std::size_t > mDropped{ 0 };
+    std::atomic< std::size_t > mCoalesced{ 0 };
 };
 
 //! Provides a common interface for hetero- and homo-geneous inlets.
@@ -476,22 +1365,39 @@ protected:
     outlets_container_type mOutlets;
 };
 
-//! A collection of heterogeneous Inlets
-template< typename ... T >
-class Inlets : public AbstractInlets< std::tuple< Inlet< T >... > >
+//! A collection of heterogeneous Inlets using the threading policy \a P
+template< typename P, typename ... T >
+class PolicyInlets : public AbstractInlets< std::tuple< Inlet< T, P >... > >
 {
 public:
-
+    typedef P thread_policy;
 };
 
+//! A collection of heterogeneous Inlets
+template< typename ... T >
+using Inlets = PolicyInlets< default_thread_policy, T... >;
+
+//! A collection of heterogeneous Inlets for single threaded graphs
+template< typename ... T >
+using UnsafeInlets = PolicyInlets< singlethread_policy, T... >;
+
 //! A collection of homogeneous Inlets
-template< typename T, std::size_t I, typename A = std::array< Inlet< T >, I > >
+template<
+        typename T,
+        std::size_t I,
+        typename P = default_thread_policy,
+        typename A = std::array< Inlet< T, P >, I >
+>
 class UniformInlets : public AbstractInlets< A, uniform_xlet_iterator< A > >
 {
 public:
-
+    typedef P thread_policy;
 };
 
+//! A collection of homogeneous Inlets for single threaded graphs
+template< typename T, std::size_t I >
+using UnsafeUniformInlets = UniformInlets< T, I, singlethread_policy >;
+
 //! A collection of heterogeneous Outlets
 template< typename ... T >
 class Outlets : public AbstractOutlets< std::tuple< Outlet< T >... > >
@@ -506,35 +1412,89 @@ class UniformOutlets : public AbstractOutlets< A, uniform_xlet_iterator< A > >
 public:
 };
 
-class NodeBase : private Noncopyable, public HasId, virtual public NodeConcept
+//! The part of every node that does not depend on its xlets: its id and
+//! label. Labels given to the constructor or setLabel() are interned in the
+//! shared label_pool; nodes without one are called "node <id>", which is
+//! only formatted once asked for. References returned by label() stay
+//! valid until the label is set again.
+class NodeBase : private Noncopyable, public HasId< NodeBase >, virtual public NodeConcept
 {
 public:
     NodeBase( const std::string &label = "" )
     {
-        if ( label == "" ) {
-            setLabel( "node " + std::to_string( mId ) );
-        } else {
-            setLabel( label );
-        }
+        // taking the pool now has it outlive static nodes
+        auto &pool = label_pool::shared();
+        if ( label != "" ) mLabel = pool.intern( label );
+    }
+
+    ~NodeBase()
+    {
+        releaseLabel();
+        delete mOwned.load( std::memory_order_relaxed );
     }
 
-    uint64_t id() const override { return HasId::id(); }
+    uint64_t id() const override { return HasId< NodeBase >::id(); }
+    uint64_t generation() const override { return HasId< NodeBase >::generation(); }
 
-    void setLabel( const std::string &label ) override { mLabel = label; }
-    std::string getLabel() const override { return mLabel; }
-    const std::string &label() const override { return mLabel; }
-    std::string &label() override { return mLabel; }
+    void setLabel( const std::string &label ) override
+    {
+        auto interned = label_pool::shared().intern( label );
+        releaseLabel();
+        mLabel = interned;
+        delete mOwned.exchange( nullptr );
+    }
+    std::string getLabel() const override { return label(); }
+    const std::string &label() const override
+    {
+        if ( auto label = mLabel.load( std::memory_order_acquire ) ) return *label;
+        if ( auto owned = mOwned.load( std::memory_order_acquire ) ) return *owned;
+        // several threads may ask at once; the first one to finish wins
+        std::string *owned = nullptr;
+        std::unique_ptr< std::string > generated( new std::string( "node " + std::to_string( mId ) ) );
+        if ( ! mOwned.compare_exchange_strong( owned, generated.get(), std::memory_order_acq_rel ) ) return *owned;
+        return *generated.release();
+    }
+    //! the label, copied out of the pool to be edited in place
+    std::string &label() override
+    {
+        if ( auto label = mLabel.load( std::memory_order_relaxed ) ) {
+            delete mOwned.exchange( new std::string( *label ) );
+            releaseLabel();
+        }
+        static_cast< const NodeBase & >( *this ).label();
+        return *mOwned.load( std::memory_order_relaxed );
+    }
 
 private:
-    std::string mLabel;
+    void releaseLabel()
+    {
+        if ( auto label = mLabel.exchange( nullptr ) ) label_pool::shared().release( label );
+    }
+
+    //! the label, if it is pooled
+    std::atomic< const std::string * > mLabel{ nullptr };
+    //! otherwise the generated or edited label, or nullptr until the
+    //! default one is generated
+    mutable std::atomic< std::string * > mOwned{ nullptr };
 };
 
-//! A node has inlets and outlets, specified by its template arguments
+inline uint64_t AnyNode::id() const { return mNode->id(); }
+inline uint64_t AnyNode::generation() const { return mNode->generation(); }
+inline void AnyNode::setLabel( const std::string &label ) { mNode->setLabel( label ); }
+inline std::string AnyNode::getLabel() const { return mNode->getLabel(); }
+inline const std::string &AnyNode::label() const { return static_cast< const NodeBase & >( *mNode ).label(); }
+inline std::string &AnyNode::label() { return mNode->label(); }
+inline std::size_t AnyNode::num_inlets() const { return mNode->num_inlets(); }
+inline std::size_t AnyNode::num_outlets() const { return mNode->num_outlets(); }
+
+//! A node has inlets and outlets, specified by its template arguments. The
+//! threading policy of the node is that of its inlets.
 template< typename Ti, typename To >
 class Node : public NodeBase, public Ti, public To, public VisitableNode< Node< Ti, To > >
 {
 public:
     typedef Node< Ti, To > node_type;
+    typedef typename Ti::thread_policy thread_policy;
 
     Node( const std::string &label = "" ) : NodeBase( label )
     {
@@ -551,6 +1511,25 @@ public:
 
     std::size_t num_inlets() const override { return Ti::num_inlets(); };
     std::size_t num_outlets() const override { return To::num_outlets(); };
+
+    //! Makes all outlets of this node post their updates to \a queue, see
+    //! work_queue. Setting the same queue on every node of a graph makes the
+    //! whole graph propagate through it.
+    void setWorkQueue( work_queue *queue )
+    {
+        this->outlets().each( [&]( auto &out ) {
+            out.setWorkQueue( queue );
+        } );
+    }
+
+    //! Makes all outlets of this node hold their updates back until
+    //! \a scheduler is flushed, see frame_scheduler.
+    void setFrameScheduler( frame_scheduler_base *scheduler )
+    {
+        this->outlets().each( [&]( auto &out ) {
+            out.setFrameScheduler( scheduler );
+        } );
+    }
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,278 @@
+#pragma once
+
+#include "libnodes/Node.h"
+#include "libnodes/Traversal.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace nodes {
+
+//! Runs a linear chain of nodes as a pipeline: the chain is cut into stages
+//! of consecutive nodes with about the same cost, each stage runs on a
+//! thread of its own, and values are handed from one stage to the next
+//! through lock free async_connections. While one stage works on a value,
+//! the stage before it works on the next one, so a chain of CPU bound nodes
+//! on K stages handles values up to K times as fast. Each value still passes
+//! every node in order, and values leave the chain in the order they came in.
+//!
+//! The chain is found by traversing it from its head, see Traversal; every
+//! node must be connected to the next one only, and a chain that loops back
+//! on itself is rejected rather than followed forever. The first stage runs on the
+//! thread that updates the head, the others on threads the pipeline starts.
+//! A stage with nothing to do yields a few times and then sleeps until a
+//! value reaches its queue, and wait() sleeps the same way, so an idle
+//! pipeline does not keep its cores busy. Costs are 1 per node unless set,
+//! or measured with measure().
+class Pipeline : private Noncopyable
+{
+public:
+    template< typename N >
+    explicit Pipeline( N &head )
+    {
+        chain_visitor visitor;
+        traverse( head, visitor );
+        bool chain = visitor.edges.size() + 1 == visitor.nodes.size();
+        for ( std::size_t i = 0; chain && i < visitor.edges.size(); ++i ) {
+            chain = visitor.edges[ i ].out->node()->id() == visitor.nodes[ i ]->id()
+                    && visitor.edges[ i ].in->node()->id() == visitor.nodes[ i + 1 ]->id();
+        }
+        if ( ! chain ) throw std::invalid_argument( "a pipeline needs a linear chain of nodes" );
+        mNodes = std::move( visitor.nodes );
+        mEdges = std::move( visitor.edges );
+        mCosts.assign( mNodes.size(), 1.0 );
+    }
+
+    ~Pipeline() { stop(); }
+
+    //! the number of nodes in the chain
+    std::size_t size() const { return mNodes.size(); }
+
+    //! the node at \a index, counting from the head
+    NodeBase &node( std::size_t index ) const { return *mNodes[ index ]; }
+
+    //! the relative cost of each node
+    const std::vector< double > &costs() const { return mCosts; }
+
+    void setCost( std::size_t index, double cost ) { mCosts[ index ] = cost; }
+
+    //! Measures the cost of each node: calls \a feed, which should update the
+    //! head, \a rounds times with a queue of \a rounds values after every
+    //! node, and then times the nodes one after another as their queues are
+    //! pumped. Nodes are expected to send at most one value for each one
+    //! they receive. Must not be called while running.
+    template< typename F >
+    void measure( F &&feed, std::size_t rounds = 100 )
+    {
+        std::vector< std::unique_ptr< async_connection_base > > queues;
+        for ( auto &edge : mEdges ) queues.push_back( edge.out->reconnectAsync( *edge.in, rounds ) );
+
+        std::fill( mCosts.begin(), mCosts.end(), 0.0 );
+        auto start = clock::now();
+        for ( std::size_t r = 0; r < rounds; ++r ) feed();
+        mCosts[ 0 ] = seconds( clock::now() - start );
+        for ( std::size_t i = 0; i < queues.size(); ++i ) {
+            start = clock::now();
+            queues[ i ]->pump();
+            mCosts[ i + 1 ] = seconds( clock::now() - start );
+        }
+        for ( auto &q : queues ) q->bypass();
+    }
+
+    //! Splits the chain into at most \a stages runs of consecutive nodes,
+    //! keeping the cost of the most expensive run as low as possible.
+    //! Returns the index of the first node of each run.
+    std::vector< std::size_t > partition( std::size_t stages ) const
+    {
+        auto n = mNodes.size();
+        stages = std::max< std::size_t >( 1, std::min( stages, n ) );
+        std::vector< double > prefix( n + 1, 0.0 );
+        for ( std::size_t i = 0; i < n; ++i ) prefix[ i + 1 ] = prefix[ i ] + mCosts[ i ];
+
+        // best[ k ][ i ]: the lowest maximum cost of the first i nodes in k
+        // runs, and where the last of those runs starts
+        const double inf = std::numeric_limits< double >::infinity();
+        std::vector< std::vector< double > > best( stages + 1, std::vector< double >( n + 1, inf ) );
+        std::vector< std::vector< std::size_t > > split( stages + 1, std::vector< std::size_t >( n + 1, 0 ) );
+        best[ 0 ][ 0 ] = 0.0;
+        for ( std::size_t k = 1; k <= stages; ++k ) {
+            for ( std::size_t i = k; i <= n; ++i ) {
+                for ( std::size_t j = k - 1; j < i; ++j ) {
+                    auto cost = std::max( best[ k - 1 ][ j ], prefix[ i ] - prefix[ j ] );
+                    if ( cost < best[ k ][ i ] ) {
+                        best[ k ][ i ] = cost;
+                        split[ k ][ i ] = j;
+                    }
+                }
+            }
+        }
+
+        std::vector< std::size_t > starts( stages );
+        for ( std::size_t k = stages, i = n; k > 0; --k ) {
+            i = split[ k ][ i ];
+            starts[ k - 1 ] = i;
+        }
+        return starts;
+    }
+
+    //! Cuts the chain into \a stages balanced stages, see partition(), puts
+    //! queues of \a capacity values between them, and starts a thread for
+    //! every stage but the first.
+    void start( std::size_t stages, std::size_t capacity = 1024 )
+    {
+        stop();
+        auto starts = partition( stages );
+        mStopping = false;
+        for ( std::size_t s = 1; s < starts.size(); ++s ) {
+            auto &edge = mEdges[ starts[ s ] - 1 ];
+            std::unique_ptr< stage > st( new stage );
+            st->queue = edge.out->reconnectAsync( *edge.in, capacity );
+            st->queue->setPushListener( &stage::pushed, st.get() );
+            mStages.push_back( std::move( st ) );
+        }
+        for ( auto &st : mStages ) {
+            auto s = st.get();
+            s->thread = std::thread( [this, s] { run( *s ); } );
+        }
+    }
+
+    //! the number of stages running, or 0
+    std::size_t stages() const { return mStages.empty() ? 0 : mStages.size() + 1; }
+
+    //! blocks until every value sent to the head has left the chain
+    void wait()
+    {
+        // a stage counts what it pumped only once it handed it on, so once
+        // the stages before one are done, nothing more reaches its queue
+        for ( auto &s : mStages ) {
+            auto done = [&s] { return s->pumped.load() == s->queue->pushed(); };
+            for ( std::size_t idle = 0; ! done(); ) {
+                if ( ++idle < spins ) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                std::unique_lock< std::mutex > lock( mProgressMutex );
+                mWaiting.fetch_add( 1 );
+                mProgress.wait( lock, done );
+                mWaiting.fetch_sub( 1 );
+            }
+        }
+    }
+
+    //! Waits for the values in flight, stops the threads, and connects the
+    //! stages directly again.
+    void stop()
+    {
+        if ( mStages.empty() ) return;
+        wait();
+        mStopping = true;
+        for ( auto &s : mStages ) {
+            std::lock_guard< std::mutex > lock( s->mutex );
+            s->wake.notify_one();
+        }
+        for ( auto &s : mStages ) s->thread.join();
+        for ( auto &s : mStages ) s->queue->bypass();
+        mStages.clear();
+    }
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct edge
+    {
+        OutletBase *out;
+        InletBase *in;
+    };
+
+    //! collects the nodes of the chain and the connections between them
+    class chain_visitor : public NodeVisitor< NodeBase >
+    {
+    public:
+        void visit( NodeBase &n ) override { nodes.push_back( &n ); }
+        //! connections to inlets that belong to no node lead out of the chain
+        void visit( OutletBase &o, InletBase &i ) override
+        {
+            if ( i.node() ) edges.push_back( edge{ &o, &i } );
+        }
+
+        std::vector< NodeBase * > nodes;
+        std::vector< edge > edges;
+    };
+
+    //! how many times an idle stage or wait() yields before sleeping
+    static constexpr std::size_t spins = 64;
+
+    struct stage
+    {
+        std::unique_ptr< async_connection_base > queue;
+        std::thread thread;
+        //! the number of values pumped and handed on to the next stage
+        std::atomic< std::size_t > pumped{ 0 };
+        std::atomic< bool > sleeping{ false };
+        std::mutex mutex;
+        std::condition_variable wake;
+
+        //! Wakes the stage after a value was queued for it. Queueing and
+        //! checking for a sleeper here, and announcing sleep and checking
+        //! the queue in run(), are sequentially consistent, so one side
+        //! always sees the other.
+        static void pushed( void *context )
+        {
+            auto &s = *static_cast< stage * >( context );
+            std::atomic_thread_fence( std::memory_order_seq_cst );
+            if ( ! s.sleeping.load( std::memory_order_relaxed ) ) return;
+            std::lock_guard< std::mutex > lock( s.mutex );
+            s.wake.notify_one();
+        }
+    };
+
+    static double seconds( clock::duration d ) { return std::chrono::duration< double >( d ).count(); }
+
+    void run( stage &s )
+    {
+        std::size_t idle = 0;
+        while ( ! mStopping.load() ) {
+            auto pumped = s.queue->pump();
+            if ( pumped > 0 ) {
+                s.pumped.fetch_add( pumped );
+                if ( mWaiting.load() > 0 ) {
+                    std::lock_guard< std::mutex > lock( mProgressMutex );
+                    mProgress.notify_all();
+                }
+                idle = 0;
+                continue;
+            }
+            if ( ++idle < spins ) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock< std::mutex > lock( s.mutex );
+            s.sleeping.store( true, std::memory_order_relaxed );
+            std::atomic_thread_fence( std::memory_order_seq_cst );
+            s.wake.wait( lock, [&] { return s.queue->pending() > 0 || mStopping.load(); } );
+            s.sleeping.store( false, std::memory_order_relaxed );
+            idle = 0;
+        }
+    }
+
+    std::vector< NodeBase * > mNodes;
+    std::vector< edge > mEdges;
+    std::vector< double > mCosts;
+
+    std::vector< std::unique_ptr< stage > > mStages;
+    std::atomic< bool > mStopping{ false };
+    //! signalled when a stage hands values on while wait() sleeps
+    std::atomic< std::size_t > mWaiting{ 0 };
+    std::mutex mProgressMutex;
+    std::condition_variable mProgress;
+};
+
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "libnodes/Node.h"
+#include "libnodes/arena.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nodes {
+
+//! The order in which a Traversal visits nodes.
+enum class traversal_order
+{
+    //! a node before what it connects to, depth first, like accept()
+    pre_order,
+    //! a node after everything it connects to, depth first
+    post_order,
+    //! nodes closer to the root before those further away
+    breadth_first
+};
+
+//! Walks the nodes reachable from a root with the same visitors as
+//! VisitableNode::accept(), but visits every node exactly once: a diamond
+//! visits its shared tail once instead of once per path, and a feedback
+//! loop ends where it started instead of recursing forever. Nodes are kept
+//! on an explicit stack or queue instead of the call stack, so a chain of
+//! any length can be walked, and a bitset indexed by node id, see HasId,
+//! remembers which were seen. The bitset is cleared at the start of every
+//! run, and nodes must not be destroyed during one, so a reused id is never
+//! mistaken for a node already seen.
+//!
+//! Connections are visited once each, when the node they leave is first
+//! reached, in the order accept() visits them. The stack, queue and bitset
+//! come from the memory_resource current when the traversal was
+//! constructed, and are kept from one run to the next, so walking a graph
+//! again with the same Traversal does not allocate.
+class Traversal : private Noncopyable
+{
+public:
+    explicit Traversal( traversal_order order = traversal_order::pre_order, memory_resource *resource = memory_resource::current() ) :
+            mOrder( order ),
+            mVisited( resource_allocator< std::uint64_t >( resource ) ),
+            mStack( resource_allocator< frame >( resource ) ),
+            mQueue( resource_allocator< AnyNode >( resource ) ),
+            mConnections( resource_allocator< AnyNode::connection_type >( resource ) )
+    {}
+
+    traversal_order order() const { return mOrder; }
+
+    //! visits \a root and what is reachable from it with \a visitor
+    template< typename N, typename V >
+    void run( N &root, V &visitor )
+    {
+        begin();
+        auto start = anyNode( root );
+        if ( mOrder == traversal_order::breadth_first ) {
+            breadthFirst( start, visitor );
+        } else {
+            depthFirst( start, visitor );
+        }
+    }
+
+private:
+    //! a node whose connections are being followed, and the next one
+    struct frame
+    {
+        AnyNode node;
+        std::size_t next;
+        std::size_t end;
+    };
+
+    static AnyNode anyNode( AnyNode &node ) { return node; }
+
+    template< typename N >
+    static AnyNode anyNode( N &node ) { return AnyNode( static_cast< typename N::visitable_type & >( node ) ); }
+
+    template< typename V >
+    static void visitConnection( V &, OutletBase &, InletBase &, long ) {}
+
+    template< typename V >
+    static auto visitConnection( V &visitor, OutletBase &o, InletBase &i, int ) -> decltype( visitor.visit( o, i ), void() )
+    {
+        visitor.visit( o, i );
+    }
+
+    void begin()
+    {
+        auto words = ( NodeBase::ids().capacity() + 63 ) / 64;
+        mVisited.assign( words, 0 );
+        mStack.clear();
+        mQueue.clear();
+        mConnections.clear();
+    }
+
+    //! marks \a node as seen, and returns whether it already was
+    bool seen( const AnyNode &node )
+    {
+        auto id = node.id();
+        if ( id / 64 >= mVisited.size() ) mVisited.resize( id / 64 + 1, 0 );
+        auto bit = std::uint64_t( 1 ) << ( id % 64 );
+        bool was = ( mVisited[ id / 64 ] & bit ) != 0;
+        mVisited[ id / 64 ] |= bit;
+        return was;
+    }
+
+    //! pushes \a node, with its connections on top of those of the nodes
+    //! below it
+    void push( AnyNode node )
+    {
+        auto begin = mConnections.size();
+        node.connections( mConnections );
+        mStack.push_back( frame{ node, begin, mConnections.size() } );
+    }
+
+    template< typename V >
+    void depthFirst( AnyNode root, V &visitor )
+    {
+        bool pre = mOrder == traversal_order::pre_order;
+        seen( root );
+        if ( pre ) root.acceptNode( visitor );
+        push( root );
+        while ( ! mStack.empty() ) {
+            auto &top = mStack.back();
+            if ( top.next == top.end ) {
+                if ( ! pre ) top.node.acceptNode( visitor );
+                mConnections.resize( mStack.size() > 1 ? mStack[ mStack.size() - 2 ].end : 0 );
+                mStack.pop_back();
+                continue;
+            }
+            auto c = mConnections[ top.next++ ];
+            visitConnection( visitor, *c.first, *c.second, 0 );
+            auto next = c.second->node();
+            if ( ! next || seen( *next ) ) continue;
+            if ( pre ) next->acceptNode( visitor );
+            push( *next );
+        }
+    }
+
+    template< typename V >
+    void breadthFirst( AnyNode root, V &visitor )
+    {
+        seen( root );
+        mQueue.push_back( root );
+        for ( std::size_t head = 0; head < mQueue.size(); ++head ) {
+            auto node = mQueue[ head ];
+            node.acceptNode( visitor );
+            mConnections.clear();
+            node.connections( mConnections );
+            for ( auto &c : mConnections ) {
+                visitConnection( visitor, *c.first, *c.second, 0 );
+                auto next = c.second->node();
+                if ( next && ! seen( *next ) ) mQueue.push_back( *next );
+            }
+        }
+    }
+
+    traversal_order mOrder;
+    //! one bit per node id
+    resource_vector< std::uint64_t > mVisited;
+    resource_vector< frame > mStack;
+    //! every node reached breadth first, in order; each is queued once per
+    //! run, so the queue is read from a head index instead of popped
+    resource_vector< AnyNode > mQueue;
+    //! the connections of the nodes on the stack, those of the top last
+    resource_vector< AnyNode::connection_type > mConnections;
+};
+
+//! Visits \a root and what is reachable from it once each, see Traversal.
+//! Every call builds and frees a Traversal of its own; code that walks
+//! graphs repeatedly should keep one instead.
+template< typename N, typename V >
+void traverse( N &root, V &visitor, traversal_order order = traversal_order::pre_order )
+{
+    Traversal traversal( order );
+    traversal.run( root, visitor );
+}
+
+}
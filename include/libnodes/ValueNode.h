@@ -1,12 +1,17 @@
 #pragma once
 #include "libnodes/Node.h"
+#include "libnodes/Graph.h"
 
 namespace nodes {
 
 //! A simple node that holds a primitive value and emits it when the value
 //! changes.
+//!
+//! In a Graph, setting or receiving a value only invalidates the node if the
+//! value differs from the one last emitted, and the new value is emitted
+//! when the graph evaluates the node.
 template< typename T, typename ...Ts >
-class ValueNode : public Node< Inlets< T, Ts... >, Outlets< T, Ts... > >
+class ValueNode : public Node< Inlets< T, Ts... >, Outlets< T, Ts... > >, public Evaluable
 {
 public:
     typedef Node< Inlets< T, Ts... >, Outlets< T, Ts... > > node_type;
@@ -40,7 +45,10 @@ public:
         mOldValue = mValue;
     }
 
-    void set( const T & v ) { mValue = v; update(); }
+    void evaluate() override { update(); }
+
+    void set( const T & v ) { mValue = v; changed(); }
+    void set( T && v ) { mValue = std::move( v ); changed(); }
 
     ValueNode< T > & operator=( const T & v ) { set( v ); return *this; }
 
@@ -54,13 +62,30 @@ public:
 protected:
     virtual void listen()
     {
-        this->template in< 0 >().onReceive( [&] ( const T & newv ) {
-            mValue = newv;
-            this->template out< 0 >().update( newv );
+        this->template in< 0 >().onReceive( [&] ( T newv ) {
+            mValue = std::move( newv );
+            if ( scheduled() ) {
+                changed();
+            } else {
+                this->template out< 0 >().update( mValue );
+            }
+        }, [&] ( span< const T > batch ) {
+            mValue = batch.back();
+            if ( scheduled() ) {
+                changed();
+            } else {
+                this->template out< 0 >().update_batch( batch );
+            }
         });
     }
 
 private:
+    //! invalidates the node if the value differs from the one last emitted
+    void changed()
+    {
+        if ( mOldValue != mValue ) invalidate();
+    }
+
     T mValue, mOldValue;
 };
 
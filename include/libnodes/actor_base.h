@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include "libnodes/inplace_function.h"
+
+namespace nodes {
+
+//! The part of an Actor that inlets post their messages to, so that Node.h
+//! needs neither Actor.h nor the Executor running it.
+class actor_base
+{
+public:
+    virtual ~actor_base() = default;
+
+    //! Queues \a fn to run on a worker after the messages queued before it.
+    //! Callable from any thread. \a fn is stored in the message unless it is
+    //! larger than a task holds or may throw when moved, in which case it is
+    //! allocated from the memory_resource current when the actor was
+    //! constructed.
+    template< typename F >
+    void post( F &&fn )
+    {
+        enqueue( make_inplace_function< task >( std::forward< F >( fn ), mResource ) );
+    }
+
+protected:
+    typedef inplace_function< void() > task;
+
+    //! queues \a fn behind the messages posted before it
+    virtual void enqueue( task &&fn ) = 0;
+
+private:
+    memory_resource *mResource = memory_resource::current();
+};
+
+}
@@ -86,7 +86,7 @@ template<
         typename... Tp
 >
 inline typename std::enable_if< is_iterable< I, End, sizeof...( Tp ) >::test >::type
-call( std::tuple< Tp... > &t, F & fn, index_constant< I > i, index_constant< End > e )
+call( std::tuple< Tp... > &t, F & fn, index_constant< I >, index_constant< End > e )
 {
     fn( std::get< I >( t ) );
     call( t, fn, index_constant< I + 1 >{}, e );
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace nodes {
+
+//! Where the parts of nodes that are allocated after construction, like
+//! slot lists and connections, get their memory from. Like
+//! std::pmr::memory_resource, which needs C++17.
+//!
+//! Signals and connection containers take the resource current on the
+//! thread constructing them, see scope, and keep using it, so everything a
+//! node allocates comes from the resource it was built in.
+class memory_resource
+{
+public:
+    virtual ~memory_resource() = default;
+
+    virtual void *allocate( std::size_t bytes, std::size_t alignment = alignof( std::max_align_t ) ) = 0;
+    virtual void deallocate( void *p, std::size_t bytes, std::size_t alignment = alignof( std::max_align_t ) ) = 0;
+
+    //! the resource that calls operator new and delete
+    static inline memory_resource *heap();
+
+    //! the resource what is constructed on the calling thread allocates
+    //! from; the heap unless a scope says otherwise
+    static memory_resource *current() { return threadResource(); }
+
+    //! Makes a resource the current one of the calling thread for its
+    //! lifetime.
+    class scope
+    {
+    public:
+        explicit scope( memory_resource &resource ) : mPrevious( threadResource() ) { threadResource() = &resource; }
+
+        scope( const scope & ) = delete;
+
+        scope &operator=( const scope & ) = delete;
+
+        ~scope() { threadResource() = mPrevious; }
+
+    private:
+        memory_resource *mPrevious;
+    };
+
+private:
+    class heap_resource;
+
+    static memory_resource *&threadResource();
+};
+
+class memory_resource::heap_resource : public memory_resource
+{
+public:
+    void *allocate( std::size_t bytes, std::size_t ) override { return ::operator new( bytes ); }
+    void deallocate( void *p, std::size_t, std::size_t ) override { ::operator delete( p ); }
+};
+
+memory_resource *memory_resource::heap()
+{
+    static heap_resource resource;
+    return &resource;
+}
+
+inline memory_resource *&memory_resource::threadResource()
+{
+    static thread_local memory_resource *resource = heap();
+    return resource;
+}
+
+//! A standard allocator that allocates from a memory_resource, like
+//! std::pmr::polymorphic_allocator. Containers copied with it keep the
+//! resource.
+template< typename T >
+class resource_allocator
+{
+public:
+    typedef T value_type;
+
+    resource_allocator( memory_resource *resource = memory_resource::current() ) : mResource( resource ) {}
+
+    template< typename U >
+    resource_allocator( const resource_allocator< U > &other ) : mResource( other.resource() ) {}
+
+    T *allocate( std::size_t n ) { return static_cast< T * >( mResource->allocate( n * sizeof( T ), alignof( T ) ) ); }
+    void deallocate( T *p, std::size_t n ) { mResource->deallocate( p, n * sizeof( T ), alignof( T ) ); }
+
+    memory_resource *resource() const { return mResource; }
+
+    template< typename U >
+    bool operator==( const resource_allocator< U > &rhs ) const { return mResource == rhs.resource(); }
+    template< typename U >
+    bool operator!=( const resource_allocator< U > &rhs ) const { return mResource != rhs.resource(); }
+
+private:
+    memory_resource *mResource;
+};
+
+//! A std::vector that allocates from a memory_resource.
+template< typename T >
+using resource_vector = std::vector< T, resource_allocator< T > >;
+
+//! Allocates from large blocks, handing out memory by bumping a pointer,
+//! and releases everything at once when destroyed. Memory given back is
+//! kept on a free list per size class for the next allocation of that
+//! size, so the slot lists signals copy on every connection do not add up,
+//! and starting a coroutine node after the first few does not allocate,
+//! see uses_frame_pool. Allocations larger than max_pooled come from the
+//! heap, but are released with the rest too.
+//!
+//! Safe to use from several threads; a spin lock guards it, since nothing
+//! is held for long.
+class arena : public memory_resource
+{
+public:
+    //! allocations are rounded up to multiples of this
+    static constexpr std::size_t granularity = alignof( std::max_align_t );
+    //! larger allocations come from the heap
+    static constexpr std::size_t max_pooled = 4096;
+
+    //! allocates blocks of \a blockSize bytes
+    explicit arena( std::size_t blockSize = 64 * 1024 ) : mBlockSize( blockSize ) {}
+
+    arena( const arena & ) = delete;
+
+    arena &operator=( const arena & ) = delete;
+
+    ~arena() { release(); }
+
+    void *allocate( std::size_t bytes, std::size_t alignment = alignof( std::max_align_t ) ) override
+    {
+        lock l( mLock );
+        mUsed += bytes;
+        if ( alignment > granularity ) return bump( bytes, alignment );
+        auto c = sizeClass( bytes );
+        if ( c >= classes ) return allocateLarge( bytes );
+        if ( auto block = mFree[ c ] ) {
+            mFree[ c ] = block->next;
+            return block;
+        }
+        return bump( ( c + 1 ) * granularity, granularity );
+    }
+
+    void deallocate( void *p, std::size_t bytes, std::size_t alignment = alignof( std::max_align_t ) ) override
+    {
+        lock l( mLock );
+        mUsed -= bytes;
+        // over-aligned memory is only reclaimed by release()
+        if ( alignment > granularity ) return;
+        auto c = sizeClass( bytes );
+        if ( c >= classes ) {
+            deallocateLarge( p );
+            return;
+        }
+        auto block = static_cast< free_block * >( p );
+        block->next = mFree[ c ];
+        mFree[ c ] = block;
+    }
+
+    //! Gives all memory back to the system at once. Everything allocated
+    //! from the arena is gone, without being destroyed.
+    void release()
+    {
+        lock l( mLock );
+        mBlocks.clear();
+        while ( mLarge.next != &mLarge ) deallocateLarge( mLarge.next + 1 );
+        for ( auto &f : mFree ) f = nullptr;
+        mHead = mEnd = nullptr;
+        mUsed = 0;
+    }
+
+    //! the number of bytes allocated and not deallocated
+    std::size_t used() const
+    {
+        lock l( mLock );
+        return mUsed;
+    }
+
+    //! the number of blocks taken from the system, not counting large
+    //! allocations
+    std::size_t blocks() const
+    {
+        lock l( mLock );
+        return mBlocks.size();
+    }
+
+private:
+    static constexpr std::size_t classes = max_pooled / granularity;
+
+    struct free_block
+    {
+        free_block *next;
+    };
+
+    //! in front of every large allocation, linking them to release them
+    struct alignas( std::max_align_t ) large_header
+    {
+        large_header *prev;
+        large_header *next;
+    };
+
+    class lock
+    {
+    public:
+        explicit lock( std::atomic_flag &flag ) : mFlag( flag )
+        {
+            while ( mFlag.test_and_set( std::memory_order_acquire ) ) std::this_thread::yield();
+        }
+
+        ~lock() { mFlag.clear( std::memory_order_release ); }
+
+    private:
+        std::atomic_flag &mFlag;
+    };
+
+    static std::size_t sizeClass( std::size_t bytes ) { return bytes == 0 ? 0 : ( bytes - 1 ) / granularity; }
+
+    void *bump( std::size_t bytes, std::size_t alignment )
+    {
+        auto p = reinterpret_cast< std::uintptr_t >( mHead );
+        p = ( p + alignment - 1 ) & ~std::uintptr_t( alignment - 1 );
+        if ( ! mHead || p + bytes > reinterpret_cast< std::uintptr_t >( mEnd ) ) {
+            auto size = std::max( mBlockSize, bytes + alignment );
+            mBlocks.emplace_back( new char[ size ] );
+            mHead = mBlocks.back().get();
+            mEnd = mHead + size;
+            p = reinterpret_cast< std::uintptr_t >( mHead );
+            p = ( p + alignment - 1 ) & ~std::uintptr_t( alignment - 1 );
+        }
+        mHead = reinterpret_cast< char * >( p + bytes );
+        return reinterpret_cast< void * >( p );
+    }
+
+    void *allocateLarge( std::size_t bytes )
+    {
+        auto header = static_cast< large_header * >( ::operator new( sizeof( large_header ) + bytes ) );
+        header->prev = &mLarge;
+        header->next = mLarge.next;
+        mLarge.next->prev = header;
+        mLarge.next = header;
+        return header + 1;
+    }
+
+    void deallocateLarge( void *p )
+    {
+        auto header = static_cast< large_header * >( p ) - 1;
+        header->prev->next = header->next;
+        header->next->prev = header->prev;
+        ::operator delete( header );
+    }
+
+    const std::size_t mBlockSize;
+    mutable std::atomic_flag mLock = ATOMIC_FLAG_INIT;
+    std::vector< std::unique_ptr< char[] > > mBlocks;
+    char *mHead = nullptr;
+    char *mEnd = nullptr;
+    free_block *mFree[ classes ] = {};
+    large_header mLarge{ &mLarge, &mLarge };
+    std::size_t mUsed = 0;
+};
+
+//! Mixed into nodes whose coroutine frames come from an arena. A Graph
+//! hands its arena to such nodes when they are added to it, and frames keep
+//! it alive, so they may outlive the graph.
+class uses_frame_pool
+{
+public:
+    void setFramePool( std::shared_ptr< arena > pool ) { mFramePool = std::move( pool ); }
+
+    //! the arena frames are allocated from, or nullptr for the heap
+    const std::shared_ptr< arena > &framePool() const { return mFramePool; }
+
+private:
+    std::shared_ptr< arena > mFramePool;
+};
+
+}
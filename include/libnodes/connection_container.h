@@ -1,74 +1,686 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <algorithm>
+#include <atomic>
 #include <memory>
+#include <iterator>
+#include <limits>
 #include <vector>
-#include <set>
+#include "libnodes/arena.h"
+#include "libnodes/small_vector.h"
+
+//! The number of connections an xlet stores without allocating.
+#ifndef LIBNODES_INLINE_CONNECTIONS
+#define LIBNODES_INLINE_CONNECTIONS 4
+#endif
+
+//! The number of connections past which an xlet indexes its connections by
+//! id, rather than looking them up by linear search.
+#ifndef LIBNODES_INDEXED_CONNECTIONS
+#define LIBNODES_INDEXED_CONNECTIONS 16
+#endif
 
 namespace nodes {
 template< class T >
 using ref = std::shared_ptr< T >;
 
-struct reference_wrapper_compare {
-    template< typename A, typename B >
-    bool operator()( const std::reference_wrapper< A > &lhs, const std::reference_wrapper< B > &rhs ) const {
-        return lhs.get() < rhs.get();
+class connection_container_base;
+
+//! Maps xlet ids to positions in a connection_container. An open addressing
+//! hash table with linear probing, stored in one flat array, so lookups are
+//! constant time and inserting does not allocate until the table grows.
+class connection_index
+{
+public:
+    static constexpr std::size_t npos = std::numeric_limits< std::size_t >::max();
+
+    //! allocates its table from \a resource
+    explicit connection_index( memory_resource *resource = memory_resource::current() ) :
+            mBuckets( resource_allocator< entry >( resource ) )
+    {}
+
+    //! maps \a id to \a slot, replacing any previous mapping
+    void insert( std::uint64_t id, std::size_t slot )
+    {
+        if (( mSize + 1 ) * 2 > mBuckets.size() ) rehash( mBuckets.empty() ? 16 : mBuckets.size() * 2 );
+
+        auto i = bucket( id );
+        while ( mBuckets[ i ].id != empty && mBuckets[ i ].id != id ) i = next( i );
+        if ( mBuckets[ i ].id == empty ) ++mSize;
+        mBuckets[ i ] = { id, slot };
+    }
+
+    //! returns the slot mapped to \a id, or npos
+    std::size_t find( std::uint64_t id ) const
+    {
+        if ( mBuckets.empty() ) return npos;
+
+        for ( auto i = bucket( id ); mBuckets[ i ].id != empty; i = next( i ) ) {
+            if ( mBuckets[ i ].id == id ) return mBuckets[ i ].slot;
+        }
+        return npos;
+    }
+
+    //! removes the mapping for \a id, if any. Later buckets in the probe
+    //! sequence are shifted back, so no tombstones are left behind.
+    void erase( std::uint64_t id )
+    {
+        if ( mBuckets.empty() ) return;
+
+        auto i = bucket( id );
+        while ( mBuckets[ i ].id != id ) {
+            if ( mBuckets[ i ].id == empty ) return;
+            i = next( i );
+        }
+
+        for ( auto j = next( i ); mBuckets[ j ].id != empty; j = next( j ) ) {
+            auto home = bucket( mBuckets[ j ].id );
+            // move j back into the hole at i unless its home lies cyclically in ( i, j ]
+            bool stays = i <= j ? ( i < home && home <= j ) : ( i < home || home <= j );
+            if ( ! stays ) {
+                mBuckets[ i ] = mBuckets[ j ];
+                i = j;
+            }
+        }
+        mBuckets[ i ].id = empty;
+        --mSize;
+    }
+
+    void clear()
+    {
+        mBuckets.clear();
+        mSize = 0;
+    }
+
+    //! prepares the index to hold \a size ids without growing
+    void reserve( std::size_t size )
+    {
+        std::size_t buckets = 16;
+        while ( buckets < size * 2 ) buckets *= 2;
+        if ( buckets > mBuckets.size() ) rehash( buckets );
+    }
+
+    std::size_t size() const { return mSize; }
+
+    memory_resource *resource() const { return mBuckets.get_allocator().resource(); }
+
+private:
+    static constexpr std::uint64_t empty = std::numeric_limits< std::uint64_t >::max();
+
+    struct entry
+    {
+        std::uint64_t id;
+        std::size_t slot;
+    };
+
+    std::size_t bucket( std::uint64_t id ) const
+    {
+        // Fibonacci hashing spreads sequential ids across the table
+        return ( id * 0x9E3779B97F4A7C15ull ) >> mShift;
+    }
+
+    std::size_t next( std::size_t i ) const { return ( i + 1 ) & ( mBuckets.size() - 1 ); }
+
+    void rehash( std::size_t buckets )
+    {
+        resource_vector< entry > old( buckets, entry{ empty, 0 }, mBuckets.get_allocator() );
+        old.swap( mBuckets );
+        mShift = 64;
+        for ( auto b = buckets; b > 1; b >>= 1 ) --mShift;
+        mSize = 0;
+        for ( auto &e : old ) {
+            if ( e.id != empty ) insert( e.id, e.slot );
+        }
+    }
+
+    resource_vector< entry > mBuckets;
+    std::size_t mSize = 0;
+    unsigned mShift = 64;
+};
+
+//! Counts the connections made and removed from the outlets of a set of
+//! nodes, and remembers whose outgoing connections changed at each of the
+//! last capacity versions, so that what is derived from the topology can
+//! tell when it is out of date, and be brought up to date by revisiting
+//! just those nodes. Each Graph keeps one for its nodes, see
+//! OutletBase::topology(), so wiring elsewhere leaves it alone.
+//!
+//! Writers do not wait for each other or for readers; a reader that falls
+//! behind by more than capacity changes, or races a writer, is told so and
+//! has to start over. Node ids are reused, so an entry may name a node that
+//! has since taken the id of the one that changed; readers revisit it
+//! needlessly, which costs time but never misses a change.
+class topology_log
+{
+public:
+    static constexpr std::size_t capacity = 4096;
+    //! the node of connections from outlets that belong to no node
+    static constexpr std::uint64_t none = std::numeric_limits< std::uint64_t >::max();
+
+    topology_log() = default;
+
+    topology_log( const topology_log & ) = delete;
+
+    topology_log &operator=( const topology_log & ) = delete;
+
+    //! The log of the nodes that belong to several graphs, which every
+    //! graph follows besides its own.
+    static const std::shared_ptr< topology_log > &shared()
+    {
+        static const std::shared_ptr< topology_log > log = std::make_shared< topology_log >();
+        return log;
     }
+
+    //! the number of changes recorded so far
+    std::uint64_t version() const { return mVersion.load( std::memory_order_acquire ); }
+
+    //! bumps version(), noting that connections from an outlet of the node
+    //! with id \a node changed
+    void record( std::uint64_t node )
+    {
+        auto version = mVersion.fetch_add( 1, std::memory_order_acq_rel );
+        auto &e = mEntries[ version % capacity ];
+        e.version.store( none, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_release );
+        e.node.store( node, std::memory_order_relaxed );
+        e.version.store( version, std::memory_order_release );
+    }
+
+    //! Calls \a fn with the id of the node of every change from version
+    //! \a from up to \a to, skipping changes of no node; ids may repeat.
+    //! Returns false if some of those changes are not known.
+    template< typename F >
+    bool since( std::uint64_t from, std::uint64_t to, F &&fn ) const
+    {
+        if ( to - from > capacity ) return false;
+        for ( auto version = from; version < to; ++version ) {
+            auto &e = mEntries[ version % capacity ];
+            if ( e.version.load( std::memory_order_acquire ) != version ) return false;
+            auto node = e.node.load( std::memory_order_relaxed );
+            std::atomic_thread_fence( std::memory_order_acquire );
+            if ( e.version.load( std::memory_order_relaxed ) != version ) return false;
+            if ( node != none ) fn( node );
+        }
+        return true;
+    }
+
+private:
+    struct entry
+    {
+        std::atomic< std::uint64_t > version{ none };
+        std::atomic< std::uint64_t > node{ none };
+    };
+
+    std::atomic< std::uint64_t > mVersion{ 0 };
+    entry mEntries[ capacity ];
 };
 
+//! A connection between two xlets, shared by the connection_containers at
+//! both of its ends. It remembers where it is stored in each of them, so
+//! that either end can remove it from both in constant time.
+struct connection_link
+{
+    explicit connection_link( memory_resource *r ) : resource( r ) {}
+
+    //! allocates a link from \a resource
+    static connection_link *create( memory_resource *resource )
+    {
+        return new ( resource->allocate( sizeof( connection_link ), alignof( connection_link ) ) ) connection_link( resource );
+    }
 
-template< typename V >
-class connection_container {
+    //! gives the link back to the resource it came from
+    void destroy()
+    {
+        auto r = resource;
+        this->~connection_link();
+        r->deallocate( this, sizeof( connection_link ), alignof( connection_link ) );
+    }
+
+    //! where the link was allocated
+    memory_resource *resource;
+    //! the containers holding each end, or nullptr once disconnected
+    connection_container_base *ends[ 2 ] = { nullptr, nullptr };
+    //! the position of this link in each end's container
+    std::size_t slots[ 2 ] = { 0, 0 };
+    //! the number of connection_handles referring to this link
+    std::size_t handles = 0;
+    //! the id of the node whose outgoing connections this link is one of,
+    //! and where its outlet keeps the topology_log to record changes in
+    std::uint64_t node = topology_log::none;
+    const std::shared_ptr< topology_log > *log = nullptr;
+
+    //! notes in the log of the outlet, if any, that the link changed
+    void recordChange()
+    {
+        if ( log && *log ) ( *log )->record( node );
+    }
+
+    bool connected() const { return ends[ 0 ] != nullptr; }
+
+    //! removes the link from both ends, and deletes it unless a handle
+    //! still refers to it
+    inline void disconnect();
+};
+
+//! Refers to a connection made by Outlet::connect, and can disconnect it in
+//! constant time. Handles do not keep connections alive, and can be copied
+//! and kept after the connection is gone. Like connecting and disconnecting
+//! xlets, handles are not synchronized between threads.
+class connection_handle
+{
 public:
-    typedef reference_wrapper_compare compare;
-    typedef std::reference_wrapper< V > value_type;
-    typedef std::vector< value_type > vector_type;
-    typedef std::set< value_type, compare > set_type;
+    connection_handle() = default;
+
+    explicit connection_handle( connection_link *link ) : mLink( link ) { retain(); }
+
+    connection_handle( const connection_handle &other ) : mLink( other.mLink ) { retain(); }
+
+    connection_handle( connection_handle &&other ) : mLink( other.mLink ) { other.mLink = nullptr; }
+
+    connection_handle &operator=( connection_handle other )
+    {
+        std::swap( mLink, other.mLink );
+        return *this;
+    }
+
+    ~connection_handle() { release(); }
+
+    //! whether the connection still exists
+    bool connected() const { return mLink != nullptr && mLink->connected(); }
+
+    explicit operator bool() const { return connected(); }
+
+    //! removes the connection from both of its ends, if it still exists
+    void disconnect()
+    {
+        if ( connected() ) mLink->disconnect();
+    }
+
+private:
+    void retain()
+    {
+        if ( mLink ) ++mLink->handles;
+    }
+
+    void release()
+    {
+        if ( mLink && --mLink->handles == 0 && ! mLink->connected() ) mLink->destroy();
+        mLink = nullptr;
+    }
+
+    connection_link *mLink = nullptr;
+};
+
+//! The part of connection_container that links operate on.
+class connection_container_base
+{
+protected:
+    friend struct connection_link;
+
+    //! an iteration_scope open on the calling thread; they form a stack
+    struct open_scope
+    {
+        connection_container_base *container;
+        open_scope *outer;
+    };
+
+    virtual ~connection_container_base() { undefer(); }
+
+    //! forgets the link stored at \a slot, without moving any other link
+    virtual void release( std::size_t slot ) = 0;
 
-    bool insert( const value_type &member ) {
-        if ( mSet.insert( member ).second ) {
-            mVector.push_back( member );
-            return true;
+    //! drops the holes iterating would walk in vain
+    virtual void tidy() = 0;
+
+    //! the innermost iteration_scope open on the calling thread
+    static open_scope *&openScopes()
+    {
+        static thread_local open_scope *top = nullptr;
+        return top;
+    }
+
+    //! the containers the calling thread left holes in while iterating them
+    static connection_container_base *&deferred()
+    {
+        static thread_local connection_container_base *head = nullptr;
+        return head;
+    }
+
+    //! whether the calling thread is iterating this container
+    bool iterating() const
+    {
+        for ( auto s = openScopes(); s; s = s->outer ) {
+            if ( s->container == this ) return true;
         }
         return false;
     }
 
-    bool erase( const value_type &member ) {
-        if ( mSet.erase( member )) {
-            mVector.erase( std::remove_if( mVector.begin(), mVector.end(), [&]( const value_type &m ) {
-                return m.get() == member.get();
-            } ), mVector.end());
-            return true;
+    void enter( open_scope &s )
+    {
+        s.container = this;
+        s.outer = openScopes();
+        openScopes() = &s;
+    }
+
+    //! closes the innermost scope, tidying this container if it was the
+    //! last one on it and holes were left meanwhile
+    void leave( open_scope &s )
+    {
+        openScopes() = s.outer;
+        if ( deferred() && ! iterating() && undefer() ) tidy();
+    }
+
+    //! remembers to tidy this container when the calling thread stops
+    //! iterating it
+    void defer()
+    {
+        for ( auto c = deferred(); c; c = c->mNextDeferred ) {
+            if ( c == this ) return;
+        }
+        mNextDeferred = deferred();
+        deferred() = this;
+    }
+
+    //! takes this container off the calling thread's deferred ones, and
+    //! returns whether it was there
+    bool undefer()
+    {
+        for ( auto c = &deferred(); *c; c = &( *c )->mNextDeferred ) {
+            if ( *c == this ) {
+                *c = mNextDeferred;
+                return true;
+            }
         }
         return false;
     }
 
+private:
+    connection_container_base *mNextDeferred = nullptr;
+};
+
+inline void connection_link::disconnect()
+{
+    for ( std::size_t end = 0; end < 2; ++end ) {
+        ends[ end ]->release( slots[ end ] );
+        ends[ end ] = nullptr;
+    }
+    recordChange();
+    if ( handles == 0 ) destroy();
+}
+
+//! Holds the xlets connected to an xlet, in the order they were connected.
+//! Links made from it come from the memory_resource current when it was
+//! constructed. Up to \a N connections are stored inline. Past \a H connections an id
+//! index is kept alongside, so lookups stay cheap.
+//!
+//! Removing a connection leaves a hole that iteration skips. Holes at the
+//! end are dropped right away, and the others are compacted away once
+//! they outnumber the connections, or when new connections are made and
+//! the storage is full. Iterators refer to connections by position, so
+//! they survive the storage growing, and while an iteration_scope is open
+//! on the container the holes stay until it closes, and connections made
+//! are not reached by the iterators taken before them. Listeners may
+//! therefore connect and disconnect the outlet that is updating them.
+template<
+        typename V,
+        std::size_t N = LIBNODES_INLINE_CONNECTIONS,
+        std::size_t H = LIBNODES_INDEXED_CONNECTIONS
+>
+class connection_container : public connection_container_base {
+public:
+    typedef std::reference_wrapper< V > value_type;
+
+    //! a connected xlet and the link to it, or a hole if link is nullptr
+    struct entry : public value_type
+    {
+        entry( V &member, connection_link *l ) : value_type( member ), link( l ) {}
+
+        connection_link *link;
+    };
+
+    typedef small_vector< entry, N > vector_type;
+    typedef connection_index index_type;
+
+    //! iterates the connected xlets, skipping holes
+    template< typename C, typename R >
+    class basic_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename std::remove_const< R >::type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef R *pointer;
+        typedef R &reference;
+
+        basic_iterator( C &entries, std::size_t it, std::size_t end ) : mEntries( &entries ), mIt( it ), mEnd( end ) { skip(); }
+
+        reference operator*() const { return ( *mEntries )[ mIt ]; }
+        pointer operator->() const { return &( *mEntries )[ mIt ]; }
+
+        basic_iterator &operator++()
+        {
+            ++mIt;
+            skip();
+            return *this;
+        }
+
+        basic_iterator operator++( int )
+        {
+            auto it = *this;
+            ++*this;
+            return it;
+        }
+
+        bool operator==( const basic_iterator &rhs ) const { return mIt == rhs.mIt; }
+        bool operator!=( const basic_iterator &rhs ) const { return mIt != rhs.mIt; }
+
+    private:
+        void skip()
+        {
+            while ( mIt != mEnd && ( *mEntries )[ mIt ].link == nullptr ) ++mIt;
+        }
+
+        C *mEntries;
+        std::size_t mIt;
+        std::size_t mEnd;
+    };
+
+    typedef basic_iterator< vector_type, value_type > iterator;
+    typedef basic_iterator< const vector_type, const value_type > const_iterator;
+
+    //! Defers compacting while open, so that connecting does not move the
+    //! connections being iterated. Scopes may nest, and be opened on several
+    //! threads at once. They only defer compacting on the thread that opened
+    //! them, and only in the container they were opened on: connecting is not
+    //! synchronized with iterating on other threads anyway, so only the
+    //! iterations of the connecting thread can be disturbed by it. When the
+    //! last scope a thread opened on a container closes, the holes the thread
+    //! left in it meanwhile are dropped.
+    class iteration_scope
+    {
+    public:
+        explicit iteration_scope( connection_container &c ) : mContainer( c ) { mContainer.enter( mScope ); }
+
+        iteration_scope( const iteration_scope & ) = delete;
+
+        iteration_scope &operator=( const iteration_scope & ) = delete;
+
+        ~iteration_scope() { mContainer.leave( mScope ); }
+
+    private:
+        connection_container &mContainer;
+        open_scope mScope;
+    };
+
+    connection_container() = default;
+
+    ~connection_container() { clear(); }
+
+    //! links \a member, stored in this container, with \a other, stored in
+    //! \a container, as one of the outgoing connections of the node with id
+    //! \a node, recording the change in the topology_log \a log points to,
+    //! if any, then and when disconnected. Returns nullptr if they are
+    //! already connected.
+    template< typename C, typename W >
+    connection_link *link( V &member, C &container, W &other, const std::shared_ptr< topology_log > *log = nullptr,
+                           std::uint64_t node = topology_log::none )
+    {
+        if ( contains( member )) return nullptr;
+
+        auto l = connection_link::create( mEntries.resource() );
+        l->node = node;
+        l->log = log;
+        attach( member, l, 0 );
+        container.attach( other, l, 1 );
+        l->recordChange();
+        return l;
+    }
+
+    //! disconnects \a member from both ends
+    bool erase( const value_type &member ) {
+        auto slot = find( member.get() );
+        if ( slot == npos ) return false;
+
+        mEntries[ slot ].link->disconnect();
+        return true;
+    }
+
     bool contains( const V & member ) const {
-        return std::find_if( mSet.cbegin(), mSet.cend(), [&] ( auto & ref ) {
-            return ref.get() == member;
-        } ) != mSet.cend();
+        return find( member ) != npos;
     }
 
-    typename vector_type::iterator begin() { return mVector.begin(); }
-    typename vector_type::iterator end() { return mVector.end(); }
-    typename vector_type::const_iterator cbegin() const { return mVector.cbegin(); }
-    typename vector_type::const_iterator cend() const { return mVector.cend(); }
+    //! returns the link to \a member, or nullptr if it is not connected
+    connection_link *linkTo( const V & member ) const {
+        auto slot = find( member );
+        return slot == npos ? nullptr : mEntries[ slot ].link;
+    }
+
+    iterator begin() { return { mEntries, 0, mEntries.size() }; }
+    iterator end() { return { mEntries, mEntries.size(), mEntries.size() }; }
+    const_iterator begin() const { return { mEntries, 0, mEntries.size() }; }
+    const_iterator end() const { return { mEntries, mEntries.size(), mEntries.size() }; }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    bool empty() const { return mSize == 0; }
 
-    bool empty() const { return mSet.empty(); }
+    std::size_t size() const { return mSize; }
 
-    std::size_t size() const { return mSet.size(); }
+    //! the number of positions iterating walks, holes included
+    std::size_t extent() const { return mEntries.size(); }
 
+    //! disconnects every member from both ends; while iterated, the holes
+    //! they leave stay until the next connection is made
     void clear() {
-        mVector.clear();
-        mSet.clear();
+        // last first, since releasing may move the entries before
+        for ( auto i = mEntries.size(); i-- > 0; ) {
+            if ( i < mEntries.size() && mEntries[ i ].link ) mEntries[ i ].link->disconnect();
+        }
+        if ( iterating() ) {
+            defer();
+            return;
+        }
+        mEntries.clear();
+        mIndex.reset();
     }
 
 private:
-    vector_type mVector;
-    set_type mSet;
+    template< typename, std::size_t, std::size_t >
+    friend class connection_container;
+
+    static constexpr std::size_t npos = index_type::npos;
+
+    void attach( V &member, connection_link *l, std::size_t end )
+    {
+        if ( mEntries.size() > mSize && mEntries.size() == mEntries.capacity() && ! iterating() ) compact();
+
+        l->ends[ end ] = this;
+        l->slots[ end ] = mEntries.size();
+        mEntries.push_back( entry( member, l ));
+        ++mSize;
+
+        if ( mIndex ) {
+            mIndex->insert( member.id(), l->slots[ end ] );
+        } else if ( mSize > H ) {
+            buildIndex();
+        }
+    }
+
+    void release( std::size_t slot ) override
+    {
+        auto &e = mEntries[ slot ];
+        if ( mIndex ) mIndex->erase( e.get().id() );
+        e.link = nullptr;
+        --mSize;
+        if ( iterating() ) {
+            defer();
+            return;
+        }
+        tidy();
+    }
+
+    //! so that updates do not keep skipping what was disconnected
+    void tidy() override
+    {
+        while ( ! mEntries.empty() && mEntries.back().link == nullptr ) mEntries.pop_back();
+        if ( mSize * 2 < mEntries.size() ) compact();
+    }
+
+    //! moves the remaining links over the holes, and tells them where they
+    //! are now
+    void compact()
+    {
+        auto out = mEntries.begin();
+        for ( auto &e : mEntries ) {
+            if ( e.link == nullptr ) continue;
+            std::size_t end = e.link->ends[ 0 ] == this ? 0 : 1;
+            e.link->slots[ end ] = out - mEntries.begin();
+            *out++ = e;
+        }
+        while ( mEntries.end() != out ) mEntries.pop_back();
+        if ( mIndex ) buildIndex();
+    }
+
+    std::size_t find( const V & member ) const {
+        if ( mIndex ) return mIndex->find( member.id() );
+        for ( std::size_t i = 0; i < mEntries.size(); ++i ) {
+            if ( mEntries[ i ].link && &mEntries[ i ].get() == &member ) return i;
+        }
+        return npos;
+    }
+
+    void buildIndex() {
+        if ( mIndex ) {
+            mIndex->clear();
+        } else {
+            auto resource = mEntries.resource();
+            mIndex.reset( new ( resource->allocate( sizeof( index_type ), alignof( index_type ) ) ) index_type( resource ) );
+        }
+        mIndex->reserve( mSize );
+        for ( std::size_t i = 0; i < mEntries.size(); ++i ) {
+            if ( mEntries[ i ].link ) mIndex->insert( mEntries[ i ].get().id(), i );
+        }
+    }
+
+    //! gives an index made by buildIndex() back to its resource
+    struct index_deleter
+    {
+        void operator()( index_type *index ) const
+        {
+            auto resource = index->resource();
+            index->~index_type();
+            resource->deallocate( index, sizeof( index_type ), alignof( index_type ) );
+        }
+    };
+
+    //! allocates, like links made from this end, from the resource current
+    //! when the container was constructed
+    vector_type mEntries;
+    std::size_t mSize = 0;
+    std::unique_ptr< index_type, index_deleter > mIndex;
 };
 
 }
-
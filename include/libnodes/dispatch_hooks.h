@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+
+namespace nodes {
+
+class work_queue;
+class frame_scheduler_base;
+class executor_base;
+
+//! What an outlet routes its updates through on their way to its inlets: a
+//! work queue, see work_queue, a frame scheduler, see frame_scheduler, and
+//! an executor to fan out over, see Executor. Each is nullptr if unused.
+//!
+//! Outlets have a record of their own only once one was set on them, and
+//! each thread has one, set by the scopes of the work queue, the frame
+//! scheduler and the executor. Those scopes also count how many are open on
+//! their thread, so on a thread where none is, an outlet without a record of
+//! its own sends its updates straight to its inlets after one thread-local
+//! load and one branch. Scopes open on other threads, like those of the
+//! workers of an Executor, do not slow it down.
+struct dispatch_hooks
+{
+    work_queue *queue = nullptr;
+    frame_scheduler_base *scheduler = nullptr;
+    executor_base *executor = nullptr;
+
+    //! the number of scopes open on the thread of this record
+    std::size_t scopes = 0;
+
+    //! whether a scope is open on the calling thread
+    static bool engaged() { return local().scopes != 0; }
+
+    //! the hooks of the calling thread, or nullptr if it has none
+    static const dispatch_hooks *current() { return engaged() ? &local() : nullptr; }
+
+    //! Sets one of the hooks of the calling thread for its lifetime.
+    template< typename T >
+    class binding
+    {
+    public:
+        binding( T *dispatch_hooks::*hook, T *value ) : mHook( hook ), mPrevious( local().*hook )
+        {
+            ++local().scopes;
+            local().*mHook = value;
+        }
+
+        binding( const binding & ) = delete;
+
+        binding &operator=( const binding & ) = delete;
+
+        ~binding()
+        {
+            local().*mHook = mPrevious;
+            --local().scopes;
+        }
+
+    private:
+        T *dispatch_hooks::*mHook;
+        T *mPrevious;
+    };
+
+    //! the record of the calling thread
+    static dispatch_hooks &local()
+    {
+        static thread_local dispatch_hooks hooks;
+        return hooks;
+    }
+};
+
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include "libnodes/small_vector.h"
+
+namespace nodes {
+
+//! Counts the jobs of a fork that have not finished yet, and keeps the
+//! first exception one of them threw.
+struct executor_join
+{
+    std::atomic< std::size_t > pending{ 0 };
+    std::exception_ptr error;
+    std::mutex errorMutex;
+};
+
+//! A unit of work run by an Executor: \a run is called with the job itself.
+//! Jobs are plain data, so a fork can keep them on its own stack.
+struct executor_job
+{
+    void ( *run )( executor_job & );
+    void *function;
+    void *item;
+    executor_join *join;
+};
+
+//! The part of an Executor that outlets fan their updates out with, so that
+//! Node.h needs neither Executor.h nor its threads. forEach() forks and
+//! joins its jobs through fork() and join(), which the Executor implements.
+class executor_base
+{
+public:
+    virtual ~executor_base() = default;
+
+    //! the number of workers
+    virtual std::size_t size() const = 0;
+
+    //! Calls \a fn with every element of [ \a begin, \a end ) in parallel, and
+    //! returns once all calls have. Rethrows the first exception thrown.
+    template< typename It, typename F >
+    void forEach( It begin, It end, F &&fn )
+    {
+        if ( begin == end ) return;
+
+        executor_join join;
+        small_vector< executor_job, 8 > jobs;
+        auto last = begin;
+        for ( auto it = begin; ++it != end; ) {
+            jobs.push_back( executor_job{ &invoke< It, F >, &fn, const_cast< void * >( static_cast< const void * >( &*last ) ), &join } );
+            last = it;
+        }
+        join.pending.store( jobs.size(), std::memory_order_relaxed );
+        if ( ! jobs.empty() ) fork( jobs.begin(), jobs.size() );
+
+        std::exception_ptr error;
+        try {
+            fn( *last );
+        } catch ( ... ) {
+            error = std::current_exception();
+        }
+        this->join( join );
+        if ( ! error ) error = join.error;
+        if ( error ) std::rethrow_exception( error );
+    }
+
+    //! Like forEach, but with one job per run of \a chunk consecutive
+    //! elements instead of one per element, so that cheap calls over long
+    //! ranges do not drown in scheduling.
+    template< typename It, typename F >
+    void forEach( It begin, It end, F &&fn, std::size_t chunk )
+    {
+        if ( chunk <= 1 ) {
+            forEach( begin, end, std::forward< F >( fn ) );
+            return;
+        }
+        struct range
+        {
+            It first, last;
+        };
+        small_vector< range, 8 > ranges;
+        for ( auto it = begin; it != end; ) {
+            auto first = it;
+            for ( std::size_t i = 0; i < chunk && it != end; ++i ) ++it;
+            ranges.push_back( range{ first, it } );
+        }
+        forEach( ranges.begin(), ranges.end(), [&]( range &r ) {
+            for ( auto it = r.first; it != r.last; ++it ) fn( *it );
+        } );
+    }
+
+protected:
+    //! Queues the \a count jobs at \a jobs, and wakes workers to run them.
+    //! The jobs must stay alive until they have run.
+    virtual void fork( executor_job *jobs, std::size_t count ) = 0;
+
+    //! Runs the jobs of \a join that are still queued, and waits until the
+    //! others have finished.
+    virtual void join( executor_join &join ) = 0;
+
+private:
+    template< typename It, typename F >
+    static void invoke( executor_job &job )
+    {
+        typedef typename std::remove_reference< decltype( *std::declval< It >() ) >::type item_type;
+        try {
+            ( *static_cast< typename std::remove_reference< F >::type * >( job.function ) )(
+                    *static_cast< item_type * >( job.item ) );
+        } catch ( ... ) {
+            std::lock_guard< std::mutex > lock( job.join->errorMutex );
+            if ( ! job.join->error ) job.join->error = std::current_exception();
+        }
+        job.join->pending.fetch_sub( 1, std::memory_order_acq_rel );
+    }
+};
+
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "libnodes/Node.h"
+#include "libnodes/Graph.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace nodes {
+
+//! Coalesces the updates made during a frame.
+//!
+//! While a frame scheduler is current, see frame_scheduler_base::scope, or
+//! set on outlets, see Node::setFrameScheduler, updating an outlet only
+//! records its value, and a later update of the same outlet replaces it.
+//! flush() then delivers each outlet's latest value once, in the
+//! topological order of the nodes of a Graph, so a ValueNode set ten times
+//! in a frame updates what is downstream of it once, and a node reached
+//! through several paths sends on once. Outlets of nodes outside the graph
+//! are delivered first.
+//!
+//! Updates made while flushing are held back too, and delivered in the same
+//! flush, after the outlets ranked before them. An outlet updated again
+//! after it was delivered, through a cycle or from a node ranked before it,
+//! is delivered in the next flush. Outlets must outlive the updates they
+//! have held back. A frame scheduler is used by one thread at a time.
+class frame_scheduler : public frame_scheduler_base, private Noncopyable
+{
+public:
+    //! orders outlets by the ranks of their nodes in \a graph
+    explicit frame_scheduler( Graph &graph ) : mGraph( graph ) {}
+
+    ~frame_scheduler()
+    {
+        for ( auto update : mQueue ) update->heldBy = nullptr;
+        for ( auto update : mDeferred ) update->heldBy = nullptr;
+    }
+
+    void schedule( scheduled_update &update ) override
+    {
+        ++mScheduled;
+        update.heldBy = this;
+        if ( update.delivered ) {
+            mDeferred.push_back( &update );
+        } else {
+            queue( update );
+        }
+    }
+
+    void coalesce( std::size_t count = 1 ) override { mCoalesced += count; }
+
+    void cancel( scheduled_update &update ) override
+    {
+        update.heldBy = nullptr;
+        auto it = std::find( mQueue.begin(), mQueue.end(), &update );
+        if ( it != mQueue.end() ) {
+            mQueue.erase( it );
+            std::make_heap( mQueue.begin(), mQueue.end(), later );
+        }
+        mDeferred.erase( std::remove( mDeferred.begin(), mDeferred.end(), &update ), mDeferred.end() );
+        mDelivered.erase( std::remove( mDelivered.begin(), mDelivered.end(), &update ), mDelivered.end() );
+    }
+
+    //! Delivers the updates held back, and those they cause, once per
+    //! outlet, and makes this scheduler current while doing so. If a
+    //! delivery throws, the updates not delivered yet stay held back.
+    void flush()
+    {
+        scope current( *this );
+        flush_guard guard( *this );
+        while ( ! mQueue.empty() ) {
+            std::pop_heap( mQueue.begin(), mQueue.end(), later );
+            auto next = mQueue.back();
+            mQueue.pop_back();
+            next->heldBy = nullptr;
+            next->delivered = true;
+            mDelivered.push_back( next );
+            ++mDeliveries;
+            next->deliver();
+        }
+    }
+
+    //! the number of outlets with an update held back
+    std::size_t size() const { return mQueue.size() + mDeferred.size(); }
+
+    //! the number of updates held back that no other update replaced
+    std::size_t scheduled() const { return mScheduled; }
+
+    //! the number of updates replaced by a later one before being delivered
+    std::size_t coalesced() const { return mCoalesced; }
+
+    //! the number of updates flush() delivered
+    std::size_t delivered() const { return mDeliveries; }
+
+    void resetCounters() { mScheduled = mCoalesced = mDeliveries = 0; }
+
+private:
+    //! ends a flush, even if a delivery threw
+    struct flush_guard
+    {
+        explicit flush_guard( frame_scheduler &s ) : scheduler( s ) {}
+
+        ~flush_guard()
+        {
+            for ( auto update : scheduler.mDelivered ) update->delivered = false;
+            scheduler.mDelivered.clear();
+            for ( auto update : scheduler.mDeferred ) scheduler.queue( *update );
+            scheduler.mDeferred.clear();
+        }
+
+        frame_scheduler &scheduler;
+    };
+
+    //! orders the heap so that the lowest rank, and then the earliest, is
+    //! delivered first
+    static bool later( const scheduled_update *a, const scheduled_update *b )
+    {
+        return a->rank != b->rank ? a->rank > b->rank : a->sequence > b->sequence;
+    }
+
+    void queue( scheduled_update &update )
+    {
+        auto node = update.outlet().node();
+        auto rank = node ? mGraph.rank( *node ) : Graph::npos;
+        update.rank = rank == Graph::npos ? 0 : rank + 1;
+        update.sequence = mSequence++;
+        mQueue.push_back( &update );
+        std::push_heap( mQueue.begin(), mQueue.end(), later );
+    }
+
+    Graph &mGraph;
+    //! a heap of the updates to deliver, see later()
+    std::vector< scheduled_update * > mQueue;
+    //! updates of outlets delivered in the flush running now, held back
+    //! until the next one
+    std::vector< scheduled_update * > mDeferred;
+    //! the updates delivered in the flush running now
+    std::vector< scheduled_update * > mDelivered;
+    std::uint64_t mSequence = 0;
+    std::size_t mScheduled = 0, mCoalesced = 0, mDeliveries = 0;
+};
+
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace nodes {
+
+//! A table indexed by dense 32-bit ids, grown in blocks of doubling size,
+//! starting at \a FirstBlock entries, the first time an id in a block is
+//! looked up. Blocks are never moved, so an entry stays put while other
+//! threads grow the table. Entries are value-initialized.
+template< typename T, std::size_t FirstBlock = 64 >
+class block_table
+{
+public:
+    block_table()
+    {
+        for ( auto &block : mBlocks ) block.store( nullptr, std::memory_order_relaxed );
+    }
+
+    block_table( const block_table & ) = delete;
+
+    block_table &operator=( const block_table & ) = delete;
+
+    ~block_table()
+    {
+        for ( auto &block : mBlocks ) delete[] block.load( std::memory_order_relaxed );
+    }
+
+    T &operator[]( std::uint32_t id )
+    {
+        auto position = static_cast< std::uint64_t >( id ) + FirstBlock;
+        auto bit = highestBit( position );
+        auto index = bit - highestBit( FirstBlock );
+        auto *block = mBlocks[ index ].load( std::memory_order_acquire );
+        if ( ! block ) {
+            auto *fresh = new T[ std::size_t( 1 ) << bit ]();
+            if ( mBlocks[ index ].compare_exchange_strong( block, fresh, std::memory_order_acq_rel,
+                                                          std::memory_order_acquire ) ) {
+                block = fresh;
+            }
+            else {
+                delete[] fresh;
+            }
+        }
+        return block[ position - ( std::uint64_t( 1 ) << bit ) ];
+    }
+
+private:
+    static_assert( FirstBlock > 0 && ( FirstBlock & ( FirstBlock - 1 ) ) == 0, "the first block of a block_table holds a power of two entries" );
+
+    static constexpr std::size_t highestBit( std::uint64_t bits )
+    {
+#if defined( __GNUC__ ) || defined( __clang__ )
+        return 63 - __builtin_clzll( bits );
+#else
+        std::size_t i = 0;
+        while ( bits >>= 1 ) ++i;
+        return i;
+#endif
+    }
+
+    //! enough blocks for every id
+    static constexpr std::size_t max_blocks = 33 - highestBit( FirstBlock );
+
+    std::atomic< T * > mBlocks[ max_blocks ];
+};
+
+//! Hands out dense 32-bit ids, and reuses the ones given back, the most
+//! recently released first, so that per-id state can live in a flat vector
+//! of capacity() elements instead of a hash map. Safe to use from several
+//! threads without locking: new ids are taken with one atomic increment,
+//! and released ids are kept on a lock-free stack.
+//!
+//! The stack links each free id to the next one through a block_table
+//! indexed by id, which is never moved, so a stale read of a link is
+//! harmless. The head of the stack carries a tag that changes on every push
+//! and pop, so a pop that raced with an id being taken and given back again
+//! fails instead of corrupting the stack.
+//!
+//! Since an id outlives its holder, tables that may hold on to an id past
+//! the death of its holder should keep a generation() next to it, which is
+//! never handed out twice.
+class id_allocator
+{
+public:
+    typedef std::uint32_t id_type;
+
+    id_allocator() = default;
+
+    id_allocator( const id_allocator & ) = delete;
+
+    id_allocator &operator=( const id_allocator & ) = delete;
+
+    id_type acquire()
+    {
+        auto head = mFree.load( std::memory_order_acquire );
+        while ( top( head ) != none ) {
+            auto next = link( top( head ) ).load( std::memory_order_relaxed );
+            if ( mFree.compare_exchange_weak( head, pack( next, head ), std::memory_order_acquire,
+                                              std::memory_order_acquire ) ) {
+                mFreeCount.fetch_sub( 1, std::memory_order_relaxed );
+                return top( head );
+            }
+        }
+        return mNext.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    //! gives \a id back, to be handed out again
+    void release( id_type id )
+    {
+        auto &next = link( id );
+        auto head = mFree.load( std::memory_order_relaxed );
+        do {
+            next.store( top( head ), std::memory_order_relaxed );
+        } while ( ! mFree.compare_exchange_weak( head, pack( id, head ), std::memory_order_release,
+                                                 std::memory_order_relaxed ) );
+        mFreeCount.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    //! a number that differs for every call, to tell apart the successive
+    //! holders of an id
+    std::uint64_t generation() { return mGeneration.fetch_add( 1, std::memory_order_relaxed ); }
+
+    //! one more than the highest id handed out so far: the size of a
+    //! table indexed by id
+    std::size_t capacity() const { return mNext.load( std::memory_order_relaxed ); }
+
+    //! the number of ids in use; exact once no other thread is acquiring
+    //! or releasing
+    std::size_t live() const
+    {
+        return mNext.load( std::memory_order_relaxed ) - mFreeCount.load( std::memory_order_relaxed );
+    }
+
+private:
+    static constexpr id_type none = std::numeric_limits< id_type >::max();
+    static id_type top( std::uint64_t head ) { return static_cast< id_type >( head ); }
+
+    //! a head with \a id on top, tagged differently from \a previous
+    static std::uint64_t pack( id_type id, std::uint64_t previous )
+    {
+        return ( ( ( previous >> 32 ) + 1 ) << 32 ) | id;
+    }
+
+    //! the link from \a id to the next free id
+    std::atomic< id_type > &link( id_type id ) { return mLinks[ id ]; }
+
+    std::atomic< id_type > mNext{ 0 };
+    //! the id on top of the free stack in the low half, a tag in the high
+    std::atomic< std::uint64_t > mFree{ none };
+    std::atomic< std::size_t > mFreeCount{ 0 };
+    std::atomic< std::uint64_t > mGeneration{ 0 };
+    block_table< std::atomic< id_type > > mLinks;
+};
+
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "libnodes/arena.h"
+
+namespace nodes {
+
+template< typename Signature, std::size_t Capacity = 64 >
+class inplace_function;
+
+//! A move-only std::function that stores its callable inline, in
+//! \a Capacity bytes, and never allocates. Callables that do not fit are a
+//! compile time error rather than a heap allocation; capture less, capture
+//! a pointer to what is needed instead, or raise the capacity. Callables
+//! must move without throwing, as inplace_function itself does.
+template< typename R, typename... A, std::size_t Capacity >
+class inplace_function< R( A... ), Capacity >
+{
+public:
+    typedef R result_type;
+
+    static constexpr std::size_t capacity = Capacity;
+
+    inplace_function() = default;
+
+    inplace_function( std::nullptr_t ) {}
+
+    template< typename F, typename D = typename std::decay< F >::type,
+              typename = typename std::enable_if< ! std::is_same< D, inplace_function >::value >::type >
+    inplace_function( F &&fn )
+    {
+        static_assert( sizeof( D ) <= Capacity, "callable too large for inplace_function: capture less, or raise its capacity" );
+        static_assert( alignof( D ) <= alignof( std::max_align_t ), "callable too strictly aligned for inplace_function" );
+        static_assert( std::is_nothrow_move_constructible< D >::value, "inplace_function moves its callable without throwing, so the callable's move constructor must be noexcept" );
+        new ( &mStorage ) D( std::forward< F >( fn ) );
+        mInvoke = &invoke< D >;
+        mManage = &manage< D >;
+    }
+
+    inplace_function( const inplace_function & ) = delete;
+
+    inplace_function &operator=( const inplace_function & ) = delete;
+
+    inplace_function( inplace_function &&other ) noexcept { take( other ); }
+
+    inplace_function &operator=( inplace_function &&other ) noexcept
+    {
+        if ( this != &other ) {
+            reset();
+            take( other );
+        }
+        return *this;
+    }
+
+    inplace_function &operator=( std::nullptr_t )
+    {
+        reset();
+        return *this;
+    }
+
+    ~inplace_function() { reset(); }
+
+    //! calls the callable, which, as with std::function, may change even
+    //! though this is const
+    R operator()( A... args ) const { return mInvoke( const_cast< void * >( static_cast< const void * >( &mStorage ) ), std::forward< A >( args )... ); }
+
+    explicit operator bool() const { return mInvoke != nullptr; }
+
+    bool operator==( std::nullptr_t ) const { return mInvoke == nullptr; }
+    bool operator!=( std::nullptr_t ) const { return mInvoke != nullptr; }
+
+private:
+    enum class operation { move, destroy };
+
+    template< typename D >
+    static R invoke( void *fn, A &&... args ) { return ( *static_cast< D * >( fn ) )( std::forward< A >( args )... ); }
+
+    //! moves the callable at \a from to \a to, or destroys the one at \a to
+    template< typename D >
+    static void manage( operation op, void *to, void *from )
+    {
+        if ( op == operation::move ) {
+            new ( to ) D( std::move( *static_cast< D * >( from ) ) );
+            static_cast< D * >( from )->~D();
+        } else {
+            static_cast< D * >( to )->~D();
+        }
+    }
+
+    void take( inplace_function &other )
+    {
+        if ( ! other.mInvoke ) return;
+        other.mManage( operation::move, &mStorage, &other.mStorage );
+        mInvoke = other.mInvoke;
+        mManage = other.mManage;
+        other.mInvoke = nullptr;
+        other.mManage = nullptr;
+    }
+
+    void reset()
+    {
+        if ( ! mInvoke ) return;
+        mManage( operation::destroy, &mStorage, nullptr );
+        mInvoke = nullptr;
+        mManage = nullptr;
+    }
+
+    R ( *mInvoke )( void *, A &&... ) = nullptr;
+    void ( *mManage )( operation, void *, void * ) = nullptr;
+    typename std::aligned_storage< Capacity, alignof( std::max_align_t ) >::type mStorage;
+};
+
+//! whether an inplace_function of \a Capacity bytes can store a \a D
+template< typename D, std::size_t Capacity >
+using fits_inplace = std::integral_constant< bool, sizeof( D ) <= Capacity &&
+                                                       alignof( D ) <= alignof( std::max_align_t ) &&
+                                                       std::is_nothrow_move_constructible< D >::value >;
+
+//! A callable that does not fit in an inplace_function, allocated from a
+//! memory_resource and given back to it when destroyed.
+template< typename D >
+class boxed_callable
+{
+public:
+    boxed_callable( D *fn, memory_resource *resource ) : mFn( fn ), mResource( resource ) {}
+
+    boxed_callable( boxed_callable &&other ) noexcept : mFn( other.mFn ), mResource( other.mResource ) { other.mFn = nullptr; }
+
+    boxed_callable &operator=( boxed_callable && ) = delete;
+
+    ~boxed_callable()
+    {
+        if ( ! mFn ) return;
+        mFn->~D();
+        mResource->deallocate( mFn, sizeof( D ), alignof( D ) );
+    }
+
+    template< typename... A >
+    auto operator()( A &&... args ) -> decltype( std::declval< D & >()( std::forward< A >( args )... ) )
+    {
+        return ( *mFn )( std::forward< A >( args )... );
+    }
+
+private:
+    D *mFn;
+    memory_resource *mResource;
+};
+
+template< typename Function, typename F >
+Function make_inplace_function( F &&fn, memory_resource *, std::true_type )
+{
+    return Function( std::forward< F >( fn ) );
+}
+
+template< typename Function, typename F >
+Function make_inplace_function( F &&fn, memory_resource *resource, std::false_type )
+{
+    typedef typename std::decay< F >::type D;
+    auto p = resource->allocate( sizeof( D ), alignof( D ) );
+    D *boxed;
+    try {
+        boxed = new ( p ) D( std::forward< F >( fn ) );
+    } catch ( ... ) {
+        resource->deallocate( p, sizeof( D ), alignof( D ) );
+        throw;
+    }
+    return Function( boxed_callable< D >( boxed, resource ) );
+}
+
+//! Makes the inplace_function \a Function call \a fn. \a fn is stored
+//! inline if it fits, see fits_inplace, and otherwise allocated from
+//! \a resource instead of being a compile time error.
+template< typename Function, typename F >
+Function make_inplace_function( F &&fn, memory_resource *resource )
+{
+    typedef typename std::decay< F >::type D;
+    return make_inplace_function< Function >( std::forward< F >( fn ), resource, fits_inplace< D, Function::capacity >{} );
+}
+
+}
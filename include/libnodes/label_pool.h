@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include "libnodes/arena.h"
+
+namespace nodes {
+
+//! Keeps one copy of each distinct label, shared by every node that has
+//! it, so that graphs with thousands of nodes called "gain" store "gain"
+//! once. Labels are counted; ones no node uses any more are kept for the
+//! next node to take them, and dropped in bulk once they make up half of
+//! the pool. The table and its entries live in an arena of the pool's own;
+//! only labels too long to be stored inside a std::string allocate their
+//! characters on the heap. Safe to use from several threads.
+class label_pool
+{
+public:
+    label_pool() : mLabels( 0, std::hash< std::string >(), std::equal_to< std::string >(), label_allocator( &mArena ) ) {}
+
+    label_pool( const label_pool & ) = delete;
+
+    label_pool &operator=( const label_pool & ) = delete;
+
+    //! the pool nodes intern their labels in
+    static label_pool &shared()
+    {
+        static label_pool pool;
+        return pool;
+    }
+
+    //! Returns the pooled copy of \a label, adding it if needed. The copy
+    //! stays valid until release() was called once for every intern().
+    const std::string *intern( const std::string &label )
+    {
+        std::lock_guard< std::mutex > lock( mMutex );
+        auto it = mLabels.find( label );
+        if ( it == mLabels.end() ) {
+            it = mLabels.emplace( label, 0 ).first;
+        } else if ( it->second == 0 ) {
+            --mUnused;
+        }
+        ++it->second;
+        return &it->first;
+    }
+
+    void release( const std::string *label )
+    {
+        std::lock_guard< std::mutex > lock( mMutex );
+        auto it = mLabels.find( *label );
+        if ( --it->second > 0 ) return;
+        if ( ++mUnused > min_unused && mUnused * 2 > mLabels.size() ) {
+            for ( auto i = mLabels.begin(); i != mLabels.end(); ) i = i->second == 0 ? mLabels.erase( i ) : std::next( i );
+            mUnused = 0;
+        }
+    }
+
+    //! the number of distinct labels in use
+    std::size_t size() const
+    {
+        std::lock_guard< std::mutex > lock( mMutex );
+        return mLabels.size() - mUnused;
+    }
+
+private:
+    //! unused labels kept in any case
+    static constexpr std::size_t min_unused = 64;
+
+    typedef resource_allocator< std::pair< const std::string, std::size_t > > label_allocator;
+
+    mutable std::mutex mMutex;
+    arena mArena{ 4 * 1024 };
+    std::unordered_map< std::string, std::size_t, std::hash< std::string >, std::equal_to< std::string >, label_allocator > mLabels;
+    std::size_t mUnused = 0;
+};
+
+}
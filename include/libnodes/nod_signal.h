@@ -4,14 +4,17 @@
 // MIT License, Copyright (c) 2015 Fredrik Berggren
 
 #include <vector>       // std::vector
-#include <functional>   // std::function
 #include <mutex>        // std::mutex, std::lock_guard
+#include <atomic>       // std::atomic
 #include <memory>       // std::shared_ptr, std::weak_ptr
 #include <algorithm>    // std::find_if()
 #include <cassert>      // assert()
 #include <thread>       // std::this_thread::yield()
 #include <type_traits>  // std::is_same
 #include <iterator>     // std::back_inserter
+#include <stdexcept>    // std::length_error
+#include "libnodes/arena.h"
+#include "libnodes/inplace_function.h"
 
 namespace nod {
 // implementational details
@@ -23,6 +26,188 @@ struct disconnector {
 /// Deleter that doesn't delete
 inline void no_delete(disconnector*){
 };
+/// The emissions in progress on one thread, published so that signals
+/// reclaiming disconnected slots know which of their emissions may still
+/// be calling them. Each nested emission has an entry, holding the signal
+/// it emits and the @ref emission_epoch it started in; entries past the
+/// first @ref depth nested emissions live in further records, allocated
+/// once a thread first nests that deep. Records are never freed, and are
+/// reused by the threads that start after their owner finished.
+struct emission_record {
+    static constexpr std::size_t depth = 16;
+    struct entry {
+        std::atomic<void const*> signal{ nullptr };
+        std::atomic<std::size_t> epoch{ 0 };
+    };
+
+    /// The entry of the next nested emission of the owning thread.
+    entry& push() {
+        auto record = this;
+        for( auto level = nesting++; ; level -= depth ) {
+            if( level < depth ) {
+                return record->entries[ level ];
+            }
+            if( record->deeper.load() == nullptr ) {
+                record->deeper.store( new emission_record );
+            }
+            record = record->deeper.load();
+        }
+    }
+
+    void pop() {
+        --nesting;
+    }
+
+    /// Whether an entry of this record, or of the deeper ones, is an
+    /// emission of \a signal that started before \a epoch.
+    bool holds( void const* signal, std::size_t epoch ) const {
+        for( auto record = this; record != nullptr; record = record->deeper.load() ) {
+            for( auto& e : record->entries ) {
+                auto emitting = e.signal.load();
+                // entries are filled in order, so the rest are empty, or
+                // emissions that started after this scan
+                if( emitting == nullptr ) {
+                    return false;
+                }
+                if( emitting == signal && e.epoch.load() < epoch ) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    entry entries[depth];
+    std::atomic<emission_record*> deeper{ nullptr };
+    /// Next record of all threads, see @ref records
+    emission_record* next = nullptr;
+    std::atomic<bool> in_use{ false };
+    /// Number of emissions in progress, only used by the owning thread
+    std::size_t nesting = 0;
+
+    /// The records of all threads, newest first.
+    static std::atomic<emission_record*>& records() {
+        static std::atomic<emission_record*> head{ nullptr };
+        return head;
+    }
+
+    /// The record of the calling thread.
+    static emission_record& local() {
+        struct owner {
+            owner() {
+                for( record = records().load(); record != nullptr; record = record->next ) {
+                    bool unused = false;
+                    if( record->in_use.compare_exchange_strong( unused, true ) ) {
+                        return;
+                    }
+                }
+                record = new emission_record;
+                record->in_use.store( true );
+                record->next = records().load();
+                while( !records().compare_exchange_weak( record->next, record ) ) {
+                }
+            }
+            ~owner() {
+                record->in_use.store( false );
+            }
+            emission_record* record;
+        };
+        static thread_local owner local;
+        return *local.record;
+    }
+};
+/// Epoch emissions of multithreaded signals start in, advanced by signals
+/// reclaiming disconnected slots.
+inline std::atomic<std::size_t>& emission_epoch() {
+    static std::atomic<std::size_t> epoch{ 1 };
+    return epoch;
+}
+/// Tracks the emissions of a signal without touching memory shared by its
+/// emitting threads: each emission publishes itself in the
+/// @ref emission_record of its own thread, which signals scan once they
+/// have slots to reclaim. Used by the multithreaded policy.
+struct published_emissions {
+    struct ticket {
+        emission_record* record;
+        emission_record::entry* entry;
+    };
+    ticket enter( void const* signal ) const {
+        auto& record = emission_record::local();
+        auto& entry = record.push();
+        entry.epoch.store( emission_epoch().load( std::memory_order_acquire ), std::memory_order_relaxed );
+        entry.signal.store( signal );
+        return ticket{ &record, &entry };
+    }
+    /// Returns whether the emission may have held back reclaiming.
+    bool exit( ticket t ) const {
+        t.entry->signal.store( nullptr );
+        t.record->pop();
+        return true;
+    }
+    /// Start a new epoch, returning it. Emissions of \a signal that started
+    /// before it may still see what was retired so far.
+    std::size_t advance() {
+        return emission_epoch().fetch_add( 1 ) + 1;
+    }
+    /// Whether the emissions of \a signal that started before \a epoch
+    /// have all finished.
+    bool passed( void const* signal, std::size_t epoch ) const {
+        for( auto record = emission_record::records().load(); record != nullptr; record = record->next ) {
+            if( record->holds( signal, epoch ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+/// Tracks the emissions of a signal in a count per epoch parity, kept by
+/// the signal itself. Used by the single threaded policy, where the counts
+/// are plain values.
+template <template <class> class Atomic>
+struct counted_emissions {
+    using ticket = std::size_t;
+    /// Register an emission in the count of the current epoch, and return
+    /// that epoch. The epoch is read again after registering, so an
+    /// emission that raced with @ref advance registers in the new one
+    /// instead.
+    ticket enter( void const* ) const {
+        for( ;; ) {
+            auto epoch = _epoch.load();
+            _readers[ epoch & 1 ].fetch_add( 1 );
+            if( _epoch.load() == epoch ) {
+                return epoch;
+            }
+            _readers[ epoch & 1 ].fetch_sub( 1 );
+        }
+    }
+    /// Returns whether the emission was the last one of its epoch.
+    bool exit( ticket epoch ) const {
+        return _readers[ epoch & 1 ].fetch_sub( 1 ) == 1;
+    }
+    std::size_t advance() {
+        _epoch.store( _epoch.load() + 1 );
+        return _epoch.load();
+    }
+    bool passed( void const*, std::size_t epoch ) const {
+        return _readers[ ( epoch - 1 ) & 1 ].load() == 0;
+    }
+    mutable Atomic<std::size_t> _readers[2] = { { 0 }, { 0 } };
+    Atomic<std::size_t> _epoch{ 0 };
+};
+/// Stand-in for std::atomic that does no synchronization, used by the
+/// single threaded policy.
+template <class T>
+struct unsynchronized
+{
+    unsynchronized( T v = T{} ) : _value( v ) {}
+    T load( std::memory_order = std::memory_order_seq_cst ) const { return _value; }
+    void store( T v, std::memory_order = std::memory_order_seq_cst ) { _value = v; }
+    T exchange( T v, std::memory_order = std::memory_order_seq_cst ) { T old = _value; _value = v; return old; }
+    T fetch_add( T v, std::memory_order = std::memory_order_seq_cst ) { T old = _value; _value += v; return old; }
+    T fetch_sub( T v, std::memory_order = std::memory_order_seq_cst ) { T old = _value; _value -= v; return old; }
+private:
+    T _value;
+};
 } // namespace detail
 
 /// Base template for the signal class
@@ -198,6 +383,12 @@ struct multithread_policy
 {
     using mutex_type = std::mutex;
     using mutex_lock_type = std::lock_guard<mutex_type>;
+    /// Atomic type used for the lock free parts of the signal.
+    template <class T>
+    using atomic_type = std::atomic<T>;
+    /// How emissions in progress are tracked, so that disconnected slots
+    /// are only destroyed once no emission can still be calling them.
+    using emissions_type = detail::published_emissions;
     /// Function that yields the current thread, allowing
     /// the OS to reschedule.
     static void yield_thread() {
@@ -225,6 +416,11 @@ struct singlethread_policy
         explicit mutex_lock_type( mutex_type const& ) {
         }
     };
+    /// Plain, non-atomic stand-in for std::atomic.
+    template <class T>
+    using atomic_type = detail::unsynchronized<T>;
+    /// Emissions are counted by the signal, in plain values.
+    using emissions_type = detail::counted_emissions<detail::unsynchronized>;
     /// Dummy implementation of thread yielding, that
     /// doesn't do any actual yielding.
     static void yield_thread() {
@@ -317,6 +513,14 @@ private:
 /// can be connected to a signal instance, as long as the signature
 /// of the slot matches the signature of the signal.
 ///
+/// Disconnecting a slot takes effect right away: emissions in progress
+/// do not call it anymore, unless they already started to. A slot
+/// connected during an emission is called from the next one on, and
+/// may be called by emissions in progress. Disconnected slots are
+/// destroyed once the emissions that may still be calling them have
+/// finished; connecting and disconnecting never wait for emissions, since
+/// a slot of one may be waiting for the thread that disconnects.
+///
 /// @tparam P      Threading policy for the signal.
 ///                A threading policy must provide two type definitions:
 ///                 - P::mutex_type, this type will be used as a mutex
@@ -326,6 +530,11 @@ private:
 ///                   and it must have the semantics of a scoped mutex lock
 ///                   like std::lock_guard, i.e. locking in the constructor
 ///                   and unlocking in the destructor.
+///                 - P::atomic_type<T>, a type with the interface of
+///                   std::atomic<T>, used to publish slots to
+///                   emissions without locking.
+///                 - P::emissions_type, which tracks the emissions in
+///                   progress, like detail::published_emissions.
 ///
 /// @tparam R      Return value type of the slots connected to the signal.
 /// @tparam A...   Argument types of the slots connected to the signal.
@@ -346,13 +555,20 @@ public:
     // Destruct the signal object.
     ~signal_type() {
         invalidate_disconnector();
+        release( _retiring );
+        release( _retired );
+        destroy_slots();
     }
 
+    /// The number of bytes a slot can capture.
+    static constexpr std::size_t slot_capacity = 64;
     /// Type that will be used to store the slots for this signal type.
-    using slot_type = std::function<R(A...)>;
+    /// Slots are stored inline where they were connected, so a callable
+    /// that captures more than @ref slot_capacity bytes does not compile.
+    /// Callables may be move-only, and may change when called.
+    using slot_type = nodes::inplace_function<R(A...), slot_capacity>;
     /// Type that is used for counting the slots connected to this signal.
-    using size_type = typename std::vector<slot_type>::size_type;
-
+    using size_type = std::size_t;
 
     /// Connect a new slot to the signal.
     ///
@@ -364,14 +580,19 @@ public:
     ///               disconnect the slot.
     template <class T>
     connection connect( T&& slot ) {
+        slot_type stored( std::forward<T>(slot) );
         mutex_lock_type lock{ _mutex };
-        _slots.push_back( std::forward<T>(slot) );
-        std::size_t index = _slots.size()-1;
+        std::size_t index = _count.load();
+        auto& entry = entry_at( index, true );
+        entry.fn = std::move( stored );
+        entry.state.store( slot_state::live );
+        _count.store( index+1 );
         if( _shared_disconnector == nullptr ) {
             _disconnector = disconnector{ this };
-            _shared_disconnector = std::shared_ptr<detail::disconnector>{&_disconnector, detail::no_delete};
+            _shared_disconnector = std::shared_ptr<detail::disconnector>{
+                    &_disconnector, detail::no_delete, nodes::resource_allocator<char>( _resource ) };
         }
-        ++_slot_count;
+        _slot_count.fetch_add( 1 );
         return connection{ _shared_disconnector, index };
     }
 
@@ -386,11 +607,9 @@ public:
     /// @param args   Arguments that will be propagated to the
     ///               connected slots when they are called.
     void operator()( A const&... args ) const {
-        for( auto const& slot : copy_slots() ) {
-            if( slot ) {
-                slot( args... );
-            }
-        }
+        for_each_slot( [&]( slot_type const& slot ) {
+            slot( args... );
+        } );
     }
 
     /// Construct a accumulator proxy object for the signal.
@@ -446,18 +665,59 @@ public:
         static_assert( std::is_same<R,void>::value == false, "Unable to aggregate slot return values with 'void' as return type." );
         C container;
         auto iterator = std::back_inserter( container );
-        for( auto const& slot : copy_slots() ) {
-            if( slot ) {
-                (*iterator) = slot( args... );
+        for_each_slot( [&]( slot_type const& slot ) {
+            (*iterator) = slot( args... );
+        } );
+        return container;
+    }
+
+    /// Call a function with each connected slot, and whether it is the
+    /// last one of this emission.
+    ///
+    /// This is how the signal is triggered when the last slot should be
+    /// treated differently, e.g. be allowed to move from an argument.
+    /// Each slot is called once the next connected one has been found, so
+    /// that the last one is known when it is called. A slot that the one
+    /// before it disconnects is not called, so the one before may have been
+    /// the last after all.
+    template <class F>
+    void visit_slots( F&& fn ) const
+    {
+        struct reader_guard {
+            signal_type const& signal;
+            typename emissions_type::ticket ticket;
+            ~reader_guard() {
+                if( signal._emissions.exit( ticket ) && signal._has_retired.load() ) {
+                    mutex_lock_type lock{ signal._mutex };
+                    const_cast<signal_type&>( signal ).reclaim();
+                }
+            }
+        };
+        reader_guard guard{ *this, _emissions.enter( this ) };
+        auto count = _count.load();
+        // a slot found before the previous one is called may be
+        // disconnected by it, so it is checked again
+        slot_entry const* pending = nullptr;
+        for( std::size_t segment = 0, start = 0; start < count; start += first_segment << segment++ ) {
+            auto entries = _segments.load()->segments[ segment ].load();
+            for( std::size_t i = 0; i < ( first_segment << segment ) && start+i < count; ++i ) {
+                if( entries[ i ].state.load() == slot_state::live ) {
+                    if( pending != nullptr && pending->state.load() == slot_state::live ) {
+                        fn( pending->fn, false );
+                    }
+                    pending = &entries[ i ];
+                }
             }
         }
-        return container;
+        if( pending != nullptr && pending->state.load() == slot_state::live ) {
+            fn( pending->fn, true );
+        }
     }
 
     /// Count the number of slots connected to this signal
     /// @returns   The number of connected slots
     size_type slot_count() const {
-        return _slot_count;
+        return _slot_count.load();
     }
 
     /// Determine if the signal is empty, i.e. no slots are connected
@@ -472,8 +732,10 @@ public:
     /// @note This operation invalidates all scoped_connection objects
     void disconnect_all_slots() {
         mutex_lock_type lock{ _mutex };
-        _slots.clear();
-        _slot_count = 0;
+        for( std::size_t index = 0, count = _count.load(); index < count; ++index ) {
+            retire( index );
+        }
+        reclaim();
         invalidate_disconnector();
     }
 
@@ -485,6 +747,44 @@ private:
     using mutex_type = typename thread_policy::mutex_type;
     /// Type of mutex lock, provided by threading policy
     using mutex_lock_type = typename thread_policy::mutex_lock_type;
+    /// Type of atomics, provided by threading policy
+    template <class T>
+    using atomic_type = typename thread_policy::template atomic_type<T>;
+    /// Type tracking emissions in progress, provided by threading policy
+    using emissions_type = typename thread_policy::emissions_type;
+    /// Number of slots in the first segment; each following segment is
+    /// twice the size of the previous one
+    static constexpr std::size_t first_segment = 4;
+    /// Number of segments, enough for some 67 million slots
+    static constexpr std::size_t max_segments = 24;
+    /// Whether an entry holds a slot, and whether it is still connected
+    enum class slot_state : unsigned char { empty, live, dead };
+    /// A slot and its state. Emissions call the slot only while it is live;
+    /// a dead slot was disconnected, and is destroyed once no emission can
+    /// still be calling it.
+    struct slot_entry {
+        slot_type fn;
+        atomic_type<slot_state> state{ slot_state::empty };
+        /// The next dead entry of the same @ref retired_set
+        std::size_t next_retired = 0;
+    };
+    /// Segments of slot entries, allocated as connecting reaches them
+    struct segment_table {
+        segment_table() {
+            for( auto& segment : segments ) {
+                segment.store( nullptr );
+            }
+        }
+        atomic_type<slot_entry*> segments[max_segments];
+    };
+    /// Slots disconnected while emissions may still be calling them,
+    /// linked through their entries so that retiring allocates nothing
+    struct retired_set {
+        std::size_t head = 0;
+        std::size_t count = 0;
+        bool empty() const { return count == 0; }
+        std::size_t size() const { return count; }
+    };
 
     /// Invalidate the internal disconnector object in a way
     /// that is safe according to the current thread policy.
@@ -512,27 +812,140 @@ private:
         }
     }
 
-    /// Retrieve a copy of the current slots
+    /// Call a function with each connected slot.
     ///
-    /// It's useful and necessary to copy the slots so we don't need
-    /// to hold the lock while calling the slots. If we hold the lock
-    /// we prevent the called slots from modifying the slots vector.
-    /// This simple "double buffering" will allow slots to disconnect
-    /// themself or other slots and connect new slots.
-    std::vector<slot_type> copy_slots() const
+    /// This takes no lock and allocates nothing: the emission registers
+    /// itself with the @ref emissions_type of the policy, and iterates the
+    /// slot entries up to the count connected when it started. Entries
+    /// live in segments that never move, so slots may disconnect themselves
+    /// or other slots and connect new slots while being called; a
+    /// disconnected slot is marked dead and stays alive until the
+    /// emissions of its epoch have finished (see @ref reclaim).
+    template <class F>
+    void for_each_slot( F&& fn ) const
     {
-        mutex_lock_type lock{ _mutex };
-        return _slots;
+        visit_slots( [&]( slot_type const& slot, bool ) {
+            fn( slot );
+        } );
+    }
+
+    /// The entry of the slot at \a index, allocating its segment if
+    /// \a grow is set. Must be called with the lock held.
+    slot_entry& entry_at( std::size_t index, bool grow = false )
+    {
+        std::size_t segment = 0;
+        while( index >= ( first_segment << segment ) ) {
+            index -= first_segment << segment++;
+        }
+        if( grow ) {
+            if( segment == max_segments ) {
+                throw std::length_error( "too many slots connected to a signal" );
+            }
+            if( _segments.load() == nullptr ) {
+                auto table = _resource->allocate( sizeof( segment_table ), alignof( segment_table ) );
+                _segments.store( new( table ) segment_table );
+            }
+            auto& entries = _segments.load()->segments[ segment ];
+            if( entries.load() == nullptr ) {
+                std::size_t size = first_segment << segment;
+                auto created = static_cast<slot_entry*>( _resource->allocate( size * sizeof( slot_entry ), alignof( slot_entry ) ) );
+                for( std::size_t i = 0; i < size; ++i ) {
+                    new( created + i ) slot_entry;
+                }
+                entries.store( created );
+            }
+        }
+        return _segments.load()->segments[ segment ].load()[ index ];
+    }
+
+    /// Destroy the slot entries and their segments.
+    void destroy_slots()
+    {
+        auto table = _segments.load();
+        if( table == nullptr ) {
+            return;
+        }
+        for( std::size_t segment = 0; segment < max_segments; ++segment ) {
+            auto entries = table->segments[ segment ].load();
+            if( entries == nullptr ) {
+                break;
+            }
+            std::size_t size = first_segment << segment;
+            for( std::size_t i = 0; i < size; ++i ) {
+                entries[ i ].~slot_entry();
+            }
+            _resource->deallocate( entries, size * sizeof( slot_entry ), alignof( slot_entry ) );
+        }
+        table->~segment_table();
+        _resource->deallocate( table, sizeof( segment_table ), alignof( segment_table ) );
+    }
+
+    /// Mark the slot at \a index dead, if it is live, and retire it.
+    /// Must be called with the lock held.
+    void retire( std::size_t index )
+    {
+        auto& entry = entry_at( index );
+        if( entry.state.load() == slot_state::live ) {
+            entry.state.store( slot_state::dead );
+            entry.next_retired = _retired.head;
+            _retired.head = index;
+            ++_retired.count;
+            _slot_count.fetch_sub( 1 );
+        }
+    }
+
+    /// Destroy the slots of \a set, and stop emissions at the last
+    /// entry still in use.
+    void release( retired_set& set )
+    {
+        for( auto index = set.head; set.count > 0; --set.count ) {
+            auto& entry = entry_at( index );
+            entry.fn = nullptr;
+            entry.state.store( slot_state::empty );
+            index = entry.next_retired;
+        }
+        auto count = _count.load();
+        while( count > 0 && entry_at( count-1 ).state.load() == slot_state::empty ) {
+            --count;
+        }
+        _count.store( count );
+    }
+
+    /// Destroy retired slots once the emissions that may still be calling
+    /// them have finished.
+    ///
+    /// What was retired since the last call moves to the next epoch, and is
+    /// deleted once the emissions that started before that epoch have
+    /// finished. New emissions start in the new epoch, so under constant
+    /// emission the older ones still drain, and emissions finishing retry.
+    /// Slots retired meanwhile wait for the next epoch, so the sets grow
+    /// while emissions keep an epoch from passing; the last of them to
+    /// finish calls this again. Never waits. Must be called with the lock
+    /// held.
+    void reclaim()
+    {
+        while( !_retiring.empty() || !_retired.empty() ) {
+            if( _retiring.empty() ) {
+                std::swap( _retiring, _retired );
+                _retiring_epoch = _emissions.advance();
+            }
+            // set before checking, so that an emission finishing
+            // concurrently either is seen here or sees the flag
+            _has_retired.store( true );
+            if( !_emissions.passed( this, _retiring_epoch ) ) {
+                return;
+            }
+            release( _retiring );
+        }
+        _has_retired.store( false );
     }
 
     /// Implementation of the signal accumulator function call
     template <class T, class F>
     typename signal_accumulator<signal_type, T, F, A...>::result_type trigger_with_accumulator( T value, F& func, A const&... args ) const {
-        for( auto const& slot : copy_slots() ) {
-            if( slot ) {
-                value = func( value, slot( args... ) );
-            }
-        }
+        for_each_slot( [&]( slot_type const& slot ) {
+            value = func( value, slot( args... ) );
+        } );
         return value;
     }
 
@@ -544,14 +957,9 @@ private:
     ///                be disconnected.
     void disconnect( std::size_t index ) {
         mutex_lock_type lock( _mutex );
-        assert( _slots.size() > index );
-        if( _slots[ index ] != nullptr ) {
-            --_slot_count;
-        }
-        _slots[ index ] = slot_type{};
-        while( _slots.size()>0 && !_slots.back() ) {
-            _slots.pop_back();
-        }
+        assert( index < _count.load() );
+        retire( index );
+        reclaim();
     }
 
     /// Implementation of the shared disconnection state
@@ -589,12 +997,27 @@ private:
         signal_type<P,R(A...)>* _ptr;
     };
 
-    /// Mutex to synchronize access to the slot vector
+    /// Where slot entries and the shared disconnector are allocated, the
+    /// resource current when the signal was constructed
+    nodes::memory_resource* _resource = nodes::memory_resource::current();
+    /// Mutex to synchronize modifications of the slots
     mutable mutex_type _mutex;
-    /// Vector of all connected slots
-    std::vector<slot_type> _slots;
+    /// Segments of slot entries, allocated on first connection
+    atomic_type<segment_table*> _segments{ nullptr };
+    /// Number of entries emissions iterate, up to the last one in use
+    atomic_type<std::size_t> _count{ 0 };
+    /// Emissions in progress
+    mutable emissions_type _emissions;
+    /// Retired in the current epoch
+    retired_set _retired;
+    /// Retired in the previous epoch, waiting for its emissions to finish
+    retired_set _retiring;
+    /// The epoch @ref _retiring was retired before
+    std::size_t _retiring_epoch = 0;
+    /// Whether there are retired slots waiting to be destroyed
+    mutable atomic_type<bool> _has_retired{ false };
     /// Number of connected slots
-    size_type _slot_count;
+    atomic_type<size_type> _slot_count;
     /// Disconnector operation, used for executing disconnection in a
     /// type erased manner.
     disconnector _disconnector;
@@ -5,17 +5,16 @@
 namespace nodes {
 namespace operators {
 
-//! Connect an outlet to an inlet
+//! Connect an outlet to an inlet, returning a handle to the connection
 template<
         typename To,
         typename Ti,
         typename I = typename Ti::type,
         typename O = typename To::type
 >
-inline const Ti & operator>>( To &outlet, Ti &inlet )
+inline connection_handle operator>>( To &outlet, Ti &inlet )
 {
-    outlet.connect( inlet );
-    return inlet;
+    return outlet.connect( inlet );
 }
 
 //! Connect a node ref's first outlet to another node ref's first inlet
@@ -48,7 +47,8 @@ inline No & operator>>( Ni &input, No &output )
     return output;
 }
 
-//! Connect a node's first outlet to an inlet
+//! Connect a node's first outlet to an inlet, returning a handle to the
+//! connection
 template<
         typename Ni,
         typename Ti,
@@ -56,10 +56,9 @@ template<
         typename To = typename Ni::template outlet_type< Ii >::type,
         typename I = typename Ti::type
 >
-inline Ti & operator>>( Ni &input, Ti &inlet )
+inline connection_handle operator>>( Ni &input, Ti &inlet )
 {
-    input.template out< Ii >() >> inlet;
-    return inlet;
+    return input.template out< Ii >() >> inlet;
 }
 
 }
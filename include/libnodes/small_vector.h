@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include "libnodes/arena.h"
+
+namespace nodes {
+
+//! A vector of trivially copyable values that keeps up to \a N of them
+//! inline, and only allocates once it grows past that, from the
+//! memory_resource current when it was constructed.
+template< typename T, std::size_t N >
+class small_vector
+{
+    static_assert( std::is_trivially_copyable< T >::value, "small_vector only holds trivially copyable types" );
+    static_assert( N > 0, "small_vector needs room for at least one inline element" );
+
+public:
+    typedef T value_type;
+    typedef T *iterator;
+    typedef const T *const_iterator;
+
+    //! the number of elements stored without allocating
+    static constexpr std::size_t inline_capacity = N;
+
+    explicit small_vector( memory_resource *resource = memory_resource::current() ) : mResource( resource ) {}
+
+    small_vector( const small_vector & ) = delete;
+
+    small_vector &operator=( const small_vector & ) = delete;
+
+    ~small_vector() { release(); }
+
+    void push_back( const T &value )
+    {
+        if ( mSize == mCapacity ) grow( mCapacity * 2 );
+        std::memcpy( static_cast< void * >( mData + mSize ), &value, sizeof( T ));
+        ++mSize;
+    }
+
+    //! removes the element at \a pos, keeping the order of the others
+    iterator erase( iterator pos )
+    {
+        std::memmove( static_cast< void * >( pos ), pos + 1, ( end() - pos - 1 ) * sizeof( T ));
+        --mSize;
+        return pos;
+    }
+
+    void pop_back() { --mSize; }
+
+    //! removes all elements, and releases any heap storage
+    void clear()
+    {
+        release();
+        mData = inlineData();
+        mSize = 0;
+        mCapacity = N;
+    }
+
+    T &operator[]( std::size_t i ) { return mData[ i ]; }
+    const T &operator[]( std::size_t i ) const { return mData[ i ]; }
+
+    T &back() { return mData[ mSize - 1 ]; }
+    const T &back() const { return mData[ mSize - 1 ]; }
+
+    iterator begin() { return mData; }
+    iterator end() { return mData + mSize; }
+    const_iterator begin() const { return mData; }
+    const_iterator end() const { return mData + mSize; }
+    const_iterator cbegin() const { return mData; }
+    const_iterator cend() const { return mData + mSize; }
+
+    std::size_t size() const { return mSize; }
+    std::size_t capacity() const { return mCapacity; }
+    bool empty() const { return mSize == 0; }
+
+    //! whether the elements are currently stored inline
+    bool isInline() const { return mData == inlineData(); }
+
+    //! where storage past the inline capacity is allocated
+    memory_resource *resource() const { return mResource; }
+
+private:
+    T *inlineData() { return reinterpret_cast< T * >( &mInline ); }
+    const T *inlineData() const { return reinterpret_cast< const T * >( &mInline ); }
+
+    void grow( std::size_t capacity )
+    {
+        auto data = static_cast< T * >( mResource->allocate( capacity * sizeof( T ), alignof( T )));
+        std::memcpy( static_cast< void * >( data ), mData, mSize * sizeof( T ));
+        release();
+        mData = data;
+        mCapacity = capacity;
+    }
+
+    void release()
+    {
+        if ( ! isInline() ) mResource->deallocate( mData, mCapacity * sizeof( T ), alignof( T ));
+    }
+
+    typename std::aligned_storage< sizeof( T ) * N, alignof( T ) >::type mInline;
+    T *mData = inlineData();
+    std::size_t mSize = 0;
+    std::size_t mCapacity = N;
+    memory_resource *mResource;
+};
+
+}
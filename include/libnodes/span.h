@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace nodes {
+
+//! A non-owning view of \a T values stored contiguously, for passing
+//! batches around without copying them. Stands in for C++20's std::span.
+template< typename T >
+class span
+{
+public:
+    typedef T element_type;
+    typedef typename std::remove_cv< T >::type value_type;
+    typedef T *iterator;
+    typedef T *pointer;
+    typedef T &reference;
+
+    span() = default;
+
+    span( T *data, std::size_t size ) : mData( data ), mSize( size ) {}
+
+    template< std::size_t N >
+    span( T ( &array )[ N ] ) : mData( array ), mSize( N ) {}
+
+    //! views any contiguous container with data() and size(), like
+    //! std::vector or std::array. Spans of const values can view temporary
+    //! containers, which is useful for passing them as arguments.
+    template< typename C, typename = typename std::enable_if<
+            std::is_convertible< decltype( std::declval< C & >().data() ), T * >::value
+            && ( std::is_lvalue_reference< C >::value || std::is_const< T >::value ) >::type >
+    span( C &&container ) : mData( container.data() ), mSize( container.size() ) {}
+
+    //! a span of mutable values converts to a span of const ones
+    template< typename U, typename = typename std::enable_if< std::is_convertible< U *, T * >::value >::type >
+    span( const span< U > &other ) : mData( other.data() ), mSize( other.size() ) {}
+
+    T *data() const { return mData; }
+    std::size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+
+    T &operator[]( std::size_t i ) const { return mData[ i ]; }
+    T &front() const { return mData[ 0 ]; }
+    T &back() const { return mData[ mSize - 1 ]; }
+
+    iterator begin() const { return mData; }
+    iterator end() const { return mData + mSize; }
+
+    //! the \a count values starting at \a offset
+    span subspan( std::size_t offset, std::size_t count ) const { return span( mData + offset, count ); }
+
+private:
+    T *mData = nullptr;
+    std::size_t mSize = 0;
+};
+
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace nodes {
+
+//! The size of a cache line, to keep data written by different threads apart.
+static constexpr std::size_t cache_line_size = 64;
+
+//! A bounded lock free ring buffer for exactly one producer thread and one
+//! consumer thread. The indices each side writes live on cache lines of
+//! their own. Every slot carries a sequence number telling which lap of the
+//! ring it holds a value for, so the producer may also pop from the front to
+//! make room, while the consumer pops, without either reusing a slot the
+//! other is still reading (after Vyukov's bounded queue).
+template< typename T >
+class spsc_queue
+{
+public:
+    //! holds at least \a capacity values; rounded up to a power of two
+    explicit spsc_queue( std::size_t capacity ) :
+            mMask( roundUp( capacity ) - 1 ),
+            mSlots( new slot[ mMask + 1 ] )
+    {
+        for ( std::size_t i = 0; i <= mMask; ++i ) mSlots[ i ].sequence.store( i, std::memory_order_relaxed );
+    }
+
+    spsc_queue( const spsc_queue & ) = delete;
+
+    spsc_queue &operator=( const spsc_queue & ) = delete;
+
+    ~spsc_queue()
+    {
+        auto head = mHead.load( std::memory_order_relaxed );
+        auto tail = mTail.load( std::memory_order_relaxed );
+        for ( ; head != tail; ++head ) mSlots[ head & mMask ].value()->~T();
+    }
+
+    std::size_t capacity() const { return mMask + 1; }
+
+    //! the number of values queued; only exact when neither side is busy
+    std::size_t size() const
+    {
+        auto head = mHead.load( std::memory_order_acquire );
+        auto tail = mTail.load( std::memory_order_acquire );
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    //! the number of values pushed since the queue was made
+    std::size_t pushed() const { return mTail.load( std::memory_order_acquire ); }
+
+    //! Adds \a value at the back, or returns false if the queue is full.
+    //! Only called by the producer.
+    template< typename U >
+    bool try_push( U &&value )
+    {
+        auto tail = mTail.load( std::memory_order_relaxed );
+        auto &s = mSlots[ tail & mMask ];
+        if ( s.sequence.load( std::memory_order_acquire ) != tail ) return false;
+        new ( s.value() ) T( std::forward< U >( value ) );
+        s.sequence.store( tail + 1, std::memory_order_release );
+        mTail.store( tail + 1, std::memory_order_release );
+        return true;
+    }
+
+    //! Whether try_push() would find room. Only called by the producer.
+    bool can_push() const
+    {
+        auto tail = mTail.load( std::memory_order_relaxed );
+        return mSlots[ tail & mMask ].sequence.load( std::memory_order_acquire ) == tail;
+    }
+
+    //! Moves the value at the front into \a value, or returns false if the
+    //! queue is empty. Only called by the consumer.
+    bool try_pop( T &value )
+    {
+        return pop( [&]( T &front ) { value = std::move( front ); } );
+    }
+
+    //! Destroys the value at the front, or returns false if the queue is
+    //! empty. Called by either side, for the producer to make room.
+    bool try_drop()
+    {
+        return pop( []( T & ) {} );
+    }
+
+    //! Calls \a fn with up to \a max values from the front, moving each out
+    //! of the queue, and returns how many there were. Each slot is freed
+    //! before \a fn is called. Only called by the consumer.
+    template< typename F >
+    std::size_t consume( F &&fn, std::size_t max = std::size_t( -1 ) )
+    {
+        std::size_t count = 0;
+        storage popped;
+        auto value = reinterpret_cast< T * >( &popped );
+        for ( ; count < max; ++count ) {
+            if ( ! pop( [&]( T &front ) { new ( value ) T( std::move( front ) ); } ) ) break;
+            struct destroy
+            {
+                ~destroy() { value->~T(); }
+                T *value;
+            } d{ value };
+            fn( std::move( *value ) );
+        }
+        return count;
+    }
+
+private:
+    typedef typename std::aligned_storage< sizeof( T ), alignof( T ) >::type storage;
+
+    //! A value and the position it is for: a slot at position p is free at
+    //! p, holds a value at p + 1, and is free for the next lap at p +
+    //! capacity once that value has been moved out.
+    struct slot
+    {
+        T *value() { return reinterpret_cast< T * >( &data ); }
+
+        std::atomic< std::size_t > sequence;
+        storage data;
+    };
+
+    static std::size_t roundUp( std::size_t n )
+    {
+        std::size_t p = 1;
+        while ( p < n ) p <<= 1;
+        return p;
+    }
+
+    //! Calls \a take with the value at the front, and frees its slot.
+    //! Returns false if there is none.
+    template< typename F >
+    bool pop( F &&take )
+    {
+        auto head = mHead.load( std::memory_order_relaxed );
+        while ( true ) {
+            auto &s = mSlots[ head & mMask ];
+            auto ahead = std::ptrdiff_t( s.sequence.load( std::memory_order_acquire ) - ( head + 1 ) );
+            if ( ahead < 0 ) return false;
+            if ( ahead > 0 ) {
+                // the other side popped this one first
+                head = mHead.load( std::memory_order_relaxed );
+                continue;
+            }
+            if ( mHead.compare_exchange_weak( head, head + 1, std::memory_order_relaxed ) ) {
+                take( *s.value() );
+                s.value()->~T();
+                s.sequence.store( head + mMask + 1, std::memory_order_release );
+                return true;
+            }
+        }
+    }
+
+    const std::size_t mMask;
+    const std::unique_ptr< slot[] > mSlots;
+
+    //! Padding rather than alignas, which new only honours from C++17 on.
+    typedef char padding[ cache_line_size ];
+    typedef char padding_rest[ cache_line_size - sizeof( std::atomic< std::size_t > ) ];
+
+    padding mPadding0;
+    //! advanced by whichever side pops
+    std::atomic< std::size_t > mHead{ 0 };
+    padding_rest mPadding1;
+
+    //! advanced by the producer
+    std::atomic< std::size_t > mTail{ 0 };
+    padding_rest mPadding2;
+};
+
+}
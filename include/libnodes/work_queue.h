@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include "libnodes/arena.h"
+#include "libnodes/dispatch_hooks.h"
+#include "libnodes/inplace_function.h"
+
+namespace nodes {
+
+//! The order in which a work_queue runs the updates posted to it. FIFO
+//! propagates breadth first. LIFO runs the latest update first, so it
+//! propagates depth first, but takes the branches of a fan-out from the
+//! last connected to the first, where direct calls start with the first.
+enum class propagation_order { fifo, lifo };
+
+//! An explicit queue of deferred updates, drained in a loop.
+//!
+//! Outlets that use a work queue post their updates to it instead of calling
+//! the connected inlets directly. The first update runs right away and every
+//! update it causes is queued and run after it returns, so the stack depth
+//! stays constant however deep the graph is. The queue keeps its storage
+//! from one update to the next, allocated from the memory_resource current
+//! when it was constructed. If an update throws, the updates still queued
+//! are dropped and the exception leaves run().
+//!
+//! A work queue is used by one thread at a time. It can be set on the
+//! outlets of a graph with Node::setWorkQueue, or made the default of the
+//! calling thread with a work_queue::scope.
+class work_queue
+{
+public:
+    explicit work_queue( propagation_order order = propagation_order::fifo, memory_resource *resource = memory_resource::current() ) :
+            mOrder( order ),
+            mTasks( resource_allocator< task >( resource ) )
+    {}
+
+    work_queue( const work_queue & ) = delete;
+
+    work_queue &operator=( const work_queue & ) = delete;
+
+    propagation_order order() const { return mOrder; }
+
+    //! whether the queue is currently running updates
+    bool draining() const { return mDraining; }
+
+    //! the number of updates waiting to run
+    std::size_t size() const { return mTasks.size() - mHead; }
+
+    //! Runs \a fn now, and then everything it posted. Must not be called
+    //! while the queue is draining.
+    template< typename F >
+    void run( F &&fn )
+    {
+        drain_guard guard( *this );
+        fn();
+        drain();
+    }
+
+    //! Queues \a fn to run after the updates posted before it (FIFO) or
+    //! before them (LIFO). Callables up to task::capacity bytes are stored
+    //! without allocating; larger ones, or ones that may throw when moved,
+    //! are allocated from the memory_resource of the queue.
+    template< typename F >
+    void post( F &&fn )
+    {
+        mTasks.push_back( make_inplace_function< task >( std::forward< F >( fn ), mTasks.get_allocator().resource() ) );
+    }
+
+    //! The work queue used by outlets on the calling thread that have none
+    //! of their own, or nullptr to call inlets directly.
+    static work_queue *current() { return dispatch_hooks::local().queue; }
+
+    //! Makes a work queue the default of the calling thread for its lifetime.
+    class scope
+    {
+    public:
+        explicit scope( work_queue &queue ) : mBinding( &dispatch_hooks::queue, &queue ) {}
+
+    private:
+        dispatch_hooks::binding< work_queue > mBinding;
+    };
+
+private:
+    typedef inplace_function< void(), 48 > task;
+
+    //! marks the queue as draining, and afterwards clears the mark and the
+    //! tasks, including those left when a task throws, so that they do not
+    //! run on the next update
+    struct drain_guard
+    {
+        work_queue &queue;
+        explicit drain_guard( work_queue &q ) : queue( q ) { queue.mDraining = true; }
+        ~drain_guard()
+        {
+            queue.mTasks.clear();
+            queue.mHead = 0;
+            queue.mDraining = false;
+        }
+    };
+
+    void drain()
+    {
+        while ( mHead < mTasks.size() ) {
+            task next( take() );
+            next();
+        }
+    }
+
+    task take()
+    {
+        if ( mOrder == propagation_order::lifo ) {
+            task t( std::move( mTasks.back() ) );
+            mTasks.pop_back();
+            return t;
+        }
+        task t( std::move( mTasks[ mHead++ ] ) );
+        // drop the tasks already run once they make up most of the queue
+        if ( mHead >= 1024 && mHead * 2 >= mTasks.size() ) {
+            mTasks.erase( mTasks.begin(), mTasks.begin() + mHead );
+            mHead = 0;
+        }
+        return t;
+    }
+
+    propagation_order mOrder;
+    bool mDraining = false;
+    resource_vector< task > mTasks;
+    std::size_t mHead = 0;
+};
+
+}
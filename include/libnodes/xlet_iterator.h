@@ -91,7 +91,7 @@ public:
             typename Ts,
             typename Ti = xlet_iterator<container_type, Ts::start_value, Ts::end_value>
     >
-    Ti operator[]( const Ts &sel )
+    Ti operator[]( const Ts & )
     {
         return Ti{mXlets};
     }
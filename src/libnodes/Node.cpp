@@ -2,5 +2,3 @@
 
 using namespace nodes;
 using namespace std;
-
-uint64_t HasId::sId = 0;
\ No newline at end of file
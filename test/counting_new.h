@@ -0,0 +1,67 @@
+#pragma once
+
+//! Replaces the global operator new and delete with ones that count the
+//! allocations, for the tests and the benchmarks. Include this header in
+//! exactly one translation unit per executable.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace counting_new {
+
+//! the number of calls to operator new, on all threads
+inline std::atomic< std::size_t > &calls()
+{
+    static std::atomic< std::size_t > count{ 0 };
+    return count;
+}
+
+//! the number of calls to operator new on the calling thread
+inline std::size_t &threadCalls()
+{
+    static thread_local std::size_t count = 0;
+    return count;
+}
+
+//! the allocations made less those freed on the calling thread
+inline std::ptrdiff_t &threadLive()
+{
+    static thread_local std::ptrdiff_t live = 0;
+    return live;
+}
+
+}
+
+void *operator new( std::size_t size )
+{
+    counting_new::calls().fetch_add( 1, std::memory_order_relaxed );
+    ++counting_new::threadCalls();
+    ++counting_new::threadLive();
+    if ( void *p = std::malloc( size ? size : 1 ) ) return p;
+    throw std::bad_alloc();
+}
+
+// GCC takes the pointers freed here for ones from the standard operator new
+// once these are inlined, although they come from the malloc above.
+#if defined( __GNUC__ ) && ! defined( __clang__ ) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete( void *p ) noexcept
+{
+    if ( p ) --counting_new::threadLive();
+    std::free( p );
+}
+
+void operator delete( void *p, std::size_t ) noexcept
+{
+    if ( p ) --counting_new::threadLive();
+    std::free( p );
+}
+
+#if defined( __GNUC__ ) && ! defined( __clang__ ) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,165 @@
+#include "catch.hpp"
+#include "libnodes/Node.h"
+#include "libnodes/operators.h"
+#include "libnodes/Actor.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace nodes;
+using namespace std;
+using namespace Catch;
+using namespace nodes::operators;
+
+
+//! Sums what it receives on either inlet, and notes whether two of its
+//! listeners ever ran at the same time.
+class Sum_INode : public Node< Inlets< int, int >, Outlets<> > {
+public:
+    Sum_INode() {
+        in< 0 >().onReceive( [this]( const int &i ) { add( i ); } );
+        in< 1 >().onReceive( [this]( int i ) { add( i ); } );
+    }
+
+    void add( int i ) {
+        if ( running.fetch_add( 1 ) != 0 ) overlapped = true;
+        if ( i < 0 ) {
+            running.fetch_sub( 1 );
+            throw runtime_error( "negative" );
+        }
+        sum += i;
+        ++received;
+        thread = this_thread::get_id();
+        running.fetch_sub( 1 );
+    }
+
+    atomic< int > running{ 0 };
+    atomic< bool > overlapped{ false };
+    long sum = 0;
+    int received = 0;
+    std::thread::id thread;
+};
+
+SCENARIO( "With an actor", "[nodes]" ) {
+    Executor executor( 4 );
+    Sum_INode node;
+
+    THEN( "values sent from several threads are all handled, one at a time" ) {
+        Actor actor( node, executor );
+        vector< unique_ptr< Outlet< int > > > outlets;
+        for ( int p = 0; p < 4; ++p ) {
+            outlets.emplace_back( new Outlet< int > );
+            if ( p % 2 ) {
+                *outlets.back() >> node.in< 1 >();
+            } else {
+                *outlets.back() >> node.in< 0 >();
+            }
+        }
+        vector< std::thread > producers;
+        for ( auto &out : outlets ) {
+            producers.emplace_back( [&out] {
+                for ( int i = 1; i <= 1000; ++i ) out->update( i );
+            } );
+        }
+        for ( auto &p : producers ) p.join();
+        actor.wait();
+
+        REQUIRE( node.received == 4000 );
+        REQUIRE( node.sum == 4 * 500500 );
+        REQUIRE_FALSE( node.overlapped );
+        REQUIRE( actor.pending() == 0 );
+    }
+
+    THEN( "listeners run on the executor, in the order values arrived" ) {
+        vector< int > seen;
+        node.in< 0 >().onReceive( [&]( const int &i ) { seen.push_back( i ); } );
+        Actor actor( node, executor );
+        Outlet< int > out;
+        out >> node.in< 0 >();
+        for ( int i = 0; i < 500; ++i ) out.update( i );
+        out.update_batch( vector< int >{ 500, 501 } );
+        actor.wait();
+
+        REQUIRE( seen.size() == 502 );
+        for ( int i = 0; i < 502; ++i ) REQUIRE( seen[ i ] == i );
+        REQUIRE( node.thread != this_thread::get_id() );
+    }
+
+    THEN( "wait rethrows what a listener threw" ) {
+        Actor actor( node, executor );
+        Outlet< int > out;
+        out >> node.in< 0 >();
+        out.update( -1 );
+        out.update( 2 );
+        REQUIRE_THROWS_AS( actor.wait(), runtime_error );
+        REQUIRE( node.sum == 2 );
+        REQUIRE_NOTHROW( actor.wait() );
+    }
+
+    THEN( "without the actor, inlets call their listeners directly again" ) {
+        Outlet< int > out;
+        out >> node.in< 0 >();
+        {
+            Actor actor( node, executor );
+            REQUIRE( node.in< 0 >().actor() == &actor );
+            out.update( 1 );
+        }
+        REQUIRE( node.received == 1 );
+        REQUIRE( node.in< 0 >().actor() == nullptr );
+        out.update( 2 );
+        REQUIRE( node.received == 2 );
+        REQUIRE( node.thread == this_thread::get_id() );
+    }
+
+    THEN( "messages too large to store inline come from the resource the actor was made in" ) {
+        arena pool;
+        unique_ptr< Actor > actor;
+        {
+            memory_resource::scope scope( pool );
+            actor.reset( new Actor( node, executor ) );
+        }
+        array< int, 32 > values;
+        values.fill( 1 );
+        int sum = 0;
+        auto before = pool.used();
+        std::size_t during = 0;
+        actor->post( [values, &sum, &during, &pool] {
+            for ( auto v : values ) sum += v;
+            during = pool.used();
+        } );
+        actor->wait();
+
+        REQUIRE( sum == 32 );
+        REQUIRE( during >= before + sizeof( values ) );
+        REQUIRE( pool.used() + sizeof( values ) <= during );
+    }
+
+    THEN( "a busy actor takes turns with other jobs on its worker" ) {
+        Executor single( 1 );
+        atomic< int > slept{ 0 };
+        node.in< 0 >().onReceive( [&slept]( const int & ) {
+            this_thread::sleep_for( chrono::microseconds( 20 ) );
+            ++slept;
+        } );
+        Actor actor( node, single );
+        Outlet< int > out;
+        out >> node.in< 0 >();
+        for ( int i = 0; i < 1000; ++i ) out.update( 1 );
+
+        atomic< int > sleptBefore{ -1 };
+        executor_job other{ []( executor_job &job ) {
+            auto counted = static_cast< atomic< int > * >( job.function );
+            static_cast< atomic< int > * >( job.item )->store( counted->load() );
+        }, &slept, &sleptBefore, nullptr };
+        single.submit( other );
+        actor.wait();
+
+        REQUIRE( slept.load() == 1000 );
+        REQUIRE( sleptBefore.load() > 0 );
+        REQUIRE( sleptBefore.load() < 1000 );
+    }
+}
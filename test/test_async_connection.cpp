@@ -0,0 +1,188 @@
+#include "catch.hpp"
+#include "libnodes/Node.h"
+#include "libnodes/operators.h"
+#include "libnodes/spsc_queue.h"
+#include "libnodes/ValueNode.h"
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace nodes;
+using namespace std;
+using namespace Catch;
+using namespace nodes::operators;
+
+
+SCENARIO( "With an spsc_queue", "[nodes]" ) {
+    spsc_queue< unique_ptr< int > > queue( 5 );
+
+    THEN( "its capacity is rounded up to a power of two" ) {
+        REQUIRE( queue.capacity() == 8 );
+    }
+
+    THEN( "values come out in order until it is empty" ) {
+        for ( int i = 0; i < 8; ++i ) REQUIRE( queue.try_push( unique_ptr< int >( new int( i ) ) ) );
+        REQUIRE_FALSE( queue.try_push( unique_ptr< int >( new int( 8 ) ) ) );
+        REQUIRE( queue.size() == 8 );
+
+        unique_ptr< int > value;
+        REQUIRE( queue.try_pop( value ) );
+        REQUIRE( *value == 0 );
+
+        vector< int > rest;
+        REQUIRE( queue.consume( [&]( unique_ptr< int > &&v ) { rest.push_back( *v ); }, 3 ) == 3 );
+        REQUIRE( queue.consume( [&]( unique_ptr< int > &&v ) { rest.push_back( *v ); } ) == 4 );
+        REQUIRE(( rest == vector< int >{ 1, 2, 3, 4, 5, 6, 7 } ));
+        REQUIRE_FALSE( queue.try_pop( value ) );
+        REQUIRE( queue.empty() );
+    }
+
+    THEN( "the front can be dropped to make room" ) {
+        for ( int i = 0; i < 8; ++i ) queue.try_push( unique_ptr< int >( new int( i ) ) );
+        REQUIRE( queue.try_drop() );
+        REQUIRE( queue.try_push( unique_ptr< int >( new int( 8 ) ) ) );
+
+        unique_ptr< int > value;
+        REQUIRE( queue.try_pop( value ) );
+        REQUIRE( *value == 1 );
+    }
+}
+
+SCENARIO( "With an async connection", "[nodes]" ) {
+    Outlet< int > source;
+    Inlet< int > sink;
+    vector< int > received;
+    sink.onReceive( [&]( const int &i ) { received.push_back( i ); } );
+
+    THEN( "values wait for the receiving thread to pump them" ) {
+        auto async = source.connect_async( sink, 4 );
+        source.update( 1 );
+        source.update( 2 );
+        REQUIRE( received.empty() );
+        REQUIRE( async->pending() == 2 );
+
+        REQUIRE( async->pump( 1 ) == 1 );
+        REQUIRE( received == vector< int >{ 1 } );
+        REQUIRE( async->pump() == 1 );
+        REQUIRE(( received == vector< int >{ 1, 2 } ));
+        REQUIRE( async->pump() == 0 );
+    }
+
+    THEN( "values cross threads in order, the sender waiting while the queue is full" ) {
+        auto async = source.connect_async( sink, 16 );
+        std::thread producer( [&] {
+            for ( int i = 0; i < 100000; ++i ) source.update( i );
+        } );
+        while ( received.size() < 100000 ) {
+            if ( async->pump() == 0 ) this_thread::yield();
+        }
+        producer.join();
+
+        bool ordered = true;
+        for ( int i = 0; i < 100000; ++i ) ordered = ordered && received[ i ] == i;
+        REQUIRE( ordered );
+    }
+
+    THEN( "moved values stay moved" ) {
+        Outlet< string > strings;
+        Inlet< string > text;
+        string last;
+        text.onReceive( [&]( string s ) { last = std::move( s ); } );
+        auto async = strings.connect_async( text );
+        string s( 100, 'x' );
+        auto data = s.data();
+        strings.update( std::move( s ) );
+        async->pump();
+        REQUIRE( last.data() == data );
+    }
+
+    THEN( "destroying the connection disconnects both ends" ) {
+        auto async = source.connect_async( sink );
+        REQUIRE( source.numConnections() == 1 );
+        REQUIRE( sink.numConnections() == 1 );
+        async.reset();
+        REQUIRE_FALSE( source.isConnected() );
+        REQUIRE_FALSE( sink.isConnected() );
+    }
+
+    THEN( "a full queue blocks, or drops the oldest or the newest value" ) {
+        auto blocking = source.connect_async( sink, 4, overflow_policy::block );
+        Inlet< int > oldest, newest;
+        vector< int > fromOldest, fromNewest;
+        oldest.onReceive( [&]( const int &i ) { fromOldest.push_back( i ); } );
+        newest.onReceive( [&]( const int &i ) { fromNewest.push_back( i ); } );
+        auto dropOldest = source.connect_async( oldest, 4, overflow_policy::drop_oldest );
+        auto dropNewest = source.connect_async( newest, 4, overflow_policy::drop_newest );
+
+        for ( int i = 0; i < 4; ++i ) source.update( i );
+        std::thread producer( [&] { source.update( 4 ); source.update( 5 ); } );
+        while ( blocking->blocked() == 0 ) this_thread::yield();
+        blocking->pump();
+        producer.join();
+        blocking->pump();
+        dropOldest->pump();
+        dropNewest->pump();
+
+        REQUIRE(( received == vector< int >{ 0, 1, 2, 3, 4, 5 } ));
+        REQUIRE(( fromOldest == vector< int >{ 2, 3, 4, 5 } ));
+        REQUIRE(( fromNewest == vector< int >{ 0, 1, 2, 3 } ));
+        REQUIRE( blocking->dropped() == 0 );
+        REQUIRE( dropOldest->dropped() == 2 );
+        REQUIRE( dropOldest->blocked() == 0 );
+        REQUIRE( dropNewest->dropped() == 2 );
+    }
+
+    THEN( "an update blocked by a stalled receiver sleeps until room is made" ) {
+        auto blocking = source.connect_async( sink, 4, overflow_policy::block );
+        for ( int i = 0; i < 4; ++i ) source.update( i );
+        std::thread producer( [&] { source.update( 4 ); } );
+        while ( blocking->blocked() == 0 ) this_thread::yield();
+
+        // a producer spinning all along would use about as much processor
+        // time as the stall lasts
+        auto cpu = std::clock();
+        this_thread::sleep_for( chrono::milliseconds( 200 ) );
+        auto spent = double( std::clock() - cpu ) / CLOCKS_PER_SEC;
+        REQUIRE( spent < 0.1 );
+
+        blocking->pump();
+        producer.join();
+        blocking->pump();
+        REQUIRE(( received == vector< int >{ 0, 1, 2, 3, 4 } ));
+    }
+
+    THEN( "values dropped while both threads run are accounted for" ) {
+        auto async = source.connect_async( sink, 8, overflow_policy::drop_oldest );
+        atomic< bool > done{ false };
+        std::thread producer( [&] {
+            for ( int i = 0; i < 100000; ++i ) source.update( i );
+            done = true;
+        } );
+        while ( ! done ) async->pump();
+        producer.join();
+        async->pump();
+
+        bool increasing = true;
+        for ( size_t i = 1; i < received.size(); ++i ) increasing = increasing && received[ i - 1 ] < received[ i ];
+        REQUIRE( increasing );
+        REQUIRE( received.back() == 99999 );
+        REQUIRE( received.size() + async->dropped() == 100000 );
+    }
+
+    THEN( "a coalescing connection delivers the latest value of a value node" ) {
+        ValueNodei value;
+        auto async = value.out< 0 >().connect_async( sink, 4, overflow_policy::coalesce_latest );
+        for ( int i = 1; i <= 10; ++i ) value.in< 0 >().receive( i );
+
+        REQUIRE( async->pump() == 4 );
+        REQUIRE(( received == vector< int >{ 10 } ));
+        REQUIRE( async->dropped() == 6 );
+        REQUIRE( async->coalesced() == 3 );
+        REQUIRE( async->pump() == 0 );
+        REQUIRE( received.size() == 1 );
+    }
+}
@@ -0,0 +1,154 @@
+#include "catch.hpp"
+#include "libnodes/CoroutineNode.h"
+
+#ifdef LIBNODES_COROUTINES
+
+#include "libnodes/Graph.h"
+#include "libnodes/Executor.h"
+#include "libnodes/operators.h"
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace nodes;
+using namespace std;
+using namespace Catch;
+using namespace nodes::operators;
+
+
+//! Sums one int from each of its inlets, like ThreeInts_IONode in
+//! test_nodes.cpp, without keeping track of which inlet is next.
+class ThreeInts_CoroutineNode : public CoroutineNode< UniformInlets< int, 3 >, Outlets< int > > {
+public:
+    node_task body() override {
+        while ( true ) {
+            int sum = co_await in< 0 >();
+            sum += co_await in< 1 >();
+            sum += co_await in< 2 >();
+            if ( sum < 0 ) throw runtime_error( "negative" );
+            out< 0 >().update( sum );
+        }
+    }
+};
+
+//! Joins pairs of strings, taking ownership of them.
+class Join_CoroutineNode : public CoroutineNode< Inlets< string, string >, Outlets< string > > {
+public:
+    node_task body() override {
+        while ( true ) {
+            string a = co_await in< 0 >();
+            string b = co_await in< 1 >();
+            if ( a.empty() ) co_return;
+            out< 0 >().update( std::move( a ) + b );
+        }
+    }
+};
+
+SCENARIO( "With a coroutine node", "[nodes]" ) {
+    ThreeInts_CoroutineNode node;
+    Inlet< int > sink;
+    vector< int > sums;
+    sink.onReceive( [&]( const int &i ) { sums.push_back( i ); } );
+    node.out< 0 >() >> sink;
+
+    THEN( "it waits for each inlet in turn" ) {
+        node.in< 0 >().receive( 1 );
+        node.in< 1 >().receive( 10 );
+        REQUIRE( sums.empty() );
+        node.in< 2 >().receive( 100 );
+        REQUIRE(( sums == vector< int >{ 111 } ));
+    }
+
+    THEN( "values that arrive early are kept until the body asks for them" ) {
+        node.in< 2 >().receive( 100 );
+        node.in< 1 >().receive( 10 );
+        node.in< 1 >().receive( 20 );
+        node.in< 0 >().receive( 1 );
+        REQUIRE(( sums == vector< int >{ 111 } ));
+        node.in< 2 >().receive( 200 );
+        node.in< 0 >().receive( 2 );
+        REQUIRE(( sums == vector< int >{ 111, 222 } ));
+    }
+
+    THEN( "what the body throws reaches the sender and ends the body" ) {
+        node.in< 0 >().receive( -1 );
+        node.in< 1 >().receive( -1 );
+        REQUIRE_THROWS_AS( node.in< 2 >().receive( -1 ), runtime_error );
+        REQUIRE( node.finished() );
+        node.in< 0 >().receive( 1 );
+        REQUIRE( sums.empty() );
+    }
+
+    THEN( "branches of an executor fan-out are handed to the body one at a time" ) {
+        Executor executor( 4 );
+        Outlet< int > source;
+        node.inlets().each( [&]( auto &in ) { source >> in; } );
+        for ( int i = 1; i <= 100; ++i ) {
+            executor.run( [&] { source.update( i ); } );
+        }
+        REQUIRE( sums.size() == 100 );
+        bool all = true;
+        for ( int i = 0; i < 100; ++i ) all = all && sums[ i ] == 3 * ( i + 1 );
+        REQUIRE( all );
+    }
+}
+
+SCENARIO( "With coroutine nodes in a graph", "[nodes]" ) {
+    Graph graph;
+
+    THEN( "their frames come from the graph's arena" ) {
+        std::size_t used, blocks;
+        {
+            ThreeInts_CoroutineNode a;
+            graph.add( a );
+            REQUIRE( a.framePool().get() == &graph.memory() );
+            used = graph.memory().used();
+            a.start();
+            REQUIRE( graph.memory().used() > used );
+            blocks = graph.memory().blocks();
+        }
+        REQUIRE( graph.memory().used() == used );
+
+        ThreeInts_CoroutineNode b;
+        graph.add( b );
+        used = graph.memory().used();
+        b.start();
+        REQUIRE( graph.memory().used() > used );
+        REQUIRE( graph.memory().blocks() == blocks );
+    }
+
+    THEN( "frames outlive the graph that pooled them" ) {
+        unique_ptr< ThreeInts_CoroutineNode > node( new ThreeInts_CoroutineNode );
+        {
+            Graph scoped;
+            scoped.add( *node );
+            node->start();
+        }
+        node->in< 0 >().receive( 1 );
+        node.reset();
+    }
+
+    THEN( "rvalues are moved into the body, which can return" ) {
+        Join_CoroutineNode join;
+        graph.add( join );
+        Inlet< string > sink;
+        string joined;
+        sink.onReceive( [&]( string s ) { joined = std::move( s ); } );
+        join.out< 0 >() >> sink;
+
+        string a( 100, 'a' );
+        a.reserve( 200 );
+        auto data = a.data();
+        join.in< 0 >().receive( std::move( a ) );
+        join.in< 1 >().receive( string( "b" ) );
+        REQUIRE( joined.size() == 101 );
+        REQUIRE( joined.data() == data );
+
+        join.in< 0 >().receive( string() );
+        join.in< 1 >().receive( string( "c" ) );
+        REQUIRE( join.finished() );
+    }
+}
+
+#endif
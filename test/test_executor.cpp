@@ -0,0 +1,208 @@
+#include "catch.hpp"
+#include "libnodes/Node.h"
+#include "libnodes/operators.h"
+#include "libnodes/BundleNode.h"
+#include "libnodes/Executor.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace nodes;
+using namespace std;
+using namespace Catch;
+using namespace nodes::operators;
+
+
+//! Passes each received int on, and counts what it received.
+class Count_IONode : public Node< Inlets< int >, Outlets< int > > {
+public:
+    Count_IONode() {
+        in< 0 >().onReceive( [this]( const int &i ) {
+            ++received;
+            {
+                lock_guard< mutex > lock( threadsMutex );
+                threads.insert( this_thread::get_id() );
+            }
+            out< 0 >().update( i );
+        } );
+    }
+
+    atomic< int > received{ 0 };
+    static mutex threadsMutex;
+    static set< thread::id > threads;
+};
+
+mutex Count_IONode::threadsMutex;
+set< thread::id > Count_IONode::threads;
+
+SCENARIO( "With an executor", "[nodes]" ) {
+    Executor executor( 4 );
+    Outlet< int > source;
+    vector< unique_ptr< Count_IONode > > branches;
+    for ( int i = 0; i < 64; ++i ) {
+        branches.emplace_back( new Count_IONode );
+        source >> branches.back()->in< 0 >();
+    }
+
+    THEN( "an update returns once every branch of the fan-out ran" ) {
+        for ( int round = 1; round <= 100; ++round ) {
+            executor.run( [&] { source.update( round ); } );
+            for ( auto &b : branches ) REQUIRE( b->received == round );
+        }
+        REQUIRE( executor.size() == 4 );
+    }
+
+    THEN( "fan-outs nest" ) {
+        vector< unique_ptr< Count_IONode > > leaves;
+        for ( auto &b : branches ) {
+            for ( int i = 0; i < 4; ++i ) {
+                leaves.emplace_back( new Count_IONode );
+                *b >> *leaves.back();
+            }
+        }
+
+        executor.run( [&] { source.update( 1 ); } );
+
+        int total = 0;
+        for ( auto &l : leaves ) total += l->received;
+        REQUIRE( total == 256 );
+    }
+
+    THEN( "branches join at a bundle node" ) {
+        Count_IONode left, right;
+        BundleNode< int, int > join;
+        vector< bundle< int, int > > bundles;
+        Inlet< bundle< int, int > > sink;
+        sink.onReceive( [&]( const bundle< int, int > &b ) { bundles.push_back( b ); } );
+        Outlet< int > fork;
+        fork >> left.in< 0 >();
+        fork >> right.in< 0 >();
+        left >> join.in< 0 >();
+        right >> join.in< 1 >();
+        join.out< 0 >() >> sink;
+
+        for ( int round = 0; round < 1000; ++round ) {
+            executor.run( [&] { fork.update( round ); } );
+        }
+
+        REQUIRE( bundles.size() == 1000 );
+        REQUIRE( get< 0 >( bundles[ 999 ] ) == 999 );
+        REQUIRE( get< 1 >( bundles[ 999 ] ) == 999 );
+    }
+
+    THEN( "exceptions thrown by a branch reach the update" ) {
+        Inlet< int > throwing;
+        throwing.onReceive( []( const int & ) { throw runtime_error( "branch failed" ); } );
+        source.connect( throwing );
+
+        REQUIRE_THROWS_AS( executor.run( [&] { source.update( 1 ); } ), runtime_error );
+        for ( auto &b : branches ) REQUIRE( b->received == 1 );
+    }
+
+    THEN( "without an executor updates stay on the calling thread" ) {
+        Count_IONode::threads.clear();
+        source.update( 1 );
+        REQUIRE( Count_IONode::threads.size() == 1 );
+        REQUIRE( Executor::current() == nullptr );
+        REQUIRE_FALSE( dispatch_hooks::engaged() );
+    }
+
+    THEN( "waiting for a fork only runs jobs of that fork" ) {
+        Executor single( 1 );
+        atomic< bool > release{ false };
+        executor_job blocker{ []( executor_job &job ) {
+            while ( ! static_cast< atomic< bool > * >( job.function )->load() ) this_thread::yield();
+        }, &release, nullptr, nullptr };
+        single.submit( blocker );
+        thread::id ranOn;
+        atomic< bool > ran{ false };
+        executor_job other{ []( executor_job &job ) {
+            *static_cast< thread::id * >( job.item ) = this_thread::get_id();
+            static_cast< atomic< bool > * >( job.function )->store( true );
+        }, &ran, &ranOn, nullptr };
+        single.submit( other );
+
+        vector< int > items{ 1, 2, 3 };
+        atomic< int > sum{ 0 };
+        single.forEach( items.begin(), items.end(), [&]( int i ) { sum += i; } );
+        REQUIRE( sum == 6 );
+        REQUIRE_FALSE( ran );
+
+        release = true;
+        while ( ! ran ) this_thread::yield();
+        REQUIRE( ranOn != this_thread::get_id() );
+    }
+}
+
+SCENARIO( "With a parallel outlet", "[nodes]" ) {
+    Executor executor( 4 );
+    Outlet< int > source;
+    vector< unique_ptr< Count_IONode > > branches;
+    for ( int i = 0; i < 64; ++i ) {
+        branches.emplace_back( new Count_IONode );
+        source >> branches.back()->in< 0 >();
+    }
+    source.setParallel( &executor, 16, 8 );
+
+    THEN( "updates fan out without a current executor" ) {
+        for ( int round = 1; round <= 100; ++round ) {
+            source.update( round );
+            for ( auto &b : branches ) REQUIRE( b->received == round );
+        }
+        REQUIRE( Executor::current() == nullptr );
+    }
+
+    THEN( "small fan-outs stay on the updating thread" ) {
+        Outlet< int > small;
+        small.setParallel( &executor, 16 );
+        for ( int i = 0; i < 4; ++i ) small >> branches[ i ]->in< 0 >();
+        Count_IONode::threads.clear();
+        executor.run( [&] { small.update( 1 ); } );
+        REQUIRE( Count_IONode::threads.size() == 1 );
+        REQUIRE( *Count_IONode::threads.begin() == this_thread::get_id() );
+    }
+
+    THEN( "an async update returns before the inlets receive" ) {
+        atomic< bool > go{ false };
+        atomic< int > received{ 0 };
+        Outlet< int > gated;
+        gated.setParallel( &executor, 2, 4 );
+        vector< unique_ptr< Inlet< int > > > inlets;
+        for ( int i = 0; i < 32; ++i ) {
+            inlets.emplace_back( new Inlet< int > );
+            inlets.back()->onReceive( [&]( const int &v ) {
+                while ( ! go ) this_thread::yield();
+                received += v;
+            } );
+            gated >> *inlets.back();
+        }
+
+        auto token = gated.update_async( 2 );
+        REQUIRE( received == 0 );
+        go = true;
+        token.wait();
+        REQUIRE( token.done() );
+        REQUIRE( received == 64 );
+    }
+
+    THEN( "async updates report exceptions to the token" ) {
+        Inlet< int > throwing;
+        throwing.onReceive( []( const int & ) { throw runtime_error( "branch failed" ); } );
+        source.connect( throwing );
+
+        auto token = source.update_async( 1 );
+        REQUIRE_THROWS_AS( token.wait(), runtime_error );
+        for ( auto &b : branches ) REQUIRE( b->received == 1 );
+    }
+
+    THEN( "ranges can be split into chunks" ) {
+        vector< int > values( 1000, 1 );
+        atomic< int > sum{ 0 };
+        executor.forEach( values.begin(), values.end(), [&]( int &v ) { sum += v; }, 64 );
+        REQUIRE( sum == 1000 );
+    }
+}
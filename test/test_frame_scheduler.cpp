@@ -0,0 +1,123 @@
+#include "catch.hpp"
+#include "libnodes/Node.h"
+#include "libnodes/operators.h"
+#include "libnodes/Graph.h"
+#include "libnodes/ValueNode.h"
+#include "libnodes/frame_scheduler.h"
+#include <string>
+#include <vector>
+
+using namespace nodes;
+using namespace std;
+using namespace Catch;
+using namespace nodes::operators;
+
+
+//! Passes each received int on, and logs its label.
+class Log_IONode : public Node< Inlets< int >, Outlets< int > > {
+public:
+    Log_IONode( vector< string > &log, const string &label ) : node_type( label ) {
+        in< 0 >().onReceive( [this, &log]( const int &i ) {
+            log.push_back( this->label() + " " + to_string( i ) );
+            out< 0 >().update( i );
+        } );
+    }
+};
+
+SCENARIO( "With a frame scheduler", "[nodes]" ) {
+    vector< string > log;
+    ValueNodei input( 0 );
+    Log_IONode b( log, "b" ), c( log, "c" ), d( log, "d" ), e( log, "e" );
+    input >> b >> d;
+    input >> c >> d;
+    d >> e;
+
+    Graph graph;
+    graph.add( e ); graph.add( d ); graph.add( c ); graph.add( b );
+    frame_scheduler frame( graph );
+
+    THEN( "without one every update propagates" ) {
+        input.set( 1 );
+        input.set( 2 );
+        input.set( 3 );
+        REQUIRE( log.size() == 18 );
+    }
+
+    THEN( "the updates of a frame propagate once per outlet, in order" ) {
+        {
+            frame_scheduler::scope scope( frame );
+            input.set( 1 );
+            input.set( 2 );
+            input.set( 3 );
+            REQUIRE( log.empty() );
+            REQUIRE( frame.size() == 1 );
+        }
+        frame.flush();
+
+        REQUIRE(( log == vector< string >{ "b 3", "c 3", "d 3", "d 3", "e 3" } ));
+        REQUIRE( frame.size() == 0 );
+        REQUIRE( frame.scheduled() == 5 );
+        REQUIRE( frame.coalesced() == 3 );
+        REQUIRE( frame.delivered() == 5 );
+
+        frame.resetCounters();
+        frame.flush();
+        REQUIRE( log.size() == 5 );
+        REQUIRE( frame.delivered() == 0 );
+    }
+
+    THEN( "a scheduler can be set on nodes" ) {
+        input.setFrameScheduler( &frame );
+        input.set( 1 );
+        input.set( 2 );
+        REQUIRE( log.empty() );
+        REQUIRE( input.out< 0 >().getFrameScheduler() == &frame );
+
+        frame.flush();
+        REQUIRE( log.size() == 5 );
+        REQUIRE( log.back() == "e 2" );
+    }
+
+    THEN( "batches are held back as their last value" ) {
+        frame_scheduler::scope scope( frame );
+        vector< int > batch{ 4, 5, 6 };
+        input.out< 0 >().update_batch( batch );
+        frame.flush();
+
+        REQUIRE( log.back() == "e 6" );
+        REQUIRE( frame.coalesced() == 3 );
+    }
+
+    THEN( "updates that loop back wait for the next flush" ) {
+        int loops = 0;
+        Inlet< int > back;
+        back.onReceive( [&]( const int &i ) {
+            if ( ++loops < 3 ) b.in< 0 >().receive( i + 1 );
+        } );
+        e.out< 0 >() >> back;
+
+        frame_scheduler::scope scope( frame );
+        input.set( 1 );
+        frame.flush();
+        REQUIRE(( log == vector< string >{ "b 1", "c 1", "d 1", "d 1", "e 1", "b 2" } ));
+        REQUIRE( frame.size() == 1 );
+
+        frame.flush();
+        REQUIRE(( vector< string >( log.begin() + 6, log.end() ) == vector< string >{ "d 2", "e 2", "b 3" } ));
+        frame.flush();
+        REQUIRE( log.back() == "e 3" );
+        REQUIRE( frame.size() == 0 );
+    }
+
+    THEN( "outlets destroyed while held back are dropped" ) {
+        {
+            Outlet< int > temporary;
+            temporary.setFrameScheduler( &frame );
+            temporary.update( 1 );
+            REQUIRE( frame.size() == 1 );
+        }
+        REQUIRE( frame.size() == 0 );
+        frame.flush();
+        REQUIRE( frame.delivered() == 0 );
+    }
+}
@@ -0,0 +1,514 @@
+#include "catch.hpp"
+#include "libnodes/Node.h"
+#include "libnodes/operators.h"
+#include "libnodes/Graph.h"
+#include "libnodes/ValueNode.h"
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace nodes;
+using namespace std;
+using namespace Catch;
+using namespace nodes::operators;
+
+
+//! Adds up its inlets once they have all settled.
+class Sum_IONode : public Node< UnsafeInlets< int, int >, Outlets< int > >, public Evaluable {
+public:
+    Sum_IONode( const string &label ) : node_type( label ) {
+        inlets().each_with_index( [&]( auto &inlet, auto i ) {
+            inlet.onReceive( [&, i]( const int &v ) {
+                mValues[ i ] = v;
+                invalidate();
+            } );
+        } );
+    }
+
+    void evaluate() override {
+        evaluations.push_back( mValues[ 0 ] + mValues[ 1 ] );
+        out< 0 >().update( mValues[ 0 ] + mValues[ 1 ] );
+    }
+
+    vector< int > evaluations;
+
+private:
+    int mValues[ 2 ] = { 0, 0 };
+};
+
+SCENARIO( "With a diamond shaped graph", "[nodes]" ) {
+    Sum_IONode a( "a" ), b( "b" ), c( "c" ), d( "d" );
+    a >> b.in< 0 >();
+    a >> c.in< 0 >();
+    b >> d.in< 0 >();
+    c >> d.in< 1 >();
+
+    THEN( "without a graph the bottom node sees every intermediate state" ) {
+        a.in< 0 >().receive( 1 );
+
+        REQUIRE(( d.evaluations == vector< int >{ 1, 2 } ));
+    }
+
+    THEN( "a tick evaluates each node once, after its inputs settled" ) {
+        Graph graph;
+        for ( auto n : { &d, &c, &b, &a } ) graph.add( *n );
+
+        a.in< 0 >().receive( 1 );
+        REQUIRE( a.evaluations.empty() );
+
+        graph.tick();
+
+        REQUIRE(( a.evaluations == vector< int >{ 1 } ));
+        REQUIRE(( b.evaluations == vector< int >{ 1 } ));
+        REQUIRE(( c.evaluations == vector< int >{ 1 } ));
+        REQUIRE(( d.evaluations == vector< int >{ 2 } ));
+
+        graph.tick();
+        REQUIRE( d.evaluations.size() == 1 );
+    }
+
+    THEN( "the order is sorted again when the topology changes" ) {
+        Graph graph;
+        Sum_IONode e( "e" );
+        for ( auto n : { &e, &d, &c, &b, &a } ) graph.add( *n );
+
+        REQUIRE(( graph.order() == vector< uint64_t >{ e.id(), a.id(), b.id(), c.id(), d.id() } ));
+
+        d >> e.in< 0 >();
+        auto order = graph.order();
+        REQUIRE( order.back() == e.id() );
+
+        a.in< 0 >().receive( 1 );
+        graph.tick();
+        REQUIRE(( e.evaluations == vector< int >{ 2 } ));
+
+        graph.remove( e );
+        REQUIRE( graph.size() == 4 );
+        REQUIRE_FALSE( graph.contains( e ) );
+    }
+
+    THEN( "a cycle does not stop the tick" ) {
+        Graph graph;
+        for ( auto n : { &a, &b, &c, &d } ) graph.add( *n );
+        d >> a.in< 1 >();
+
+        a.in< 0 >().receive( 1 );
+        graph.tick();
+        REQUIRE( d.evaluations.size() == 1 );
+
+        // d fed back into a, which is evaluated in the next tick
+        graph.tick();
+        REQUIRE(( a.evaluations == vector< int >{ 1, 3 } ));
+    }
+
+    THEN( "nodes downstream of a cycle are ordered after it" ) {
+        Sum_IONode e( "e" );
+        c >> b.in< 1 >();
+        b >> c.in< 1 >();
+        b.out< 0 >().disconnect( d.in< 0 >() );
+        d >> e.in< 0 >();
+        Graph graph;
+        for ( auto n : { &e, &d, &c, &b, &a } ) graph.add( *n );
+
+        // b and c feed each other, and c feeds d
+        REQUIRE( graph.rank( a ) == 0 );
+        REQUIRE( graph.rank( c ) == 1 );
+        REQUIRE( graph.rank( b ) == 2 );
+        REQUIRE( graph.rank( d ) == 3 );
+        REQUIRE( graph.rank( e ) == 4 );
+
+        a.in< 0 >().receive( 1 );
+        graph.tick();
+        REQUIRE(( e.evaluations == vector< int >{ 1 } ));
+    }
+
+    THEN( "destroying a node removes it from its graph" ) {
+        Graph graph;
+        {
+            Sum_IONode e( "e" );
+            graph.add( e );
+            REQUIRE( graph.contains( e ) );
+        }
+        REQUIRE( graph.size() == 0 );
+    }
+
+    THEN( "a node that reuses the id of one that was not removed is added" ) {
+        Graph graph;
+        uint64_t id;
+        {
+            Node< Inlets< int >, Outlets< int > > e( "e" );
+            graph.add( e );
+            id = e.id();
+        }
+        Node< Inlets< int >, Outlets< int > > f( "f" );
+        REQUIRE( f.id() == id );
+        REQUIRE_FALSE( graph.contains( f ) );
+
+        graph.add( f );
+        REQUIRE( graph.contains( f ) );
+        REQUIRE( graph.size() == 1 );
+    }
+}
+
+//! Doubles the latest value it received.
+class Double_IONode : public Node< UnsafeInlets< int >, Outlets< int > >, public Evaluable {
+public:
+    Double_IONode( const string &label ) : node_type( label ) {
+        latch( in< 0 >(), mValue );
+    }
+
+    void evaluate() override {
+        ++evaluations;
+        out< 0 >().update( mValue * 2 );
+    }
+
+    int evaluations = 0;
+
+private:
+    int mValue = 0;
+};
+
+//! the edges of a snapshot as ( from label, outlet, to label, inlet )
+static vector< tuple< string, uint32_t, string, uint32_t > > edgesOf( const adjacency_snapshot &snapshot ) {
+    vector< tuple< string, uint32_t, string, uint32_t > > edges;
+    for ( size_t i = 0; i < snapshot.size(); ++i ) {
+        for ( auto &e : snapshot.edges( i ) ) {
+            edges.emplace_back( snapshot.node( i ).getLabel(), e.outlet, snapshot.node( e.node ).getLabel(), e.inlet );
+        }
+    }
+    sort( edges.begin(), edges.end() );
+    return edges;
+}
+
+SCENARIO( "With an adjacency snapshot", "[nodes]" ) {
+    Sum_IONode a( "a" ), b( "b" ), c( "c" ), d( "d" );
+    a >> b.in< 0 >();
+    a >> c.in< 1 >();
+    b >> d.in< 0 >();
+    c >> d.in< 1 >();
+
+    Graph graph;
+    for ( auto n : { &a, &b, &c, &d } ) graph.add( *n );
+
+    typedef vector< tuple< string, uint32_t, string, uint32_t > > edges;
+
+    THEN( "it holds the connections between the nodes in rows" ) {
+        auto &snapshot = graph.adjacency();
+        REQUIRE( snapshot.size() == 4 );
+        REQUIRE( &snapshot.node( 0 ) == static_cast< NodeConcept * >( &a ) );
+        REQUIRE(( vector< size_t >( snapshot.offsets().begin(), snapshot.offsets().end() ) == vector< size_t >{ 0, 2, 3, 4, 4 } ));
+        REQUIRE(( edgesOf( snapshot ) == edges{
+                { "a", 0, "b", 0 }, { "a", 0, "c", 1 }, { "b", 0, "d", 0 }, { "c", 0, "d", 1 } } ));
+    }
+
+    THEN( "connections to nodes outside the graph are left out" ) {
+        Sum_IONode e( "e" );
+        d >> e.in< 0 >();
+        REQUIRE( graph.adjacency().edges().size() == 4 );
+
+        graph.add( e );
+        REQUIRE( graph.adjacency().edges( 3 ).size() == 1 );
+    }
+
+    THEN( "it follows connections and disconnections" ) {
+        auto &snapshot = graph.adjacency();
+        auto handle = b.out< 0 >().connect( c.in< 0 >() );
+        d >> a.in< 1 >();
+        REQUIRE( graph.adjacency().version() == graph.topology().version() );
+        REQUIRE(( edgesOf( snapshot ) == edges{
+                { "a", 0, "b", 0 }, { "a", 0, "c", 1 }, { "b", 0, "c", 0 }, { "b", 0, "d", 0 },
+                { "c", 0, "d", 1 }, { "d", 0, "a", 1 } } ));
+
+        handle.disconnect();
+        a.out< 0 >().disconnect( b.in< 0 >() );
+        REQUIRE(( edgesOf( graph.adjacency() ) == edges{
+                { "a", 0, "c", 1 }, { "b", 0, "d", 0 }, { "c", 0, "d", 1 }, { "d", 0, "a", 1 } } ));
+    }
+
+    THEN( "it catches up after more changes than it can follow" ) {
+        graph.adjacency();
+        for ( size_t i = 0; i < topology_log::capacity; ++i ) {
+            b.out< 0 >().connect( c.in< 0 >() ).disconnect();
+        }
+        c.out< 0 >().disconnect();
+        REQUIRE(( edgesOf( graph.adjacency() ) == edges{ { "a", 0, "b", 0 }, { "a", 0, "c", 1 }, { "b", 0, "d", 0 } } ));
+    }
+
+    THEN( "connections outside the graph leave it as it is" ) {
+        auto version = graph.adjacency().version();
+        Sum_IONode e( "e" ), f( "f" );
+        e >> f.in< 0 >();
+        e.out< 0 >().disconnect();
+        REQUIRE( graph.topology().version() == version );
+        REQUIRE( graph.adjacency().version() == version );
+    }
+
+    THEN( "it follows nodes being removed" ) {
+        graph.remove( b );
+        REQUIRE( graph.adjacency().size() == 3 );
+        REQUIRE(( edgesOf( graph.adjacency() ) == edges{ { "a", 0, "c", 1 }, { "c", 0, "d", 1 } } ));
+    }
+}
+
+SCENARIO( "With a lazily evaluated graph", "[nodes]" ) {
+    ValueNodei source( 1 );
+    Double_IONode visible( "visible" ), shown( "shown" ), hidden( "hidden" );
+    int result = 0;
+    Inlet< int, singlethread_policy > sink;
+    sink.onReceive( [&]( const int &i ) { result = i; } );
+
+    source >> visible >> shown;
+    source >> hidden;
+    shown.out< 0 >() >> sink;
+
+    Graph graph;
+    for ( auto n : { &visible, &shown, &hidden } ) graph.add( *n );
+    graph.add( source );
+
+    THEN( "changes only mark what is downstream stale" ) {
+        source = 2;
+
+        REQUIRE( source.get() == 2 );
+        REQUIRE( result == 0 );
+        REQUIRE( graph.isStale( source ) );
+        REQUIRE( graph.isStale( shown ) );
+        REQUIRE( graph.isStale( hidden ) );
+    }
+
+    THEN( "pulling a node only evaluates what it depends on" ) {
+        source = 2;
+        graph.pull( shown );
+
+        REQUIRE( result == 8 );
+        REQUIRE( visible.evaluations == 1 );
+        REQUIRE( shown.evaluations == 1 );
+        REQUIRE( hidden.evaluations == 0 );
+        REQUIRE_FALSE( graph.isStale( shown ) );
+        REQUIRE( graph.isStale( hidden ) );
+
+        graph.pull( shown );
+        REQUIRE( shown.evaluations == 1 );
+
+        graph.pull( hidden );
+        REQUIRE( hidden.evaluations == 1 );
+        REQUIRE( visible.evaluations == 1 );
+    }
+
+    THEN( "setting a value node to the value it last emitted changes nothing" ) {
+        source = 2;
+        graph.pull( shown );
+        graph.pull( hidden );
+
+        source = 2;
+        REQUIRE_FALSE( graph.isStale( shown ) );
+
+        source = 3;
+        source = 2;
+        graph.pull( shown );
+        REQUIRE( shown.evaluations == 1 );
+    }
+
+    THEN( "a graph that was only ticked so far can be pulled" ) {
+        source = 2;
+        graph.tick();
+        REQUIRE( shown.evaluations == 1 );
+
+        source = 3;
+        REQUIRE( graph.isStale( shown ) );
+        REQUIRE( graph.isStale( visible ) );
+        graph.pull( shown );
+        REQUIRE( result == 12 );
+        REQUIRE( graph.isStale( hidden ) );
+    }
+}
+
+//! Runs a hook when evaluated, then passes on the latest value it received.
+class Hook_IONode : public Node< UnsafeInlets< int >, Outlets< int > >, public Evaluable {
+public:
+    Hook_IONode( const string &label ) : node_type( label ) {
+        latch( in< 0 >(), mValue );
+    }
+
+    void evaluate() override {
+        ++evaluations;
+        if ( hook ) hook();
+        out< 0 >().update( mValue );
+    }
+
+    function< void() > hook;
+    int evaluations = 0;
+
+private:
+    int mValue = 0;
+};
+
+SCENARIO( "With nodes changing their graph while it evaluates", "[nodes]" ) {
+    Outlet< int > source;
+    Hook_IONode a( "a" ), b( "b" ), c( "c" );
+    auto d = make_unique< Hook_IONode >( "d" );
+    source >> a.in< 0 >();
+    source >> b.in< 0 >();
+    source >> c.in< 0 >();
+    source >> d->in< 0 >();
+
+    Graph graph;
+    for ( auto n : { &a, &b, &c, d.get() } ) graph.add( *n );
+
+    THEN( "a node removed during a tick is not evaluated" ) {
+        a.hook = [&] { graph.remove( b ); };
+
+        source.update( 1 );
+        graph.tick();
+
+        REQUIRE( a.evaluations == 1 );
+        REQUIRE( b.evaluations == 0 );
+        REQUIRE( c.evaluations == 1 );
+        REQUIRE( d->evaluations == 1 );
+        REQUIRE( graph.size() == 3 );
+        REQUIRE_FALSE( graph.contains( b ) );
+
+        source.update( 2 );
+        graph.tick();
+        REQUIRE( c.evaluations == 2 );
+        REQUIRE( d->evaluations == 2 );
+    }
+
+    THEN( "a node destroyed during a tick leaves it" ) {
+        a.hook = [&] { d.reset(); };
+
+        source.update( 1 );
+        graph.tick();
+
+        REQUIRE( c.evaluations == 1 );
+        REQUIRE( graph.size() == 3 );
+
+        source.update( 2 );
+        graph.tick();
+        REQUIRE( a.evaluations == 2 );
+        REQUIRE( c.evaluations == 2 );
+    }
+
+    THEN( "nodes added and connected during a tick are evaluated from the next one on" ) {
+        Hook_IONode e( "e" );
+        a.hook = [&] {
+            graph.remove( b );
+            graph.add( e );
+            c >> e.in< 0 >();
+            a.hook = nullptr;
+        };
+
+        source.update( 1 );
+        graph.tick();
+        REQUIRE( e.evaluations == 0 );
+        REQUIRE( graph.size() == 4 );
+
+        graph.tick();
+        REQUIRE( e.evaluations == 1 );
+        REQUIRE( graph.rank( e ) > graph.rank( c ) );
+    }
+
+    THEN( "a node removed while being pulled is not evaluated" ) {
+        b >> d->in< 0 >();
+        c >> d->in< 0 >();
+        b.hook = [&] { graph.remove( c ); };
+
+        source.update( 1 );
+        graph.pull( *d );
+
+        REQUIRE( b.evaluations == 1 );
+        REQUIRE( c.evaluations == 0 );
+        REQUIRE( d->evaluations == 1 );
+        REQUIRE_FALSE( graph.contains( c ) );
+        REQUIRE_FALSE( graph.isStale( *d ) );
+    }
+}
+
+SCENARIO( "With nodes created by a graph", "[nodes]" ) {
+    Outlet< int > source;
+    Inlet< int > sink;
+    vector< int > received;
+    sink.onReceive( [&]( const int &i ) { received.push_back( i ); } );
+
+    THEN( "they live and allocate in its arena until it is destroyed" ) {
+        {
+            Graph graph;
+            auto &a = graph.create< Sum_IONode >( "a" );
+            auto &b = graph.create< Sum_IONode >( "b" );
+            REQUIRE( graph.size() == 2 );
+            REQUIRE( a.getLabel() == "a" );
+
+            auto used = graph.memory().used();
+            source >> a.in< 0 >();
+            REQUIRE( graph.memory().used() == used );
+            a >> b.in< 1 >();
+            REQUIRE( graph.memory().used() > used );
+            b.out< 0 >() >> sink;
+
+            source.update( 3 );
+            graph.tick();
+            REQUIRE(( received == vector< int >{ 3 } ));
+            REQUIRE( graph.memory().blocks() == 1 );
+        }
+        REQUIRE_FALSE( source.isConnected() );
+        REQUIRE_FALSE( sink.isConnected() );
+        source.update( 4 );
+        REQUIRE( received.size() == 1 );
+    }
+
+    THEN( "large graphs stay in a few blocks" ) {
+        Graph graph;
+        Sum_IONode *previous = nullptr;
+        for ( int i = 0; i < 1000; ++i ) {
+            auto &n = graph.create< Sum_IONode >( "" );
+            if ( previous ) {
+                *previous >> n.in< 0 >();
+            } else {
+                source >> n.in< 0 >();
+            }
+            previous = &n;
+        }
+        previous->out< 0 >() >> sink;
+        graph.order();
+        REQUIRE( graph.memory().blocks() < 100 );
+
+        source.update( 1 );
+        graph.tick();
+        REQUIRE(( received == vector< int >{ 1 } ));
+    }
+}
+
+SCENARIO( "With an arena", "[nodes]" ) {
+    arena a( 1024 );
+
+    THEN( "memory given back is reused for the same size" ) {
+        auto p = a.allocate( 40 );
+        a.deallocate( p, 40 );
+        REQUIRE( a.allocate( 33 ) == p );
+        REQUIRE( a.used() == 33 );
+        REQUIRE( reinterpret_cast< uintptr_t >( a.allocate( 8 ) ) % alignof( max_align_t ) == 0 );
+        REQUIRE( reinterpret_cast< uintptr_t >( a.allocate( 8, 64 ) ) % 64 == 0 );
+    }
+
+    THEN( "large allocations are released with the rest" ) {
+        auto large = a.allocate( 100000 );
+        auto other = a.allocate( 100000 );
+        a.deallocate( large, 100000 );
+        REQUIRE( a.used() == 100000 );
+        a.allocate( 16 );
+        REQUIRE( a.blocks() == 1 );
+        (void) other;
+        a.release();
+        REQUIRE( a.used() == 0 );
+        REQUIRE( a.blocks() == 0 );
+    }
+
+    THEN( "containers can allocate from it" ) {
+        vector< int, resource_allocator< int > > v( ( resource_allocator< int >( &a ) ) );
+        for ( int i = 0; i < 100; ++i ) v.push_back( i );
+        REQUIRE( a.used() >= 100 * sizeof( int ) );
+        REQUIRE( memory_resource::current() == memory_resource::heap() );
+    }
+}
@@ -1,14 +1,43 @@
 #include "catch.hpp"
+#include "counting_new.h"
 #include "libnodes/Node.h"
 #include "libnodes/operators.h"
 #include "libnodes/ImplicitConversionNode.h"
+#include "libnodes/ValueNode.h"
+#include "libnodes/BundleNode.h"
+#include "libnodes/Traversal.h"
+#include "libnodes/Executor.h"
 #include <iostream>
+#include <atomic>
+#include <thread>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <set>
 
 using namespace nodes;
 using namespace std;
 using namespace Catch;
 using namespace nodes::operators;
 
+//! Counts the allocations made from it that are still live.
+struct counting_resource : memory_resource {
+    void *allocate( std::size_t bytes, std::size_t alignment ) override
+    {
+        ++live;
+        ++total;
+        return memory_resource::heap()->allocate( bytes, alignment );
+    }
+    void deallocate( void *p, std::size_t bytes, std::size_t alignment ) override
+    {
+        --live;
+        memory_resource::heap()->deallocate( p, bytes, alignment );
+    }
+    std::atomic< int > live{ 0 };
+    std::atomic< int > total{ 0 };
+};
+
 class Int_IONode : public Node< Inlets< int >, Outlets< int > > {
 public:
     Int_IONode( const string &label ) : node_type( label ) {
@@ -25,7 +54,7 @@ SCENARIO( "With a single node", "[nodes]" ) {
     Int_IONode n( "a label" );
 
     THEN( "it has a numeric id" ) {
-        REQUIRE( n.id() >= 0 );
+        REQUIRE( n.id() < NodeBase::ids().capacity() );
     }
 
     THEN( "it has a label with getters and setters" ) {
@@ -43,7 +72,7 @@ SCENARIO( "With a node with no inlets", "[nodes]" ) {
     THEN( "it compiles" ) {}
 
     THEN( "it has a numeric id" ) {
-        REQUIRE( n.id() >= 0 );
+        REQUIRE( n.id() < NodeBase::ids().capacity() );
     }
 }
 
@@ -54,7 +83,7 @@ SCENARIO( "With a node with no outlets", "[nodes]" ) {
     THEN( "it compiles" ) {}
 
     THEN( "it has a numeric id" ) {
-        REQUIRE( n.id() >= 0 );
+        REQUIRE( n.id() < NodeBase::ids().capacity() );
     }
 }
 
@@ -121,6 +150,205 @@ SCENARIO( "With a single node with uniform inlets", "[nodes]" ) {
 
 }
 
+SCENARIO( "With single threaded nodes", "[nodes]" ) {
+    class UnsafeInt_IONode : public Node< UnsafeInlets< int >, Outlets< int > > {
+    public:
+        UnsafeInt_IONode( const string &label ) : node_type( label ) {
+            in< 0 >().onReceive( [&]( const int &i ) {
+                received.push_back( i );
+                this->out< 0 >().update( i );
+            } );
+        }
+
+        std::vector< int > received;
+    };
+
+    UnsafeInt_IONode n1( "node 1" );
+    UnsafeInt_IONode n2( "node 2" );
+    Int_IONode n3( "node 3" );
+    n1 >> n2 >> n3;
+
+    THEN( "the node uses the single threaded policy" ) {
+        REQUIRE( ( std::is_same< UnsafeInt_IONode::thread_policy, singlethread_policy >::value ) );
+        REQUIRE( ( std::is_same< Int_IONode::thread_policy, multithread_policy >::value ) );
+    }
+
+    THEN( "they propagate signals to nodes of either policy" ) {
+        n1.in< 0 >().receive( 1 );
+
+        REQUIRE( n2.received.size() == 1 );
+        REQUIRE( n3.received.size() == 1 );
+        REQUIRE( n3.received[ 0 ] == 1 );
+    }
+
+    THEN( "listeners can connect and disconnect while receiving" ) {
+        std::vector< int > late;
+        connection self;
+        self = n1.in< 0 >().onReceive( [&]( const int & ) {
+            self.disconnect();
+            n1.in< 0 >().onReceive( [&]( const int &j ) { late.push_back( j ); } );
+        } );
+
+        n1.in< 0 >().receive( 1 );
+        REQUIRE( late.empty() );
+
+        n1.in< 0 >().receive( 2 );
+        REQUIRE( late.size() == 1 );
+        REQUIRE( late[ 0 ] == 2 );
+        REQUIRE( n1.received.size() == 2 );
+    }
+}
+
+SCENARIO( "With nodes receiving from several threads", "[nodes]" ) {
+    Inlet< int > inlet;
+    std::atomic< int > sum{ 0 };
+    inlet.onReceive( [&]( const int &i ) { sum += i; } );
+
+    THEN( "listeners can be connected and disconnected while receiving" ) {
+        std::atomic< bool > done{ false };
+        std::atomic< int > churned{ 0 };
+        std::thread churn( [&] {
+            while ( ! done ) {
+                auto c = inlet.onReceive( [&]( const int &i ) { churned += i; } );
+                c.disconnect();
+            }
+        } );
+
+        std::vector< std::thread > senders;
+        for ( int t = 0; t < 4; ++t ) {
+            senders.emplace_back( [&] {
+                for ( int i = 0; i < 1000; ++i ) inlet.receive( 1 );
+            } );
+        }
+        for ( auto &t : senders ) t.join();
+        done = true;
+        churn.join();
+
+        REQUIRE( sum == 4000 );
+        REQUIRE( churned <= 4000 );
+    }
+
+    THEN( "disconnected slots are freed while other threads keep receiving" ) {
+        counting_resource resource;
+        std::unique_ptr< Inlet< int > > busy;
+        {
+            memory_resource::scope scope( resource );
+            busy.reset( new Inlet< int >() );
+        }
+        busy->onReceive( [&]( const int &i ) { sum += i; } );
+
+        std::atomic< bool > done{ false };
+        std::vector< std::thread > senders;
+        for ( int t = 0; t < 4; ++t ) {
+            senders.emplace_back( [&] {
+                while ( ! done ) busy->receive( 1 );
+            } );
+        }
+        int peak = 0;
+        for ( int i = 0; i < 20000; ++i ) {
+            busy->onReceive( []( const int & ) {} ).disconnect();
+            peak = std::max( peak, resource.live.load() );
+        }
+        done = true;
+        for ( auto &t : senders ) t.join();
+
+        REQUIRE( peak < 1000 );
+        busy.reset();
+        REQUIRE( resource.live == 0 );
+    }
+}
+
+SCENARIO( "With multithreaded signals", "[nodes][memory]" ) {
+    nod::signal< void( int ) > signal;
+    int sum = 0;
+    for ( int i = 0; i < 3; ++i ) signal.connect( [&sum]( int v ) { sum += v; } );
+    // the first emission on a thread registers it with the signals
+    signal( 0 );
+
+    THEN( "emitting allocates nothing" ) {
+        auto before = counting_new::threadCalls();
+        for ( int i = 0; i < 100; ++i ) signal( 1 );
+        auto calls = counting_new::threadCalls() - before;
+        REQUIRE( calls == 0 );
+        REQUIRE( sum == 300 );
+    }
+
+    THEN( "slots connect and disconnect slots from inside a slot without allocating" ) {
+        nod::connection added;
+        int emissions = 0, late = 0;
+        signal.connect( [&]( int ) {
+            if ( emissions % 3 == 0 ) added = signal.connect( [&late]( int v ) { late += v; } );
+            if ( emissions % 3 == 2 ) added.disconnect();
+            ++emissions;
+        } );
+        signal( 0 );
+
+        auto before = counting_new::threadCalls();
+        for ( int i = 0; i < 99; ++i ) signal( 1 );
+        auto calls = counting_new::threadCalls() - before;
+        REQUIRE( calls == 0 );
+        // connected slots are called from the next emission on, and
+        // disconnected ones not even by the rest of the current one
+        REQUIRE( late == 33 );
+        REQUIRE( signal.slot_count() == 5 );
+    }
+
+    THEN( "disconnecting does not wait for emissions in progress" ) {
+        std::mutex m;
+        std::atomic< bool > emitting{ false };
+        std::vector< nod::connection > subscribers;
+        for ( int i = 0; i < 1000; ++i ) subscribers.push_back( signal.connect( []( int ) {} ) );
+        signal.connect( [&]( int ) {
+            emitting = true;
+            std::lock_guard< std::mutex > lock( m );
+        } );
+
+        // the emission blocks on the lock held while disconnecting
+        std::unique_lock< std::mutex > lock( m );
+        std::thread emitter( [&] { signal( 1 ); } );
+        while ( ! emitting ) this_thread::yield();
+        for ( auto &c : subscribers ) c.disconnect();
+        lock.unlock();
+        emitter.join();
+        REQUIRE( signal.slot_count() == 4 );
+    }
+
+    THEN( "a slot disconnected by an earlier slot of an emission is not called by it" ) {
+        nod::connection later;
+        int calls = 0;
+        signal.connect( [&]( int ) { later.disconnect(); } );
+        later = signal.connect( [&]( int ) { ++calls; } );
+
+        signal( 1 );
+        REQUIRE( calls == 0 );
+        REQUIRE( sum == 3 );
+    }
+}
+
+SCENARIO( "With an outlet updating asynchronously", "[nodes][memory]" ) {
+    Executor executor( 2 );
+    Outlet< int > source;
+    source.setParallel( &executor, 2, 4 );
+    atomic< int > received{ 0 };
+    vector< unique_ptr< Inlet< int > > > inlets;
+    for ( int i = 0; i < 32; ++i ) {
+        inlets.emplace_back( new Inlet< int > );
+        inlets.back()->onReceive( [&received]( const int &v ) { received += v; } );
+        source >> *inlets.back();
+    }
+    // the first updates fill the executor's arena, and register the
+    // threads with the signals of the inlets
+    for ( int i = 0; i < 10; ++i ) source.update_async( 0 ).wait();
+
+    THEN( "updates allocate nothing once the executor has memory for them" ) {
+        auto before = counting_new::threadCalls();
+        for ( int i = 0; i < 100; ++i ) source.update_async( 1 ).wait();
+        auto calls = counting_new::threadCalls() - before;
+        REQUIRE( calls == 0 );
+        REQUIRE( received == 3200 );
+    }
+}
+
 SCENARIO( "With an AnyNode", "[nodes]" ) {
     Int_IONode concrete( "node 1" );
     AnyNode any( (Int_IONode::visitable_type &)concrete );
@@ -144,6 +372,159 @@ SCENARIO( "With an AnyNode", "[nodes]" ) {
     }
 }
 
+SCENARIO( "With ids", "[nodes]" ) {
+    THEN( "an allocator hands out dense ids and reuses the most recently released one first" ) {
+        id_allocator ids;
+        REQUIRE( ids.acquire() == 0 );
+        REQUIRE( ids.acquire() == 1 );
+        REQUIRE( ids.acquire() == 2 );
+        ids.release( 1 );
+        ids.release( 0 );
+        REQUIRE( ids.live() == 1 );
+        REQUIRE( ids.acquire() == 0 );
+        REQUIRE( ids.acquire() == 1 );
+        REQUIRE( ids.acquire() == 3 );
+        REQUIRE( ids.capacity() == 4 );
+    }
+
+    THEN( "nodes and xlets count separately" ) {
+        auto nodes = NodeBase::ids().live();
+        auto xlets = Xlet::ids().live();
+        {
+            Int_IONode n( "n" );
+            REQUIRE( NodeBase::ids().live() == nodes + 1 );
+            REQUIRE( Xlet::ids().live() == xlets + 2 );
+            REQUIRE( n.id() < NodeBase::ids().capacity() );
+            REQUIRE( n.in< 0 >().id() < Xlet::ids().capacity() );
+        }
+        REQUIRE( NodeBase::ids().live() == nodes );
+        REQUIRE( Xlet::ids().live() == xlets );
+    }
+
+    THEN( "ids of destroyed nodes are reused" ) {
+        auto build = [] {
+            std::vector< std::unique_ptr< Int_IONode > > nodes;
+            for ( int i = 0; i < 100; ++i ) nodes.emplace_back( new Int_IONode( "n" ) );
+        };
+        build();
+        auto capacity = NodeBase::ids().capacity();
+        build();
+        REQUIRE( NodeBase::ids().capacity() == capacity );
+    }
+
+    THEN( "nodes built on several threads get distinct ids" ) {
+        std::vector< std::vector< std::unique_ptr< Int_IONode > > > built( 4 );
+        std::vector< std::thread > loaders;
+        for ( auto &nodes : built ) {
+            loaders.emplace_back( [&nodes] {
+                for ( int i = 0; i < 1000; ++i ) nodes.emplace_back( new Int_IONode( "n" ) );
+            } );
+        }
+        for ( auto &t : loaders ) t.join();
+
+        std::set< uint64_t > ids;
+        for ( auto &nodes : built ) {
+            for ( auto &n : nodes ) {
+                ids.insert( n->id() );
+                REQUIRE( n->id() < NodeBase::ids().capacity() );
+            }
+        }
+        REQUIRE( ids.size() == 4000 );
+    }
+}
+
+SCENARIO( "With labels", "[nodes]" ) {
+    THEN( "nodes without a label are named after their id" ) {
+        class No_Node : public Node< Inlets<>, Outlets<> > {};
+        No_Node n;
+        REQUIRE( n.label() == "node " + to_string( n.id() ) );
+        REQUIRE( n.getLabel() == n.label() );
+    }
+
+    THEN( "nodes with the same label share it" ) {
+        auto before = label_pool::shared().size();
+        Int_IONode a( "a label only these nodes have" );
+        Int_IONode b( "a label only these nodes have" );
+        REQUIRE( label_pool::shared().size() == before + 1 );
+        const NodeBase &ca = a, &cb = b;
+        REQUIRE( &ca.label() == &cb.label() );
+
+        b.setLabel( "another label only b has" );
+        REQUIRE( a.label() == "a label only these nodes have" );
+        REQUIRE( b.label() == "another label only b has" );
+    }
+
+    THEN( "editing a shared label in place changes only its node" ) {
+        Int_IONode a( "gain" );
+        Int_IONode b( "gain" );
+        b.label() += " 2";
+        REQUIRE( a.getLabel() == "gain" );
+        REQUIRE( b.getLabel() == "gain 2" );
+    }
+
+    THEN( "labels no node uses are dropped" ) {
+        auto before = label_pool::shared().size();
+        {
+            Int_IONode a( "a label that goes away" );
+            REQUIRE( label_pool::shared().size() == before + 1 );
+        }
+        REQUIRE( label_pool::shared().size() == before );
+    }
+}
+
+SCENARIO( "Constructing nodes", "[nodes][memory]" ) {
+    class Uniform_IONode : public Node< UniformInlets< int, 4 >, UniformOutlets< int, 16 > > {};
+    // grows the tables of xlet and node ids to fit
+    { Uniform_IONode warm; }
+
+    THEN( "xlets and their back-pointers to the node are built without allocating" ) {
+        auto before = counting_new::threadCalls();
+        bool attached;
+        std::size_t calls;
+        {
+            Uniform_IONode n;
+            const NodeBase &node = n;
+            attached = &static_cast< const NodeBase & >( *n.in< 3 >().node() ) == &node &&
+                       &static_cast< const NodeBase & >( *n.out< 15 >().node() ) == &node;
+            calls = counting_new::threadCalls() - before;
+        }
+        REQUIRE( attached );
+        REQUIRE( calls == 0 );
+    }
+}
+
+SCENARIO( "Constructing and destroying many nodes", "[nodes][memory]" ) {
+    class Uniform_IONode : public Node< UniformInlets< int, 4 >, UniformOutlets< int, 16 > > {};
+
+    auto churn = []( std::size_t count ) {
+        std::size_t attached = 0;
+        for ( std::size_t i = 0; i < count; ++i ) {
+            std::unique_ptr< Uniform_IONode > n( new Uniform_IONode );
+            if ( n->out< 15 >().node() != nullptr ) attached++;
+        }
+        return attached;
+    };
+
+    churn( 1 );
+    auto nodes = NodeBase::ids().capacity(), xlets = Xlet::ids().capacity();
+    auto liveNodes = NodeBase::ids().live(), liveXlets = Xlet::ids().live();
+    auto live = counting_new::threadLive();
+    auto attached = churn( 100000 );
+    auto leaked = counting_new::threadLive() - live;
+
+    THEN( "no memory or back-pointers are leaked" ) {
+        REQUIRE( attached == 100000 );
+        REQUIRE( leaked == 0 );
+        REQUIRE( NodeBase::ids().live() == liveNodes );
+        REQUIRE( Xlet::ids().live() == liveXlets );
+    }
+
+    THEN( "the ids of destroyed nodes and xlets are reused" ) {
+        REQUIRE( NodeBase::ids().capacity() == nodes );
+        REQUIRE( Xlet::ids().capacity() == xlets );
+    }
+}
+
 SCENARIO( "Connecting nodes", "[nodes]" ) {
     class IntInt_IONode : public Node< Inlets< int, int >, Outlets< int, int > > {
     public:
@@ -239,6 +620,474 @@ SCENARIO( "Connecting nodes", "[nodes]" ) {
     }
 }
 
+SCENARIO( "With an outlet connected to many inlets", "[nodes]" ) {
+    Int_IONode source( "source" );
+    std::vector< std::unique_ptr< Int_IONode > > sinks;
+    for ( int i = 0; i < 100; ++i ) {
+        sinks.emplace_back( new Int_IONode( "sink" ) );
+        source >> *sinks.back();
+    }
+    auto &out = source.out< 0 >();
+
+    THEN( "every connection is kept, in order" ) {
+        REQUIRE( out.numConnections() == 100 );
+        std::size_t i = 0;
+        for ( auto &inlet : out.connections() ) {
+            REQUIRE( &inlet.get() == &sinks[ i++ ]->in< 0 >() );
+        }
+    }
+
+    THEN( "duplicate connections are refused" ) {
+        REQUIRE_FALSE( out.connect( sinks.front()->in< 0 >() ) );
+        REQUIRE_FALSE( out.connect( sinks.back()->in< 0 >() ) );
+        REQUIRE( out.numConnections() == 100 );
+    }
+
+    THEN( "inlets can be disconnected" ) {
+        for ( std::size_t i = 0; i < sinks.size(); i += 2 ) {
+            REQUIRE( out.disconnect( sinks[ i ]->in< 0 >() ) );
+        }
+        REQUIRE( out.numConnections() == 50 );
+        REQUIRE_FALSE( sinks[ 0 ]->in< 0 >().isConnectedTo( out ) );
+        REQUIRE( sinks[ 1 ]->in< 0 >().isConnectedTo( out ) );
+
+        source.in< 0 >().receive( 1 );
+        REQUIRE( sinks[ 0 ]->received.empty() );
+        REQUIRE( sinks[ 1 ]->received.size() == 1 );
+
+        out.disconnect();
+        REQUIRE_FALSE( out.isConnected() );
+        REQUIRE_FALSE( sinks[ 1 ]->in< 0 >().isConnected() );
+    }
+
+    THEN( "the holes disconnecting leaves are dropped" ) {
+        for ( std::size_t i = 90; i < sinks.size(); ++i ) out.disconnect( sinks[ i ]->in< 0 >() );
+        REQUIRE( out.connections().extent() == 90 );
+
+        for ( std::size_t i = 0; i < 80; ++i ) out.disconnect( sinks[ i ]->in< 0 >() );
+        REQUIRE( out.numConnections() == 10 );
+        REQUIRE( out.connections().extent() < 20 );
+
+        source.in< 0 >().receive( 1 );
+        REQUIRE( sinks[ 79 ]->received.empty() );
+        REQUIRE( sinks[ 80 ]->received.size() == 1 );
+        REQUIRE( sinks[ 89 ]->received.size() == 1 );
+    }
+
+    THEN( "listeners may connect and disconnect the outlet updating them" ) {
+        std::vector< std::unique_ptr< Int_IONode > > late;
+        sinks[ 0 ]->in< 0 >().onReceive( [&]( const int & ) {
+            if ( ! late.empty() ) return;
+            for ( std::size_t i = 1; i < 50; ++i ) out.disconnect( sinks[ i ]->in< 0 >() );
+            for ( int i = 0; i < 200; ++i ) {
+                late.emplace_back( new Int_IONode( "late" ) );
+                source >> *late.back();
+            }
+        } );
+
+        source.in< 0 >().receive( 1 );
+        REQUIRE( sinks[ 0 ]->received.size() == 1 );
+        REQUIRE( sinks[ 49 ]->received.empty() );
+        REQUIRE( sinks[ 50 ]->received.size() == 1 );
+        REQUIRE( sinks[ 99 ]->received.size() == 1 );
+        REQUIRE( late.front()->received.empty() );
+
+        source.in< 0 >().receive( 2 );
+        REQUIRE( out.numConnections() == 251 );
+        REQUIRE( sinks[ 99 ]->received.size() == 2 );
+        REQUIRE( late.front()->received.size() == 1 );
+        REQUIRE( late.back()->received.size() == 1 );
+    }
+
+    THEN( "connections churned by listeners leave no holes behind" ) {
+        Int_IONode a( "a" ), b( "b" );
+        std::size_t aExtent = 0, outExtent = 0;
+        sinks[ 0 ]->in< 0 >().onReceive( [&]( const int & ) {
+            for ( int i = 0; i < 100000; ++i ) {
+                a.out< 0 >() >> b.in< 0 >();
+                a.out< 0 >().disconnect( b.in< 0 >() );
+            }
+            aExtent = a.out< 0 >().connections().extent();
+            for ( std::size_t i = 1; i < 80; ++i ) out.disconnect( sinks[ i ]->in< 0 >() );
+            outExtent = out.connections().extent();
+        } );
+
+        source.in< 0 >().receive( 1 );
+        // only the outlet being updated keeps its holes, until it is done
+        REQUIRE( aExtent == 0 );
+        REQUIRE( outExtent == 100 );
+        REQUIRE( out.numConnections() == 21 );
+        REQUIRE( out.connections().extent() < 42 );
+        REQUIRE( sinks[ 79 ]->received.empty() );
+        REQUIRE( sinks[ 80 ]->received.size() == 1 );
+    }
+}
+
+SCENARIO( "With an inlet connected to many outlets", "[nodes]" ) {
+    Int_IONode sink( "sink" );
+    std::vector< std::unique_ptr< Outlet< int > > > sources;
+    std::vector< connection_handle > handles;
+    for ( int i = 0; i < 1000; ++i ) {
+        sources.emplace_back( new Outlet< int > );
+        handles.push_back( *sources.back() >> sink.in< 0 >() );
+    }
+
+    THEN( "it knows what it is connected to after connections come and go" ) {
+        std::vector< bool > expected( sources.size(), true );
+        std::size_t seed = 1;
+        for ( int round = 0; round < 5000; ++round ) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            auto i = ( seed >> 33 ) % sources.size();
+            if ( expected[ i ] ) {
+                handles[ i ].disconnect();
+            } else {
+                handles[ i ] = *sources[ i ] >> sink.in< 0 >();
+            }
+            expected[ i ] = ! expected[ i ];
+        }
+
+        std::size_t mismatches = 0, connected = 0;
+        for ( std::size_t i = 0; i < sources.size(); ++i ) {
+            if ( sink.in< 0 >().isConnectedTo( *sources[ i ] ) != expected[ i ] ) mismatches++;
+            if ( expected[ i ] ) connected++;
+        }
+        REQUIRE( mismatches == 0 );
+        REQUIRE( sink.in< 0 >().numConnections() == connected );
+    }
+}
+
+SCENARIO( "With listeners stored inline", "[nodes]" ) {
+    THEN( "an inplace_function calls what it holds, and moves it along" ) {
+        auto count = make_shared< int >( 0 );
+        inplace_function< int( int ) > f( [count]( int i ) { return *count += i; } );
+        REQUIRE( f );
+        REQUIRE( f( 2 ) == 2 );
+        REQUIRE( count.use_count() == 2 );
+
+        auto g = std::move( f );
+        REQUIRE_FALSE( f );
+        REQUIRE( g( 3 ) == 5 );
+        REQUIRE( count.use_count() == 2 );
+
+        g = nullptr;
+        REQUIRE( g == nullptr );
+        REQUIRE( count.use_count() == 1 );
+    }
+
+    THEN( "listeners can be move-only" ) {
+        Inlet< int > inlet;
+        unique_ptr< int > total( new int( 0 ) );
+        auto &t = *total;
+        inlet.onReceive( [total = std::move( total )]( const int &i ) { *total += i; } );
+        inlet.onReceive( [total = unique_ptr< int >( new int( 0 ) ), &t]( int i ) { t += *total + i; } );
+        inlet.receive( 2 );
+        REQUIRE( t == 4 );
+    }
+
+    THEN( "move-only and mutable listeners are stored without allocating" ) {
+        counting_resource resource;
+        std::unique_ptr< Inlet< int > > inlet;
+        {
+            memory_resource::scope scope( resource );
+            inlet.reset( new Inlet< int >() );
+        }
+        int calls = 0;
+        inlet->onReceive( [&]( const int & ) { ++calls; } );
+        int before = resource.total;
+        unique_ptr< int > owned( new int( 1 ) );
+        inlet->onReceive( [owned = std::move( owned ), &calls]( const int & ) { calls += *owned; } );
+        inlet->onReceive( [n = 0, &calls]( const int & ) mutable { calls += ++n; } );
+        REQUIRE( resource.total == before );
+        inlet->receive( 0 );
+        inlet->receive( 0 );
+        REQUIRE( calls == 7 );
+    }
+
+    THEN( "what listeners capture is destroyed once they are disconnected" ) {
+        auto captured = make_shared< int >( 0 );
+        Inlet< int > inlet;
+        auto c = inlet.onReceive( [captured]( const int & ) {} );
+        REQUIRE( captured.use_count() == 2 );
+        c.disconnect();
+        REQUIRE( captured.use_count() == 1 );
+    }
+}
+
+SCENARIO( "With connection handles", "[nodes]" ) {
+    Int_IONode n1( "node 1" );
+    Int_IONode n2( "node 2" );
+    Int_IONode n3( "node 3" );
+
+    connection_handle h2 = n1 >> n2.in< 0 >();
+    connection_handle h3 = n1.out< 0 >() >> n3.in< 0 >();
+
+    THEN( "connecting returns a connected handle" ) {
+        REQUIRE( h2.connected() );
+        REQUIRE( h3 );
+        REQUIRE_FALSE( n1.out< 0 >().connect( n2.in< 0 >() ) );
+    }
+
+    THEN( "a handle disconnects both ends" ) {
+        h2.disconnect();
+
+        REQUIRE_FALSE( h2.connected() );
+        REQUIRE_FALSE( n2.in< 0 >().isConnected() );
+        REQUIRE( n1.out< 0 >().numConnections() == 1 );
+
+        n1.in< 0 >().receive( 1 );
+        REQUIRE( n2.received.empty() );
+        REQUIRE( n3.received.size() == 1 );
+    }
+
+    THEN( "a handle notices when either end disconnects" ) {
+        connection_handle copy = h3;
+        n1.out< 0 >().disconnect( n3.in< 0 >() );
+
+        REQUIRE_FALSE( h3.connected() );
+        REQUIRE_FALSE( copy.connected() );
+        h3.disconnect();
+        REQUIRE( n2.in< 0 >().isConnectedTo( n1.out< 0 >() ) );
+    }
+
+    THEN( "destroying a node disconnects it" ) {
+        {
+            Int_IONode n4( "node 4" );
+            n1 >> n4;
+            REQUIRE( n1.out< 0 >().numConnections() == 3 );
+        }
+        REQUIRE( n1.out< 0 >().numConnections() == 2 );
+        n1.in< 0 >().receive( 1 );
+        REQUIRE( n3.received.size() == 1 );
+    }
+}
+
+//! a payload that counts how often it gets copied
+struct Counted {
+    static int copies;
+
+    int value = 0;
+
+    Counted( int v = 0 ) : value( v ) {}
+    Counted( const Counted &other ) : value( other.value ) { ++copies; }
+    Counted( Counted && ) = default;
+    Counted &operator=( const Counted &other ) { value = other.value; ++copies; return *this; }
+    Counted &operator=( Counted && ) = default;
+
+    bool operator==( const Counted &rhs ) const { return value == rhs.value; }
+    bool operator!=( const Counted &rhs ) const { return value != rhs.value; }
+};
+
+int Counted::copies = 0;
+
+SCENARIO( "With payloads that can be moved", "[nodes]" ) {
+    Outlet< Counted > out;
+    Inlet< Counted > in1, in2;
+    std::vector< Counted > received;
+    std::vector< std::string > calls;
+
+    Counted::copies = 0;
+
+    THEN( "a single connection takes ownership of an rvalue" ) {
+        out.connect( in1 );
+        in1.onReceive( [&]( Counted c ) { received.push_back( std::move( c ) ); } );
+
+        out.update( Counted( 1 ) );
+
+        REQUIRE( received.size() == 1 );
+        REQUIRE( received[ 0 ].value == 1 );
+        REQUIRE( Counted::copies == 0 );
+    }
+
+    THEN( "only the last connection of a fan-out takes ownership" ) {
+        out.connect( in1 );
+        out.connect( in2 );
+        in1.onReceive( [&]( Counted &&c ) { received.push_back( std::move( c ) ); } );
+        in2.onReceive( [&]( Counted &&c ) { received.push_back( std::move( c ) ); } );
+
+        out.update( Counted( 2 ) );
+
+        REQUIRE( received.size() == 2 );
+        REQUIRE( received[ 0 ].value == 2 );
+        REQUIRE( received[ 1 ].value == 2 );
+        REQUIRE( Counted::copies == 1 );
+    }
+
+    THEN( "listeners taking a reference never copy" ) {
+        out.connect( in1 );
+        in1.onReceive( [&]( const Counted &c ) { calls.push_back( "reference" ); REQUIRE( c.value == 3 ); } );
+        in1.onReceive( [&]( Counted c ) { calls.push_back( "value" ); received.push_back( std::move( c ) ); } );
+
+        out.update( Counted( 3 ) );
+
+        REQUIRE(( calls == std::vector< std::string >{ "reference", "value" } ));
+        REQUIRE( received[ 0 ].value == 3 );
+        REQUIRE( Counted::copies == 0 );
+    }
+
+    THEN( "listeners are called in the order they were registered" ) {
+        out.connect( in1 );
+        in1.onReceive( [&]( Counted c ) { calls.push_back( "value" ); received.push_back( std::move( c ) ); } );
+        in1.onReceive( [&]( const Counted &c ) { calls.push_back( "reference" ); REQUIRE( c.value == 3 ); } );
+
+        out.update( Counted( 3 ) );
+
+        REQUIRE(( calls == std::vector< std::string >{ "value", "reference" } ));
+        REQUIRE( received[ 0 ].value == 3 );
+        REQUIRE( Counted::copies == 1 );
+    }
+
+    THEN( "a listener registered on a value node sees its new value" ) {
+        ValueNode< Counted > v;
+        int seen = 0;
+        v.in< 0 >().onReceive( [&]( const Counted & ) { seen = v.get().value; } );
+
+        v.in< 0 >().receive( Counted( 8 ) );
+        REQUIRE( seen == 8 );
+    }
+
+    THEN( "a listener may disconnect the connections after its own" ) {
+        out.connect( in1 );
+        auto next = out.connect( in2 );
+        in1.onReceive( [&]( const Counted & ) { next.disconnect(); } );
+        in2.onReceive( [&]( Counted c ) { received.push_back( std::move( c ) ); } );
+
+        out.update( Counted( 9 ) );
+
+        REQUIRE( received.empty() );
+    }
+
+    THEN( "an lvalue is copied into a listener taking ownership" ) {
+        out.connect( in1 );
+        in1.onReceive( [&]( Counted c ) { received.push_back( std::move( c ) ); } );
+
+        Counted c( 4 );
+        out.update( c );
+
+        REQUIRE( received[ 0 ].value == 4 );
+        REQUIRE( c.value == 4 );
+        REQUIRE( Counted::copies == 1 );
+    }
+
+    THEN( "a value node stores what it receives without copying" ) {
+        ValueNode< Counted > v;
+        Counted::copies = 0;
+
+        v.in< 0 >().receive( Counted( 5 ) );
+        REQUIRE( v.get().value == 5 );
+        REQUIRE( Counted::copies == 0 );
+
+        // the only copy kept is the one to compare the next value against
+        v.set( Counted( 6 ) );
+        REQUIRE( v.get().value == 6 );
+        REQUIRE( Counted::copies == 1 );
+    }
+
+    THEN( "a bundle node hands on its bundle without copying" ) {
+        BundleNode< Counted, int > b;
+        Inlet< bundle< Counted, int > > sink;
+        b.out< 0 >().connect( sink );
+        sink.onReceive( [&]( bundle< Counted, int > r ) { received.push_back( std::move( get< 0 >( r ) ) ); } );
+
+        b.in< 0 >().receive( Counted( 7 ) );
+        b.in< 1 >().receive( 1 );
+
+        REQUIRE( received.size() == 1 );
+        REQUIRE( received[ 0 ].value == 7 );
+        REQUIRE( Counted::copies == 0 );
+    }
+}
+
+SCENARIO( "With batches of values", "[nodes]" ) {
+    Outlet< int > out;
+    Inlet< int > in;
+    out.connect( in );
+    std::vector< int > values;
+    std::vector< std::size_t > batches;
+    std::vector< int > batch{ 1, 2, 3 };
+
+    THEN( "listeners for single values get a batch unrolled" ) {
+        in.onReceive( [&]( const int &i ) { values.push_back( i ); } );
+
+        out.update_batch( batch );
+
+        REQUIRE(( values == std::vector< int >{ 1, 2, 3 } ));
+    }
+
+    THEN( "batch listeners get a batch in one call" ) {
+        in.onReceiveBatch( [&]( span< const int > b ) {
+            batches.push_back( b.size() );
+            values.insert( values.end(), b.begin(), b.end() );
+        } );
+
+        out.update_batch( batch );
+        out.update( 4 );
+
+        REQUIRE(( batches == std::vector< std::size_t >{ 3, 1 } ));
+        REQUIRE(( values == std::vector< int >{ 1, 2, 3, 4 } ));
+    }
+
+    THEN( "a listener with a batch function handles each value once" ) {
+        in.onReceive( [&]( const int &i ) { values.push_back( i ); },
+                      [&]( span< const int > b ) { batches.push_back( b.size() ); } );
+
+        out.update_batch( batch );
+        out.update( 4 );
+
+        REQUIRE(( batches == std::vector< std::size_t >{ 3 } ));
+        REQUIRE(( values == std::vector< int >{ 4 } ));
+    }
+
+    THEN( "listeners for values and for batches on one inlet get every value" ) {
+        in.onReceive( [&]( const int &i ) { values.push_back( i ); } );
+        in.onReceiveBatch( [&]( span< const int > b ) { batches.push_back( b.size() ); } );
+
+        out.update_batch( batch );
+        out.update( 4 );
+
+        REQUIRE(( batches == std::vector< std::size_t >{ 3, 1 } ));
+        REQUIRE(( values == std::vector< int >{ 1, 2, 3, 4 } ));
+    }
+
+    THEN( "listeners on a value node get the values of a batch" ) {
+        ValueNode< int > v;
+        out >> v.in< 0 >();
+        v.in< 0 >().onReceive( [&]( const int &i ) { values.push_back( i ); } );
+
+        out.update_batch( batch );
+
+        REQUIRE( v.get() == 3 );
+        REQUIRE(( values == std::vector< int >{ 1, 2, 3 } ));
+    }
+
+    THEN( "empty batches are not sent" ) {
+        in.onReceiveBatch( [&]( span< const int > b ) { batches.push_back( b.size() ); } );
+
+        out.update_batch( span< const int >() );
+
+        REQUIRE( batches.empty() );
+    }
+
+    THEN( "value nodes and conversion nodes pass batches on" ) {
+        ValueNode< int > v;
+        node_convert< int, float > c;
+        Inlet< float > sink;
+        std::vector< float > received;
+        sink.onReceiveBatch( [&]( span< const float > b ) {
+            batches.push_back( b.size() );
+            received.insert( received.end(), b.begin(), b.end() );
+        } );
+        out >> v.in< 0 >();
+        v >> c;
+        c.out< 0 >() >> sink;
+
+        out.update_batch( batch );
+
+        REQUIRE( v.get() == 3 );
+        REQUIRE(( batches == std::vector< std::size_t >{ 3 } ));
+        REQUIRE(( received == std::vector< float >{ 1.f, 2.f, 3.f } ));
+    }
+}
+
 SCENARIO( "With two connected nodes", "[nodes]" ) {
     Int_IONode n1( "label 1" );
     Int_IONode n2( "label 2" );
@@ -259,7 +1108,7 @@ SCENARIO( "With two connected nodes", "[nodes]" ) {
 
     THEN( "the inlets are iterable" ) {
         int num = 0;
-        n1.inlets().each( [&]( auto &i ) {
+        n1.inlets().each( [&]( auto & ) {
             num++;
         } );
 
@@ -268,7 +1117,7 @@ SCENARIO( "With two connected nodes", "[nodes]" ) {
 
     THEN( "the outlets are iterable" ) {
         int num = 0;
-        n1.outlets().each( [&]( auto &o ) {
+        n1.outlets().each( [&]( auto & ) {
             num++;
         } );
 
@@ -356,7 +1205,7 @@ SCENARIO( "With heterogenous nodes", "[nodes]" ) {
 
     THEN( "the inlets are iterable" ) {
         int num = 0;
-        n3.inlets().each( [&]( auto &i ) {
+        n3.inlets().each( [&]( auto & ) {
             num++;
         } );
 
@@ -365,7 +1214,7 @@ SCENARIO( "With heterogenous nodes", "[nodes]" ) {
 
     THEN( "the outlets are iterable" ) {
         int num = 0;
-        n3.outlets().each( [&]( auto &o ) {
+        n3.outlets().each( [&]( auto & ) {
             num++;
         } );
 
@@ -374,7 +1223,7 @@ SCENARIO( "With heterogenous nodes", "[nodes]" ) {
 
     THEN( "the inlets are iterable with indices" ) {
         vector< size_t > indices;
-        n3.inlets().each_with_index( [&]( auto &inlet, size_t i ) {
+        n3.inlets().each_with_index( [&]( auto &, size_t i ) {
             indices.push_back( i );
         } );
 
@@ -385,7 +1234,7 @@ SCENARIO( "With heterogenous nodes", "[nodes]" ) {
 
     THEN( "the outlets are iterable with indices" ) {
         vector< size_t > indices;
-        n3.outlets().each_with_index( [&]( auto &outlet, size_t i ) {
+        n3.outlets().each_with_index( [&]( auto &, size_t i ) {
             indices.push_back( i );
         } );
 
@@ -399,8 +1248,8 @@ SCENARIO( "With heterogenous nodes", "[nodes]" ) {
             int gotInt = 0;
             int gotString = 0;
 
-            void operator()( const Outlet< int > &o ) { gotInt++; }
-            void operator()( const Outlet< string > &o ) { gotString++; }
+            void operator()( const Outlet< int > & ) { gotInt++; }
+            void operator()( const Outlet< string > & ) { gotString++; }
         };
 
         outlet_iterator it;
@@ -487,4 +1336,104 @@ SCENARIO( "With heterogenous nodes", "[nodes]" ) {
             REQUIRE( v.ss.str() == "[node 1] node 1 (0) -> node 2 (0), [node 2] node 2 (0) -> node 3 (0), [node 3] node 3 (1) -> node 4 (1), [node 4] node 1 (0) -> node 4 (0), [node 4] " );
         }
     }
-}
\ No newline at end of file
+}
+SCENARIO( "With a traversal", "[nodes]" ) {
+    class V : public NodeVisitor< NodeBase > {
+    public:
+
+        void visit( NodeBase & n ) {
+            visited.push_back( n.getLabel() );
+            ss << "[" << n.getLabel() << "] ";
+        }
+
+        void visit( OutletBase & o, InletBase & i ) {
+            ss << o.node()->getLabel() << " -> " << i.node()->getLabel() << ", ";
+        };
+
+        std::vector< std::string > visited;
+        std::stringstream ss;
+    };
+
+    GIVEN( "a diamond" ) {
+        Int_IONode a( "a" );
+        Int_IONode b( "b" );
+        Int_IONode c( "c" );
+        Int_IONode d( "d" );
+        a >> b >> d;
+        a >> c >> d;
+        V v;
+
+        THEN( "accept visits the shared node once per path" ) {
+            a.accept( v );
+
+            REQUIRE( ( v.visited == vector< string >{ "a", "b", "d", "c", "d" } ) );
+        }
+
+        THEN( "a pre-order traversal visits every node once" ) {
+            traverse( a, v );
+
+            REQUIRE( ( v.visited == vector< string >{ "a", "b", "d", "c" } ) );
+            REQUIRE( v.ss.str() == "[a] a -> b, [b] b -> d, [d] a -> c, [c] c -> d, " );
+        }
+
+        THEN( "a post-order traversal visits nodes after what they connect to" ) {
+            traverse( a, v, traversal_order::post_order );
+
+            REQUIRE( ( v.visited == vector< string >{ "d", "b", "c", "a" } ) );
+        }
+
+        THEN( "a breadth first traversal visits nodes by their distance from the root" ) {
+            traverse( a, v, traversal_order::breadth_first );
+
+            REQUIRE( ( v.visited == vector< string >{ "a", "b", "c", "d" } ) );
+        }
+
+        THEN( "a traversal can be run again" ) {
+            Traversal traversal;
+            traversal.run( a, v );
+            traversal.run( b, v );
+
+            REQUIRE( ( v.visited == vector< string >{ "a", "b", "d", "c", "b", "d" } ) );
+        }
+    }
+
+    GIVEN( "a feedback loop" ) {
+        Int_IONode a( "a" );
+        Int_IONode b( "b" );
+        Int_IONode c( "c" );
+        a >> b >> c >> a;
+        V v;
+
+        THEN( "every order ends where it started" ) {
+            traverse( a, v );
+            traverse( b, v, traversal_order::post_order );
+            traverse( c, v, traversal_order::breadth_first );
+
+            REQUIRE( ( v.visited == vector< string >{ "a", "b", "c", "a", "c", "b", "c", "a", "b" } ) );
+            REQUIRE( v.ss.str().find( "c -> a" ) != string::npos );
+        }
+    }
+
+    GIVEN( "a long chain" ) {
+        vector< unique_ptr< Int_IONode > > chain;
+        for ( int i = 0; i < 100000; ++i ) {
+            chain.emplace_back( new Int_IONode( "" ) );
+            if ( i > 0 ) chain[ i - 1 ]->out< 0 >() >> chain[ i ]->in< 0 >();
+        }
+
+        THEN( "it is traversed without recursing" ) {
+            size_t count = 0;
+            struct counter : public NodeVisitor< NodeBase > {
+                size_t &count;
+                counter( size_t &c ) : count( c ) {}
+                void visit( NodeBase & ) { ++count; }
+            } visitor( count );
+
+            traverse( *chain.front(), visitor );
+            REQUIRE( count == chain.size() );
+            count = 0;
+            traverse( *chain.front(), visitor, traversal_order::post_order );
+            REQUIRE( count == chain.size() );
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#include "catch.hpp"
+#include "libnodes/Node.h"
+#include "libnodes/operators.h"
+#include "libnodes/Pipeline.h"
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace nodes;
+using namespace std;
+using namespace Catch;
+using namespace nodes::operators;
+
+
+//! Adds one to each int it receives after spinning \a work times.
+class Step_IONode : public Node< Inlets< int >, Outlets< int > > {
+public:
+    explicit Step_IONode( unsigned work = 0 ) {
+        in< 0 >().onReceive( [this, work]( const int &i ) {
+            volatile unsigned x = 0;
+            for ( unsigned k = 0; k < work; ++k ) x = x + k;
+            out< 0 >().update( i + 1 );
+        } );
+    }
+};
+
+SCENARIO( "With a pipeline", "[nodes]" ) {
+    vector< unique_ptr< Step_IONode > > chain;
+    for ( int i = 0; i < 12; ++i ) {
+        chain.emplace_back( new Step_IONode( i == 5 ? 200000 : 0 ) );
+        if ( i > 0 ) *chain[ i - 1 ] >> *chain[ i ];
+    }
+    Inlet< int > sink;
+    vector< int > received;
+    thread::id sinkThread;
+    sink.onReceive( [&]( const int &i ) {
+        received.push_back( i );
+        sinkThread = this_thread::get_id();
+    } );
+    chain.back()->out< 0 >() >> sink;
+
+    Pipeline pipeline( *chain.front() );
+
+    THEN( "it finds the chain" ) {
+        REQUIRE( pipeline.size() == 12 );
+        REQUIRE( pipeline.node( 0 ).id() == chain[ 0 ]->id() );
+        REQUIRE( pipeline.node( 11 ).id() == chain[ 11 ]->id() );
+    }
+
+    THEN( "it splits the chain into stages of equal cost" ) {
+        REQUIRE(( pipeline.partition( 4 ) == vector< size_t >{ 0, 3, 6, 9 } ));
+        REQUIRE(( pipeline.partition( 1 ) == vector< size_t >{ 0 } ));
+        REQUIRE( pipeline.partition( 20 ).size() == 12 );
+
+        pipeline.setCost( 4, 4 );
+        pipeline.setCost( 5, 4 );
+        auto starts = pipeline.partition( 3 );
+        REQUIRE( starts.size() == 3 );
+        double most = 0;
+        for ( size_t s = 0; s < starts.size(); ++s ) {
+            double cost = 0;
+            auto end = s + 1 < starts.size() ? starts[ s + 1 ] : pipeline.size();
+            for ( auto i = starts[ s ]; i < end; ++i ) cost += pipeline.costs()[ i ];
+            most = max( most, cost );
+        }
+        // 4 and 5 cannot share a stage, so the best is 8
+        REQUIRE( most == 8 );
+    }
+
+    THEN( "measuring finds the expensive node" ) {
+        int sent = 0;
+        pipeline.measure( [&] { chain.front()->in< 0 >().receive( sent++ ); }, 20 );
+        REQUIRE( received.size() == 20 );
+        for ( size_t i = 0; i < 12; ++i ) {
+            if ( i != 5 ) REQUIRE( pipeline.costs()[ 5 ] > pipeline.costs()[ i ] );
+        }
+        auto starts = pipeline.partition( 3 );
+        REQUIRE(( starts[ 1 ] == 5 || starts[ 2 ] == 5 ));
+
+        // the chain is connected directly again
+        chain.front()->in< 0 >().receive( 100 );
+        REQUIRE( received.back() == 112 );
+    }
+
+    THEN( "values pass every stage in order" ) {
+        for ( auto &n : chain ) n->in< 0 >().onReceive( []( const int & ) {} );
+        pipeline.setCost( 5, 1 );
+        pipeline.start( 4, 16 );
+        REQUIRE( pipeline.stages() == 4 );
+        for ( int i = 0; i < 2000; ++i ) chain.front()->in< 0 >().receive( i );
+        pipeline.wait();
+
+        REQUIRE( received.size() == 2000 );
+        bool ordered = true;
+        for ( int i = 0; i < 2000; ++i ) ordered = ordered && received[ i ] == i + 12;
+        REQUIRE( ordered );
+        REQUIRE( sinkThread != this_thread::get_id() );
+
+        pipeline.stop();
+        REQUIRE( pipeline.stages() == 0 );
+        chain.front()->in< 0 >().receive( 0 );
+        REQUIRE( received.back() == 12 );
+        REQUIRE( sinkThread == this_thread::get_id() );
+    }
+
+    THEN( "it only takes linear chains" ) {
+        Step_IONode branch;
+        *chain[ 3 ] >> branch;
+        REQUIRE_THROWS_AS( Pipeline( *chain.front() ), std::invalid_argument );
+    }
+}
@@ -0,0 +1,153 @@
+#include "catch.hpp"
+#include "libnodes/Node.h"
+#include "libnodes/operators.h"
+#include <array>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace nodes;
+using namespace std;
+using namespace Catch;
+using namespace nodes::operators;
+
+
+class Relay_IONode : public Node< UnsafeInlets< int >, Outlets< int > > {
+public:
+    Relay_IONode( vector< string > *log = nullptr, const string &label = "" ) : node_type( label ) {
+        in< 0 >().onReceive( [this, log]( const int &i ) {
+            if ( log ) log->push_back( this->label() );
+            this->out< 0 >().update( i + 1 );
+        } );
+    }
+};
+
+SCENARIO( "With a work queue", "[nodes]" ) {
+    vector< string > log;
+    Relay_IONode a( &log, "a" ), b( &log, "b" ), c( &log, "c" ), d( &log, "d" ), e( &log, "e" );
+    a >> b >> d;
+    a >> c >> e;
+
+    THEN( "a FIFO queue propagates breadth first" ) {
+        work_queue queue( propagation_order::fifo );
+        work_queue::scope scope( queue );
+
+        a.in< 0 >().receive( 0 );
+
+        REQUIRE(( log == vector< string >{ "a", "b", "c", "d", "e" } ));
+        REQUIRE( queue.size() == 0 );
+        REQUIRE_FALSE( queue.draining() );
+    }
+
+    THEN( "a LIFO queue propagates depth first" ) {
+        work_queue queue( propagation_order::lifo );
+        work_queue::scope scope( queue );
+
+        a.in< 0 >().receive( 0 );
+
+        REQUIRE(( log == vector< string >{ "a", "b", "c", "e", "d" } ));
+    }
+
+    THEN( "an update that throws drops the updates still queued" ) {
+        work_queue queue;
+        work_queue::scope scope( queue );
+        b.in< 0 >().onReceive( [&]( const int & ) { throw std::runtime_error( "b" ); } );
+
+        REQUIRE_THROWS_AS( a.in< 0 >().receive( 0 ), std::runtime_error );
+        REQUIRE( queue.size() == 0 );
+        REQUIRE_FALSE( queue.draining() );
+
+        log.clear();
+        d.in< 0 >().receive( 0 );
+        REQUIRE(( log == vector< string >{ "d" } ));
+    }
+
+    THEN( "a queue set on the nodes of a graph overrides that of the thread" ) {
+        work_queue graphQueue( propagation_order::lifo ), threadQueue( propagation_order::fifo );
+        work_queue::scope scope( threadQueue );
+        for ( auto n : { &a, &b, &c, &d, &e } ) n->setWorkQueue( &graphQueue );
+
+        a.in< 0 >().receive( 0 );
+
+        REQUIRE(( log == vector< string >{ "a", "b", "c", "e", "d" } ));
+        REQUIRE( a.out< 0 >().getWorkQueue() == &graphQueue );
+    }
+
+    THEN( "a scope restores the previous queue of the thread" ) {
+        work_queue outer, inner;
+        {
+            work_queue::scope s1( outer );
+            {
+                work_queue::scope s2( inner );
+                REQUIRE( work_queue::current() == &inner );
+            }
+            REQUIRE( work_queue::current() == &outer );
+        }
+        REQUIRE( work_queue::current() == nullptr );
+    }
+
+    THEN( "deferred batches keep a copy of their values" ) {
+        work_queue queue;
+        work_queue::scope scope( queue );
+        Outlet< int > out;
+        Inlet< int, singlethread_policy > in, sink;
+        Outlet< int > relay;
+        out.connect( in );
+        relay.connect( sink );
+        vector< int > received;
+        in.onReceiveBatch( [&]( span< const int > batch ) {
+            vector< int > temporary( batch.begin(), batch.end() );
+            for ( auto &i : temporary ) i *= 10;
+            relay.update_batch( temporary );
+        } );
+        sink.onReceive( [&]( const int &i ) { received.push_back( i ); } );
+
+        out.update_batch( vector< int >{ 1, 2, 3 } );
+
+        REQUIRE(( received == vector< int >{ 10, 20, 30 } ));
+    }
+
+    THEN( "updates too large to store inline come from the resource of the queue" ) {
+        arena pool;
+        work_queue queue( propagation_order::fifo, &pool );
+        array< int, 32 > values;
+        values.fill( 1 );
+        int sum = 0;
+        std::size_t queued = 0;
+        queue.run( [&] {
+            queue.post( [values, &sum] { for ( auto v : values ) sum += v; } );
+            queued = pool.used();
+        } );
+        REQUIRE( sum == 32 );
+        REQUIRE( queued >= sizeof( values ) );
+        REQUIRE( pool.used() + sizeof( values ) <= queued );
+    }
+}
+
+SCENARIO( "With a very long chain of nodes", "[nodes]" ) {
+    const size_t length = 50000;
+    vector< unique_ptr< Relay_IONode > > chain;
+    for ( size_t i = 0; i < length; ++i ) {
+        chain.emplace_back( new Relay_IONode );
+        if ( i > 0 ) *chain[ i - 1 ] >> *chain[ i ];
+    }
+    int last = 0;
+    Inlet< int, singlethread_policy > sink;
+    chain.back()->out< 0 >().connect( sink );
+    sink.onReceive( [&]( const int &i ) { last = i; } );
+
+    THEN( "a work queue propagates through it without growing the stack" ) {
+        for ( auto order : { propagation_order::fifo, propagation_order::lifo } ) {
+            work_queue queue( order );
+            work_queue::scope scope( queue );
+
+            chain.front()->in< 0 >().receive( 0 );
+            REQUIRE( last == int( length ) );
+
+            last = 0;
+            chain.front()->in< 0 >().receive( 0 );
+            REQUIRE( last == int( length ) );
+        }
+    }
+}
@@ -40,10 +40,12 @@ struct callable {
     TwoInts_IONode & n;
 
     template< std::int64_t I >
-    void operator()( Inlet< int > & inlet, algorithms::index_constant< I > i )
+    void operator()( Inlet< int > & inlet, algorithms::index_constant< I > )
     {
-        inlet.onReceive( [&]( const int & received ) {
-            n.out< I >().update( received );
+        // the callable is a temporary, so the node is captured, not this
+        auto &node = n;
+        inlet.onReceive( [&node]( const int & received ) {
+            node.out< I >().update( received );
         });
     }
 };
@@ -55,7 +57,7 @@ SCENARIO( "With a single node with multiple inlets and outlets", "[nodes]" )
 
     THEN( "it is possible to iterate inlets" ) {
         int i = 0;
-        n.inlets().each( [&]( Inlet< int > &inlet ) {
+        n.inlets().each( [&]( Inlet< int > & ) {
             i++;
         } );
 
@@ -64,7 +66,7 @@ SCENARIO( "With a single node with multiple inlets and outlets", "[nodes]" )
 
     THEN( "it is possible to iterate outlets" ) {
         int i = 0;
-        n.outlets().each( [&]( Outlet< int > &outlet ) {
+        n.outlets().each( [&]( Outlet< int > & ) {
             i++;
         } );
 
@@ -74,7 +76,7 @@ SCENARIO( "With a single node with multiple inlets and outlets", "[nodes]" )
     THEN( "it is possible to iterate inlets with indices" ) {
         int i = 0;
         vector< size_t > indices;
-        n.inlets().each_with_index( [&]( Inlet< int > &inlet, size_t j ) {
+        n.inlets().each_with_index( [&]( Inlet< int > &, size_t j ) {
             i++;
             indices.push_back( j );
         } );
@@ -87,7 +89,7 @@ SCENARIO( "With a single node with multiple inlets and outlets", "[nodes]" )
     THEN( "it is possible to iterate outlets with indices" ) {
         int i = 0;
         vector< size_t > indices;
-        n.outlets().each_with_index( [&]( Outlet< int > &outlet, size_t j ) {
+        n.outlets().each_with_index( [&]( Outlet< int > &, size_t j ) {
             i++;
             indices.push_back( j );
         } );
@@ -115,7 +117,7 @@ SCENARIO( "With a single node with multiple inlets and outlets", "[nodes]" )
 
     THEN( "it is possible to skip an inlet" ) {
         int i = 0;
-        n.inlets()[ from< 1 >{} ].each( [&]( Inlet< int > &inlet ) {
+        n.inlets()[ from< 1 >{} ].each( [&]( Inlet< int > & ) {
             i++;
         } );
 
@@ -124,7 +126,7 @@ SCENARIO( "With a single node with multiple inlets and outlets", "[nodes]" )
 
     THEN( "it is possible to skip an outlet" ) {
         int i = 0;
-        n.outlets()[ from< 1 >{} ].each( [&]( Outlet< int > &outlet ) {
+        n.outlets()[ from< 1 >{} ].each( [&]( Outlet< int > & ) {
             i++;
         } );
 
@@ -134,7 +136,7 @@ SCENARIO( "With a single node with multiple inlets and outlets", "[nodes]" )
 
     THEN( "it is possible to skip the last inlet" ) {
         int i = 0;
-        n.inlets()[ from< 0 >::to < -2 > {} ].each( [&]( Inlet< int > &inlet ) {
+        n.inlets()[ from< 0 >::to < -2 > {} ].each( [&]( Inlet< int > & ) {
             i++;
         } );
 
@@ -143,7 +145,7 @@ SCENARIO( "With a single node with multiple inlets and outlets", "[nodes]" )
 
     THEN( "it is possible to skip the last outlet" ) {
         int i = 0;
-        n.outlets()[ from< 0 >::to < -2 > {} ].each( [&]( Outlet< int > &outlet ) {
+        n.outlets()[ from< 0 >::to < -2 > {} ].each( [&]( Outlet< int > & ) {
             i++;
         } );
 